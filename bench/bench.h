@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Minimal benchmark registry for soloud_bench. Each benchmark appends its
+// measurements to a list; main() runs the benchmarks in registration order.
+namespace bench
+{
+    struct Measurement
+    {
+        std::string name;
+        double value;
+        std::string unit;
+    };
+
+    using Func = void (*)(std::vector<Measurement>& out);
+
+    struct Entry
+    {
+        const char* name;
+        Func func;
+    };
+
+    std::vector<Entry>& registry();
+
+    // Block sizes (in frames) for the kernel benchmarks; --sizes=a,b,c overrides
+    const std::vector<unsigned int>& sizes();
+
+    // Marks the run failed: main() reports why and exits non-zero once every
+    // selected benchmark has run, so checks can gate a build
+    void fail(const std::string& why);
+
+    struct Registrar
+    {
+        Registrar(const char* name, Func func) { registry().push_back({name, func}); }
+    };
+
+    // Wall-clock seconds spent in func()
+    template <typename F>
+    double seconds(F&& func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+#define BENCH(name) \
+    static void bench_##name(std::vector<bench::Measurement>& out); \
+    static bench::Registrar registrar_##name(#name, bench_##name); \
+    static void bench_##name(std::vector<bench::Measurement>& out)
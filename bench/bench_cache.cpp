@@ -0,0 +1,89 @@
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_samplecache.h"
+#include "soloud_wav.h"
+
+#ifndef SOLOUD_BENCH_SFX_DIR
+#define SOLOUD_BENCH_SFX_DIR "sfx"
+#endif
+
+namespace
+{
+    const unsigned int kSounds = 1544;
+    const unsigned int kRequests = 4000;
+    const unsigned long long kBudget = 64ull * 1024 * 1024;
+
+    // Zipf-ish request stream: a few sounds are requested far more than the rest
+    std::vector<unsigned int> requestStream()
+    {
+        std::vector<double> cdf(kSounds);
+        double sum = 0;
+        for (unsigned int i = 0; i < kSounds; i++)
+        {
+            sum += 1.0 / std::pow(i + 1.0, 1.1);
+            cdf[i] = sum;
+        }
+        std::vector<unsigned int> out;
+        uint32_t seed = 12345;
+        for (unsigned int r = 0; r < kRequests; r++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            double u = (seed >> 8) / double(1 << 24) * sum;
+            unsigned int i = 0;
+            while (cdf[i] < u)
+                i++;
+            // Scatter popular ids across the corpus
+            out.push_back((i * 7919u) % kSounds);
+        }
+        return out;
+    }
+
+    std::string sfxPath(unsigned int id)
+    {
+        return std::string(SOLOUD_BENCH_SFX_DIR) + "/" + std::to_string(id) + ".wav";
+    }
+}
+
+BENCH(sample_cache)
+{
+    {
+        SoLoud::Wav probe;
+        if (probe.load(sfxPath(0).c_str()) != SoLoud::SO_NO_ERROR)
+            return;
+    }
+    std::vector<unsigned int> requests = requestStream();
+
+    // Reload per use, like a stack Wav per play
+    double reload = bench::seconds([&] {
+        for (unsigned int id : requests)
+        {
+            SoLoud::Wav wav;
+            wav.load(sfxPath(id).c_str());
+        }
+    });
+
+    SoLoud::SampleCache cache;
+    cache.setBudget(kBudget);
+    unsigned long long peak = 0;
+    double cached = bench::seconds([&] {
+        for (unsigned int id : requests)
+        {
+            SoLoud::Wav* wav = cache.acquire(sfxPath(id).c_str());
+            cache.release(wav);
+            if (cache.getResidentBytes() > peak)
+                peak = cache.getResidentBytes();
+        }
+    });
+
+    out.push_back({"reload", reload * 1e6 / kRequests, "us/request"});
+    out.push_back({"cached", cached * 1e6 / kRequests, "us/request"});
+    out.push_back({"hit_rate", 100.0 * cache.getHitCount() / kRequests, "%"});
+    out.push_back({"evictions", (double)cache.getEvictionCount(), ""});
+    out.push_back({"peak_resident", peak / (1024.0 * 1024.0), "MB"});
+    out.push_back({"budget", kBudget / (1024.0 * 1024.0), "MB"});
+}
@@ -0,0 +1,215 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_file.h"
+#include "soloud_internal.h"
+#include "soloud_wav.h"
+
+#ifndef SOLOUD_BENCH_SFX_DIR
+#define SOLOUD_BENCH_SFX_DIR "sfx"
+#endif
+
+namespace
+{
+    const unsigned int kRate = 44100;
+    const unsigned int kFrames = 4096 * 96;
+
+    void put16le(std::vector<unsigned char>& out, uint16_t v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back(v >> 8);
+    }
+
+    void put32le(std::vector<unsigned char>& out, uint32_t v)
+    {
+        put16le(out, v & 0xffff);
+        put16le(out, v >> 16);
+    }
+
+    int16_t sampleAt(unsigned int frame, unsigned int channel)
+    {
+        return (int16_t)(8000 * std::sin(frame * (0.01 + 0.003 * channel)));
+    }
+
+    // PCM at 8, 16 or 24 bits, or 32-bit float
+    std::vector<unsigned char> makeWave(unsigned int channels, unsigned int bits = 16)
+    {
+        const unsigned int bytes = bits / 8;
+        std::vector<unsigned char> out;
+        out.insert(out.end(), {'R', 'I', 'F', 'F'});
+        put32le(out, 36 + kFrames * channels * bytes);
+        out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        put32le(out, 16);
+        put16le(out, bits == 32 ? 3 : 1);
+        put16le(out, (uint16_t)channels);
+        put32le(out, kRate);
+        put32le(out, kRate * channels * bytes);
+        put16le(out, (uint16_t)(channels * bytes));
+        put16le(out, (uint16_t)bits);
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        put32le(out, kFrames * channels * bytes);
+        for (unsigned int i = 0; i < kFrames; i++)
+            for (unsigned int c = 0; c < channels; c++)
+            {
+                int16_t v = sampleAt(i, c);
+                if (bits == 8)
+                {
+                    out.push_back((unsigned char)((v >> 8) + 128));
+                }
+                else if (bits == 24)
+                {
+                    out.push_back(0);
+                    put16le(out, (uint16_t)v);
+                }
+                else if (bits == 32)
+                {
+                    float f = v / 32768.0f;
+                    uint32_t u;
+                    std::memcpy(&u, &f, 4);
+                    put32le(out, u);
+                }
+                else
+                {
+                    put16le(out, (uint16_t)v);
+                }
+            }
+        return out;
+    }
+
+    unsigned char crc8(const unsigned char* p, size_t n)
+    {
+        unsigned char c = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            c ^= p[i];
+            for (int b = 0; b < 8; b++)
+                c = (c & 0x80) ? (unsigned char)((c << 1) ^ 0x07) : (unsigned char)(c << 1);
+        }
+        return c;
+    }
+
+    uint16_t crc16(const unsigned char* p, size_t n)
+    {
+        uint16_t c = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            c ^= (uint16_t)(p[i] << 8);
+            for (int b = 0; b < 8; b++)
+                c = (c & 0x8000) ? (uint16_t)((c << 1) ^ 0x8005) : (uint16_t)(c << 1);
+        }
+        return c;
+    }
+
+    // A FLAC stream using only VERBATIM subframes: no encoder needed, and decoding
+    // it is mostly bit unpacking, so the deinterleave step is a visible share
+    std::vector<unsigned char> makeFlac(unsigned int channels)
+    {
+        const unsigned int block = 4096;
+        std::vector<unsigned char> out = {'f', 'L', 'a', 'C', 0x80, 0, 0, 34};
+        out.insert(out.end(), {block >> 8, block & 0xff, block >> 8, block & 0xff, 0, 0, 0, 0, 0, 0});
+        uint64_t info = ((uint64_t)kRate << 44) | ((uint64_t)(channels - 1) << 41) | ((uint64_t)15 << 36) | kFrames;
+        for (int b = 7; b >= 0; b--)
+            out.push_back((unsigned char)(info >> (b * 8)));
+        out.insert(out.end(), 16, 0);
+
+        for (unsigned int frame = 0; frame * block < kFrames; frame++)
+        {
+            // Frame numbers stay below 128, so their UTF-8 coding is one byte
+            std::vector<unsigned char> f = {0xff, 0xf8, 0xc9, (unsigned char)(((channels - 1) << 4) | (4 << 1)), (unsigned char)frame};
+            f.push_back(crc8(f.data(), f.size()));
+            for (unsigned int c = 0; c < channels; c++)
+            {
+                f.push_back(0x02);
+                for (unsigned int i = 0; i < block; i++)
+                {
+                    uint16_t v = (uint16_t)sampleAt(frame * block + i, c);
+                    f.push_back(v >> 8);
+                    f.push_back(v & 0xff);
+                }
+            }
+            uint16_t crc = crc16(f.data(), f.size());
+            f.push_back(crc >> 8);
+            f.push_back(crc & 0xff);
+            out.insert(out.end(), f.begin(), f.end());
+        }
+        return out;
+    }
+
+    // The per-sample loop the decoders used before
+    void deinterlaceScalar(const float* src, float* dst, unsigned int frames, unsigned int channels, unsigned int stride)
+    {
+        for (unsigned int j = 0; j < frames; j++)
+            for (unsigned int k = 0; k < channels; k++)
+                dst[k * stride + j] = src[j * channels + k];
+    }
+
+    double decodeRate(const std::vector<unsigned char>& file)
+    {
+        const int kRounds = 5;
+        SoLoud::Wav wav;
+        double t = bench::seconds([&] {
+            for (int r = 0; r < kRounds; r++)
+                wav.loadMem(file.data(), (unsigned int)file.size(), false, false);
+        });
+        return wav.mSampleCount * (double)kRounds / t / 1e6;
+    }
+}
+
+BENCH(deinterlace)
+{
+    const unsigned int kBlock = 512;
+    const int kRounds = 20000;
+    for (unsigned int channels : {1u, 2u, 6u, 8u})
+    {
+        std::vector<float> src(kBlock * channels), dst(kBlock * channels);
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = (float)i;
+        // Vary the input and read the output back so no round can be skipped
+        volatile float sink = 0;
+        double scalar = bench::seconds([&] {
+            for (int r = 0; r < kRounds; r++)
+            {
+                src[0] = (float)r;
+                deinterlaceScalar(src.data(), dst.data(), kBlock, channels, kBlock);
+                sink = dst[r % dst.size()];
+            }
+        });
+        double kernel = bench::seconds([&] {
+            for (int r = 0; r < kRounds; r++)
+            {
+                src[0] = (float)r;
+                SoLoud::deinterlace_frames_float(src.data(), dst.data(), kBlock, channels, channels, kBlock);
+                sink = dst[r % dst.size()];
+            }
+        });
+        (void)sink;
+        std::string name = std::to_string(channels) + "ch";
+        out.push_back({name + "_scalar", scalar * 1e9 / (kRounds * (double)kBlock), "ns/frame"});
+        out.push_back({name + "_kernel", kernel * 1e9 / (kRounds * (double)kBlock), "ns/frame"});
+    }
+}
+
+BENCH(decode_planar)
+{
+    for (unsigned int channels : {1u, 2u, 6u, 8u})
+        out.push_back({"wav_s16_" + std::to_string(channels) + "ch", decodeRate(makeWave(channels)), "Mframes/s"});
+    out.push_back({"wav_u8_2ch", decodeRate(makeWave(2, 8)), "Mframes/s"});
+    out.push_back({"wav_s24_2ch", decodeRate(makeWave(2, 24)), "Mframes/s"});
+    out.push_back({"wav_f32_2ch", decodeRate(makeWave(2, 32)), "Mframes/s"});
+    for (unsigned int channels : {2u, 6u})
+        out.push_back({"flac_" + std::to_string(channels) + "ch", decodeRate(makeFlac(channels)), "Mframes/s"});
+
+    // MS-ADPCM, from the bundled corpus
+    SoLoud::MemoryFile probe;
+    std::string path = std::string(SOLOUD_BENCH_SFX_DIR) + "/1.wav";
+    if (probe.openToMem(path.c_str()) == SoLoud::SO_NO_ERROR)
+    {
+        std::vector<unsigned char> file(probe.getMemPtr(), probe.getMemPtr() + probe.length());
+        out.push_back({"wav_adpcm_1ch", decodeRate(file), "Mframes/s"});
+    }
+}
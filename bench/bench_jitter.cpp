@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_bus.h"
+#include "soloud_wav.h"
+#include "reverb/PSXReverbFilter.h"
+
+// Callback timing as a backend would see it: a thread wakes on a fixed period
+// and mixes one block, with and without Soloud::ENABLE_REALTIME. Start is how
+// late the thread woke past its deadline, end how far past the deadline the block
+// was done; the tail of both is what decides underruns.
+//
+// Environment:
+//   SOLOUD_BENCH_SECONDS  audio rendered per mode, default 3
+//   SOLOUD_BENCH_CPU      CPU the realtime mode pins the thread to, default none
+namespace
+{
+    const unsigned int kDeviceRate = 48000;
+    const unsigned int kBlock = 256;
+    const unsigned int kVoices = 64;
+
+    unsigned int envUint(const char* name, unsigned int fallback)
+    {
+        const char* v = std::getenv(name);
+        return v && std::atoi(v) > 0 ? (unsigned int)std::atoi(v) : fallback;
+    }
+
+    double percentile(std::vector<double>& v, unsigned int pct)
+    {
+        std::sort(v.begin(), v.end());
+        return v[std::min(v.size() - 1, (v.size() * pct) / 100)];
+    }
+}
+
+BENCH(callback_jitter)
+{
+    const unsigned int seconds = envUint("SOLOUD_BENCH_SECONDS", 3);
+    const char* cpuEnv = std::getenv("SOLOUD_BENCH_CPU");
+    const int cpu = cpuEnv ? std::atoi(cpuEnv) : -1;
+
+    SoLoud::Wav wav;
+    std::vector<float> tone(kDeviceRate);
+    for (size_t i = 0; i < tone.size(); i++)
+        tone[i] = 0.5f * std::sin(i * 0.0571f);
+    wav.loadRawWave(tone.data(), (unsigned int)tone.size(), (float)kDeviceRate, 1, true);
+    wav.setLooping(true);
+    PSXReverbFilter reverb;
+
+    for (bool realtime : {false, true}) {
+        SoLoud::Soloud soloud;
+        if (realtime)
+            soloud.setRealtimeParameters(70, cpu);
+        unsigned int flags = SoLoud::Soloud::CLIP_ROUNDOFF | (realtime ? SoLoud::Soloud::ENABLE_REALTIME : 0);
+        // The null driver wants at least SAMPLE_GRANULARITY; blocks are mixed at kBlock regardless
+        if (soloud.init(flags, SoLoud::Soloud::NULLDRIVER, kDeviceRate, SAMPLE_GRANULARITY, 2) != SoLoud::SO_NO_ERROR)
+            return;
+        soloud.setMaxActiveVoiceCount(kVoices + 1);
+
+        // Half the voices go through a reverb bus, half are resampled straight in
+        SoLoud::Bus bus;
+        bus.setFilter(0, &reverb);
+        soloud.play(bus);
+        for (unsigned int i = 0; i < kVoices; i++) {
+            if (i & 1) {
+                bus.play(wav, 0.2f, ((i % 9) - 4) * 0.2f);
+            } else {
+                SoLoud::handle h = soloud.play(wav, 0.2f);
+                soloud.setRelativePlaySpeed(h, 0.8f + (i % 7) * 0.05f);
+            }
+        }
+
+        const unsigned int blocks = seconds * kDeviceRate / kBlock;
+        const auto period = std::chrono::nanoseconds(1000000000ull * kBlock / kDeviceRate);
+        std::vector<double> start, end;
+        start.reserve(blocks);
+        end.reserve(blocks);
+        std::thread mixer([&] {
+            std::vector<float> buffer(kBlock * 2);
+            auto deadline = std::chrono::steady_clock::now() + period;
+            for (unsigned int b = 0; b < blocks; b++, deadline += period) {
+                std::this_thread::sleep_until(deadline);
+                auto woke = std::chrono::steady_clock::now();
+                soloud.mix(buffer.data(), kBlock);
+                auto done = std::chrono::steady_clock::now();
+                start.push_back(std::chrono::duration<double, std::micro>(woke - deadline).count());
+                end.push_back(std::chrono::duration<double, std::micro>(done - deadline).count());
+            }
+        });
+        mixer.join();
+        unsigned int status = soloud.getRealtimeStatus();
+        soloud.deinit();
+
+        std::string name = realtime ? "realtime" : "default";
+        out.push_back({name + "_start_p50", percentile(start, 50), "us"});
+        out.push_back({name + "_start_p99", percentile(start, 99), "us"});
+        out.push_back({name + "_start_max", start.back(), "us"});
+        out.push_back({name + "_end_p50", percentile(end, 50), "us"});
+        out.push_back({name + "_end_p99", percentile(end, 99), "us"});
+        out.push_back({name + "_end_max", end.back(), "us"});
+        if (realtime) {
+            // What the process was allowed; see Soloud::REALTIME_STATUS
+            out.push_back({"realtime_scheduling", (status & SoLoud::Soloud::REALTIME_SCHEDULING) ? 1.0 : 0.0, "bool"});
+            out.push_back({"realtime_pinned", (status & SoLoud::Soloud::REALTIME_PINNED) ? 1.0 : 0.0, "bool"});
+            out.push_back({"realtime_locked_memory", (status & SoLoud::Soloud::REALTIME_LOCKED_MEMORY) ? 1.0 : 0.0, "bool"});
+            out.push_back({"realtime_warmed_up", (status & SoLoud::Soloud::REALTIME_WARMED_UP) ? 1.0 : 0.0, "bool"});
+        }
+        out.push_back({name + "_budget", kBlock * 1e6 / kDeviceRate, "us"});
+    }
+}
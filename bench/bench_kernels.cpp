@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_fft.h"
+#include "soloud_internal.h"
+#include "soloud_wav.h"
+#include "reverb/PSXReverb.hpp"
+
+// Microbenchmarks of the mixer's inner kernels, called directly rather than
+// through mix(), at each of bench::sizes() frames per call.
+namespace
+{
+    const unsigned int kDeviceRate = 44100;
+    // Frames each size gets through, so small sizes don't finish in noise
+    const double kFramesPerSize = 1 << 22;
+
+    unsigned int roundsFor(unsigned int frames)
+    {
+        unsigned int rounds = (unsigned int)(kFramesPerSize / frames);
+        return rounds ? rounds : 1;
+    }
+
+    // Run func() rounds times and return nanoseconds per frame
+    template <typename F>
+    double nsPerFrame(unsigned int frames, F&& func)
+    {
+        unsigned int rounds = roundsFor(frames);
+        double t = bench::seconds([&] {
+            for (unsigned int r = 0; r < rounds; r++)
+                func(r);
+        });
+        return t * 1e9 / ((double)rounds * frames);
+    }
+
+    void fill(std::vector<float>& data, float scale)
+    {
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = scale * std::sin(i * 0.0123f);
+    }
+
+    std::string sized(const char* name, unsigned int frames)
+    {
+        return std::string(name) + "_" + std::to_string(frames);
+    }
+}
+
+BENCH(resample)
+{
+    std::vector<float> src(SAMPLE_GRANULARITY), prev(SAMPLE_GRANULARITY);
+    fill(src, 0.5f);
+    fill(prev, 0.25f);
+
+    // Upsampling 22050 Hz and a near-unity 48000 -> 44100 Hz step
+    const float rates[] = {22050, 48000};
+    for (float rate : rates) {
+        int step = (int)std::floor(rate / kDeviceRate * FIXPOINT_FRAC_MUL);
+        // Output frames one source block yields
+        unsigned int perBlock = (unsigned int)(((long long)SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL - 1) / step);
+        for (unsigned int frames : bench::sizes()) {
+            std::vector<float> dst(frames);
+            double ns = nsPerFrame(frames, [&](unsigned int r) {
+                src[0] = (float)(r & 1);
+                for (unsigned int done = 0; done < frames; done += perBlock) {
+                    unsigned int n = frames - done < perBlock ? frames - done : perBlock;
+                    SoLoud::resample(src.data(), prev.data(), dst.data() + done, 0, n, rate, (float)kDeviceRate, step);
+                }
+            });
+            out.push_back({sized(rate < kDeviceRate ? "up" : "down", frames), ns, "ns/frame"});
+        }
+    }
+}
+
+BENCH(pan_and_expand)
+{
+    SoLoud::Wav wav;
+    std::vector<float> tone(SAMPLE_GRANULARITY);
+    wav.loadRawWave(tone.data(), (unsigned int)tone.size(), (float)kDeviceRate, 1, true);
+
+    // Mono and stereo sources into a stereo bus, and 5.1 into 7.1
+    const unsigned int layouts[][2] = {{1, 2}, {2, 2}, {6, 8}};
+    for (const auto& layout : layouts) {
+        SoLoud::AudioSourceInstance* voice = wav.createInstance();
+        voice->mChannels = layout[0];
+        voice->mOverallVolume = 1.0f;
+        for (unsigned int c = 0; c < MAX_CHANNELS; c++) {
+            voice->mChannelVolume[c] = 0.5f + 0.05f * c;
+            voice->mCurrentChannelVolume[c] = 0.5f;
+        }
+        for (unsigned int frames : bench::sizes()) {
+            std::vector<float> scratch(frames * layout[0]), bus(frames * layout[1]);
+            fill(scratch, 0.5f);
+            double ns = nsPerFrame(frames, [&](unsigned int r) {
+                // Keep the ramp moving, as on a voice being panned
+                voice->mCurrentChannelVolume[0] = (r & 1) ? 0.4f : 0.6f;
+                SoLoud::panAndExpand(voice, bus.data(), frames, frames, scratch.data(), layout[1]);
+            });
+            out.push_back({std::to_string(layout[0]) + "to" + std::to_string(layout[1]) + "_" + std::to_string(frames), ns, "ns/frame"});
+        }
+        delete voice;
+    }
+}
+
+BENCH(clip)
+{
+    const unsigned int flags[] = {0, SoLoud::Soloud::CLIP_ROUNDOFF};
+    for (unsigned int f : flags) {
+        for (unsigned int frames : bench::sizes()) {
+            SoLoud::Soloud soloud;
+            soloud.init(f, SoLoud::Soloud::NULLDRIVER, kDeviceRate, SAMPLE_GRANULARITY, 2);
+            // The clipper works in quads, so planes are padded up to a multiple of four
+            SoLoud::AlignedFloatBuffer src, dst;
+            src.init((frames + 4) * 2);
+            dst.init((frames + 4) * 2);
+            for (unsigned int i = 0; i < (frames + 4) * 2; i++)
+                src.mData[i] = 1.5f * std::sin(i * 0.01f);
+            double ns = nsPerFrame(frames, [&](unsigned int r) {
+                soloud.clip_internal(src, dst, frames, 1.0f, (r & 1) ? 0.9f : 1.0f);
+            });
+            soloud.deinit();
+            out.push_back({sized(f ? "roundoff" : "hard", frames), ns, "ns/frame"});
+        }
+    }
+}
+
+BENCH(interlace)
+{
+    for (unsigned int channels : {1u, 2u, 6u}) {
+        for (unsigned int frames : bench::sizes()) {
+            std::vector<float> src(frames * channels), dst(frames * channels);
+            std::vector<short> dst16(frames * channels);
+            fill(src, 0.9f);
+            std::string name = std::to_string(channels) + "ch_" + std::to_string(frames);
+            out.push_back({"float_" + name, nsPerFrame(frames, [&](unsigned int r) {
+                src[0] = (float)(r & 1);
+                SoLoud::interlace_samples_float(src.data(), dst.data(), frames, channels);
+            }), "ns/frame"});
+            out.push_back({"s16_" + name, nsPerFrame(frames, [&](unsigned int r) {
+                src[0] = (float)(r & 1);
+                SoLoud::interlace_samples_s16(src.data(), dst16.data(), frames, channels);
+            }), "ns/frame"});
+        }
+    }
+}
+
+// The reverb's own run(), outside the filter wrapper, once per preset
+BENCH(psx_reverb)
+{
+    const unsigned int frames = bench::sizes().back();
+    std::vector<float> left(frames), right(frames), outLeft(frames), outRight(frames);
+    fill(left, 0.3f);
+    fill(right, 0.2f);
+    float wet = 0, dry = 0, master = 0;
+
+    for (int preset = 0; preset < NUM_PRESETS; preset++) {
+        PsxReverb reverb;
+        activate(&reverb);
+        float presetPort = (float)preset;
+        setPort(&reverb, PortIndex::PSX_REV_WET, &wet);
+        setPort(&reverb, PortIndex::PSX_REV_DRY, &dry);
+        setPort(&reverb, PortIndex::PSX_REV_PRESET, &presetPort);
+        setPort(&reverb, PortIndex::PSX_REV_MASTER, &master);
+        setPort(&reverb, PortIndex::PSX_REV_MAIN0_IN, left.data());
+        setPort(&reverb, PortIndex::PSX_REV_MAIN1_IN, right.data());
+        setPort(&reverb, PortIndex::PSX_REV_MAIN0_OUT, outLeft.data());
+        setPort(&reverb, PortIndex::PSX_REV_MAIN1_OUT, outRight.data());
+        double ns = nsPerFrame(frames, [&](unsigned int) {
+            run(&reverb, frames);
+        });
+        out.push_back({"preset" + std::to_string(preset), ns, "ns/frame"});
+    }
+}
+
+BENCH(fft)
+{
+    std::vector<float> data(1024), work(1024);
+    fill(data, 1.0f);
+    const unsigned int rounds = 20000;
+    double t256 = bench::seconds([&] {
+        for (unsigned int r = 0; r < rounds; r++) {
+            std::copy(data.begin(), data.begin() + 256, work.begin());
+            SoLoud::FFT::fft256(work.data());
+        }
+    });
+    double t1024 = bench::seconds([&] {
+        for (unsigned int r = 0; r < rounds; r++) {
+            std::copy(data.begin(), data.end(), work.begin());
+            SoLoud::FFT::fft1024(work.data());
+        }
+    });
+    out.push_back({"fft256", t256 * 1e9 / rounds, "ns/call"});
+    out.push_back({"fft1024", t1024 * 1e9 / rounds, "ns/call"});
+}
+
+// Voice selection and 3D updates scale with voices, not frames
+BENCH(voice_kernels)
+{
+    SoLoud::Wav wav;
+    std::vector<float> tone(kDeviceRate);
+    fill(tone, 0.5f);
+    wav.loadRawWave(tone.data(), (unsigned int)tone.size(), (float)kDeviceRate, 1, true);
+    wav.setLooping(true);
+    wav.set3dMinMaxDistance(1, 200);
+
+    for (unsigned int voices : {64u, 256u, 1024u}) {
+        SoLoud::Soloud soloud;
+        soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, SAMPLE_GRANULARITY, 2);
+        soloud.setMaxActiveVoiceCount(64);
+        soloud.set3dListenerParameters(0, 0, 0, 0, 0, 1, 0, 1, 0);
+        std::vector<unsigned int> list;
+        for (unsigned int i = 0; i < voices; i++) {
+            float a = i * 0.37f;
+            soloud.play3d(wav, 50 * std::cos(a), 0, 50 * std::sin(a), 0, 0, 0, 0.2f + (i % 7) * 0.1f);
+        }
+        for (unsigned int i = 0; i < voices; i++)
+            list.push_back(i);
+
+        const unsigned int rounds = 2000;
+        double tActive = bench::seconds([&] {
+            for (unsigned int r = 0; r < rounds; r++)
+                soloud.calcActiveVoices_internal();
+        });
+        double t3d = bench::seconds([&] {
+            for (unsigned int r = 0; r < rounds; r++)
+                soloud.update3dVoices_internal(list.data(), voices);
+        });
+        soloud.deinit();
+        out.push_back({sized("active_voices", voices), tActive * 1e9 / rounds, "ns/call"});
+        out.push_back({sized("update3d", voices), t3d * 1e9 / rounds, "ns/call"});
+    }
+}
+
+// update3dVoices_internal alone, over a level's worth of emitters with mixed
+// attenuation models and moving sources. VOICE_COUNT caps real voices at 1024, so
+// the larger counts go over the same voices again; the work per emitter is the same.
+BENCH(update3d)
+{
+    SoLoud::Wav wav;
+    std::vector<float> tone(SAMPLE_GRANULARITY);
+    wav.loadRawWave(tone.data(), (unsigned int)tone.size(), (float)kDeviceRate, 1, true);
+    wav.setLooping(true);
+    wav.set3dMinMaxDistance(1, 200);
+
+    SoLoud::Soloud soloud;
+    soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, SAMPLE_GRANULARITY, 2);
+    soloud.set3dListenerParameters(0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0);
+    const unsigned int voices = VOICE_COUNT - 1;
+    for (unsigned int i = 0; i < voices; i++) {
+        float a = i * 0.37f;
+        SoLoud::handle h = soloud.play3d(wav, 50 * std::cos(a), (i % 5) - 2.0f, 50 * std::sin(a), std::sin(a), 0, std::cos(a), 0.5f);
+        // Mostly the default inverse distance, some linear and exponential
+        if (i % 8 == 3)
+            soloud.set3dSourceAttenuation(h, SoLoud::AudioSource::LINEAR_DISTANCE, 1);
+        else if (i % 8 == 5)
+            soloud.set3dSourceAttenuation(h, SoLoud::AudioSource::EXPONENTIAL_DISTANCE, 0.5f);
+    }
+
+    for (unsigned int emitters : {64u, 256u, 512u, 1024u, 2048u, 4096u}) {
+        std::vector<unsigned int> list(emitters);
+        for (unsigned int i = 0; i < emitters; i++)
+            list[i] = i % voices;
+        const unsigned int rounds = 4000000 / emitters;
+        double t = bench::seconds([&] {
+            for (unsigned int r = 0; r < rounds; r++)
+                soloud.update3dVoices_internal(list.data(), emitters);
+        });
+        out.push_back({sized("emitters", emitters), t * 1e9 / rounds, "ns/call"});
+        out.push_back({sized("per_emitter", emitters), t * 1e9 / rounds / emitters, "ns"});
+    }
+    soloud.deinit();
+}
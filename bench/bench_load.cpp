@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_decodecache.h"
+#include "soloud_file.h"
+#include "soloud_soundbank.h"
+#include "soloud_wav.h"
+#include "soloud_wavloader.h"
+#include "soloud_wavstream.h"
+
+#ifndef SOLOUD_BENCH_SFX_DIR
+#define SOLOUD_BENCH_SFX_DIR "sfx"
+#endif
+
+namespace
+{
+    // Numeric file names become bank ids, as soloud_bankbuild does
+    bool bankId(const std::string& file, unsigned int& id)
+    {
+        std::string stem = std::filesystem::path(file).stem().string();
+        if (stem.empty() || stem.find_first_not_of("0123456789") != std::string::npos || stem.size() > 9)
+            return false;
+        id = (unsigned int)std::stoul(stem);
+        return true;
+    }
+
+    // SOLOUD_BENCH_SFX overrides the sample directory baked in at build time
+    std::vector<std::string> sfxFiles()
+    {
+        const char* dir = std::getenv("SOLOUD_BENCH_SFX");
+        if (!dir)
+            dir = SOLOUD_BENCH_SFX_DIR;
+
+        std::vector<std::string> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // open and mmap system calls func() makes. func() runs in a forked child that
+    // stops on every system call entry under ptrace, so the calls are counted
+    // wherever they come from (stdio included). Returns false where the child
+    // can't be traced (not Linux, or ptrace denied); func() must not start threads.
+    struct SyscallCount
+    {
+        double opens;
+        double mmaps;
+    };
+
+    template <typename F>
+    bool countSyscalls(F&& func, SyscallCount& count)
+    {
+        count.opens = count.mmaps = 0;
+#if defined(__linux__) && defined(PTRACE_GET_SYSCALL_INFO)
+        pid_t pid = fork();
+        if (pid < 0)
+            return false;
+        if (pid == 0)
+        {
+            if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+                _exit(1);
+            raise(SIGSTOP);
+            func();
+            _exit(0);
+        }
+
+        int status;
+        if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status))
+            return false;
+        ptrace(PTRACE_SETOPTIONS, pid, nullptr, (void*)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+        int sig = 0;
+        for (;;)
+        {
+            if (ptrace(PTRACE_SYSCALL, pid, nullptr, (void*)(long)sig) != 0 || waitpid(pid, &status, 0) != pid)
+                return false;
+            if (WIFEXITED(status))
+                return WEXITSTATUS(status) == 0;
+            if (WIFSIGNALED(status))
+                return false;
+            sig = 0;
+            if (WSTOPSIG(status) != (SIGTRAP | 0x80))
+            {
+                // Pass real signals on to the child
+                sig = WSTOPSIG(status);
+                continue;
+            }
+            struct __ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void*)sizeof(info), &info) <= 0 || info.op != PTRACE_SYSCALL_INFO_ENTRY)
+                continue;
+            long nr = (long)info.entry.nr;
+            if (nr == SYS_openat
+#ifdef SYS_open
+                || nr == SYS_open
+#endif
+#ifdef SYS_openat2
+                || nr == SYS_openat2
+#endif
+                )
+                count.opens++;
+            if (nr == SYS_mmap
+#ifdef SYS_mmap2
+                || nr == SYS_mmap2
+#endif
+                )
+                count.mmaps++;
+        }
+#else
+        (void)func;
+        return false;
+#endif
+    }
+
+    // Load every file with func() and report throughput
+    template <typename F>
+    void loadAll(std::vector<bench::Measurement>& out, const std::string& name, const std::vector<std::string>& files, F&& func)
+    {
+        double bytes = 0;
+        unsigned int failed = 0;
+        double t = bench::seconds([&] {
+            for (const auto& file : files)
+            {
+                if (!func(file.c_str()))
+                    failed++;
+            }
+        });
+        for (const auto& file : files)
+        {
+            std::error_code ec;
+            bytes += (double)std::filesystem::file_size(file, ec);
+        }
+        out.push_back({name + "_files", files.size() / t, "files/s"});
+        out.push_back({name + "_throughput", bytes / t / (1024.0 * 1024.0), "MB/s"});
+        if (failed)
+            out.push_back({name + "_failed", (double)failed, "files"});
+    }
+}
+
+BENCH(load_sfx)
+{
+    std::vector<std::string> files = sfxFiles();
+    if (files.empty())
+        return;
+
+    // Warm the page cache so every variant measures decoding, not the disk
+    for (const auto& file : files)
+    {
+        SoLoud::MappedFile mf;
+        mf.open(file.c_str());
+    }
+
+    // Read the whole file into a heap copy first (the old Wav::load path)
+    loadAll(out, "wav_copy", files, [](const char* file) {
+        SoLoud::MemoryFile mf;
+        if (mf.openToMem(file) != SoLoud::SO_NO_ERROR)
+            return false;
+        SoLoud::Wav wav;
+        return wav.loadFile(&mf) == SoLoud::SO_NO_ERROR;
+    });
+
+    loadAll(out, "wav_mapped", files, [](const char* file) {
+        SoLoud::Wav wav;
+        return wav.load(file) == SoLoud::SO_NO_ERROR;
+    });
+
+    loadAll(out, "wavstream_to_mem", files, [](const char* file) {
+        SoLoud::WavStream stream;
+        return stream.loadToMem(file) == SoLoud::SO_NO_ERROR;
+    });
+}
+
+BENCH(load_bank)
+{
+    std::vector<std::string> files = sfxFiles();
+    std::vector<unsigned int> ids;
+    std::vector<const char*> names;
+    for (const auto& file : files)
+    {
+        unsigned int id;
+        if (bankId(file, id))
+        {
+            ids.push_back(id);
+            names.push_back(file.c_str());
+        }
+    }
+    if (ids.empty())
+        return;
+
+    std::string dir = std::filesystem::temp_directory_path().string();
+    std::string bankName = dir + "/soloud_bench.bank";
+    std::string floatBankName = dir + "/soloud_bench_float.bank";
+    // The float bank is ~8x the ADPCM corpus, so only pack a slice of it
+    unsigned int floatCount = std::min<unsigned int>((unsigned int)ids.size(), 64);
+    if (SoLoud::SoundBank::write(bankName.c_str(), ids.data(), names.data(), (unsigned int)ids.size(), false) != SoLoud::SO_NO_ERROR ||
+        SoLoud::SoundBank::write(floatBankName.c_str(), ids.data(), names.data(), floatCount, true) != SoLoud::SO_NO_ERROR)
+    {
+        out.push_back({"write_failed", 1, ""});
+        return;
+    }
+
+    // Start-up cost of getting every sound ready to play: one open and mapping
+    // per file, versus one open and mapping for the bank plus an index lookup per
+    // sound. The files are warmed first like the bank that was just written, so
+    // neither waits on the disk.
+    unsigned int n = (unsigned int)ids.size();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        SoLoud::MappedFile mf;
+        mf.open(names[i]);
+    }
+    auto perFileLoad = [&] {
+        for (unsigned int i = 0; i < n; i++)
+        {
+            SoLoud::Wav wav;
+            wav.load(names[i]);
+        }
+    };
+    auto bankLoad = [&] {
+        SoLoud::SoundBank sb;
+        sb.open(bankName.c_str());
+        for (unsigned int i = 0; i < n; i++)
+        {
+            SoLoud::Wav wav;
+            wav.loadBank(&sb, ids[i]);
+        }
+    };
+    double perFile = bench::seconds(perFileLoad);
+    double bank = bench::seconds(bankLoad);
+    out.push_back({"sounds", (double)n, ""});
+    out.push_back({"per_file_total", perFile * 1e3, "ms"});
+    out.push_back({"bank_total", bank * 1e3, "ms"});
+    // Counted in separate traced runs; tracing makes every system call slow
+    SyscallCount perFileCalls, bankCalls;
+    if (countSyscalls(perFileLoad, perFileCalls) && countSyscalls(bankLoad, bankCalls))
+    {
+        out.push_back({"per_file_open_syscalls", perFileCalls.opens, ""});
+        out.push_back({"per_file_mmap_syscalls", perFileCalls.mmaps, ""});
+        out.push_back({"bank_open_syscalls", bankCalls.opens, ""});
+        out.push_back({"bank_mmap_syscalls", bankCalls.mmaps, ""});
+    }
+
+    // Decoded entries are an index lookup plus a pointer into the mapping
+    const int kRounds = 1000;
+    SoLoud::SoundBank sb;
+    sb.open(floatBankName.c_str());
+    double zeroCopy = bench::seconds([&] {
+        SoLoud::Wav wav;
+        for (int r = 0; r < kRounds; r++)
+        {
+            for (unsigned int i = 0; i < floatCount; i++)
+                wav.loadBank(&sb, ids[i]);
+        }
+    });
+    out.push_back({"float_load", zeroCopy * 1e9 / (kRounds * floatCount), "ns/sound"});
+    sb.close();
+
+    std::filesystem::remove(bankName);
+    std::filesystem::remove(floatBankName);
+}
+
+BENCH(load_parallel)
+{
+    std::vector<std::string> files = sfxFiles();
+    if (files.empty())
+        return;
+    std::vector<const char*> names;
+    for (const auto& file : files)
+        names.push_back(file.c_str());
+    unsigned int n = (unsigned int)names.size();
+
+    double serial = bench::seconds([&] {
+        for (unsigned int i = 0; i < n; i++)
+        {
+            SoLoud::Wav wav;
+            wav.load(names[i]);
+        }
+    });
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    SoLoud::WavLoader loader;
+    loader.init((int)threads);
+    std::unique_ptr<SoLoud::Wav[]> wavs(new SoLoud::Wav[n]);
+    double parallel = bench::seconds([&] {
+        loader.loadBatch(wavs.get(), names.data(), n);
+        loader.waitAll();
+    });
+
+    out.push_back({"serial", n / serial, "files/s"});
+    out.push_back({"threads", (double)threads, ""});
+    out.push_back({"batch", n / parallel, "files/s"});
+}
+
+BENCH(decode_cache)
+{
+    std::vector<std::string> files = sfxFiles();
+    if (files.empty())
+        return;
+
+    std::string dir = (std::filesystem::temp_directory_path() / "soloud_bench_decodecache").string();
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    auto loadAllWithCache = [&](SoLoud::DecodeCache* cache) {
+        SoLoud::Wav::setDecodeCache(cache);
+        double t = bench::seconds([&] {
+            for (const auto& file : files)
+            {
+                SoLoud::Wav wav;
+                wav.load(file.c_str());
+            }
+        });
+        SoLoud::Wav::setDecodeCache(nullptr);
+        return t;
+    };
+
+    double none = loadAllWithCache(nullptr);
+    out.push_back({"uncached", none * 1e3, "ms"});
+
+    const struct
+    {
+        const char* name;
+        unsigned int format;
+    } formats[] = {{"f32", SoLoud::DECODECACHE_F32}, {"s16", SoLoud::DECODECACHE_S16}};
+    for (const auto& f : formats)
+    {
+        SoLoud::DecodeCache cache;
+        cache.init(dir.c_str(), f.format);
+        // Cold: decode and write the cache; warm: map the cached samples
+        double cold = loadAllWithCache(&cache);
+        double warm = loadAllWithCache(&cache);
+        out.push_back({std::string(f.name) + "_cold", cold * 1e3, "ms"});
+        out.push_back({std::string(f.name) + "_warm", warm * 1e3, "ms"});
+        out.push_back({std::string(f.name) + "_hits", (double)cache.getHitCount(), ""});
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+// Load time analysis over the sfx corpus: what trimming near-silence saves at
+// -90 and -60 dBFS, and what trimming plus the loudness envelope cost.
+BENCH(trim_sfx)
+{
+    std::vector<std::string> files = sfxFiles();
+    if (files.empty())
+        return;
+
+    double frames = 0;
+    double plain = bench::seconds([&] {
+        for (const auto& file : files) {
+            SoLoud::Wav wav;
+            if (wav.load(file.c_str()) == SoLoud::SO_NO_ERROR)
+                frames += wav.mSampleCount;
+        }
+    });
+    out.push_back({"load", plain * 1e3, "ms"});
+
+    const struct
+    {
+        const char* name;
+        float threshold;
+    } levels[] = {{"90db", 1.0f / 32768}, {"60db", 1.0f / 1024}};
+    for (const auto& level : levels) {
+        double kept = 0;
+        double analyzed = bench::seconds([&] {
+            for (const auto& file : files) {
+                SoLoud::Wav wav;
+                wav.setTrimSilence(level.threshold);
+                wav.setAnalyzeLoudness(true);
+                if (wav.load(file.c_str()) == SoLoud::SO_NO_ERROR)
+                    kept += wav.mSampleCount;
+            }
+        });
+        out.push_back({std::string("load_trim_analyze_") + level.name, analyzed * 1e3, "ms"});
+        out.push_back({std::string("trimmed_") + level.name, frames > 0 ? 100 * (frames - kept) / frames : 0, "%"});
+    }
+}
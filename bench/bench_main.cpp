@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "bench.h"
+
+namespace bench
+{
+    std::vector<Entry>& registry()
+    {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+
+    std::vector<unsigned int>& sizeList()
+    {
+        static std::vector<unsigned int> list = {128, 512, 4096};
+        return list;
+    }
+
+    const std::vector<unsigned int>& sizes()
+    {
+        return sizeList();
+    }
+
+    std::vector<std::string>& failures()
+    {
+        static std::vector<std::string> list;
+        return list;
+    }
+
+    void fail(const std::string& why)
+    {
+        failures().push_back(why);
+    }
+}
+
+namespace
+{
+    bool parseSizes(const char* text, std::vector<unsigned int>& out)
+    {
+        out.clear();
+        while (*text) {
+            char* end;
+            unsigned long v = std::strtoul(text, &end, 10);
+            if (end == text || v == 0 || v > (1u << 20))
+                return false;
+            if (*end && *end != ',')
+                return false;
+            out.push_back((unsigned int)v);
+            text = *end ? end + 1 : end;
+        }
+        return !out.empty();
+    }
+
+    std::string jsonString(const std::string& s)
+    {
+        std::string r = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                r += '\\';
+            r += c;
+        }
+        return r + "\"";
+    }
+}
+
+// Usage: soloud_bench [--json[=file]] [--sizes=128,512,4096] [filter]
+// Runs every benchmark whose name contains the filter string. --json writes all
+// results as one JSON document (to stdout, or to file) for comparing runs. Exits
+// with 1 if a benchmark that checks results (tick_parity) found a mismatch.
+int main(int argc, char** argv)
+{
+    const char* filter = "";
+    bool json = false;
+    const char* jsonPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--json")) {
+            json = true;
+        } else if (!std::strncmp(argv[i], "--json=", 7)) {
+            json = true;
+            jsonPath = argv[i] + 7;
+        } else if (!std::strncmp(argv[i], "--sizes=", 8)) {
+            if (!parseSizes(argv[i] + 8, bench::sizeList())) {
+                std::cerr << "bad --sizes list: " << argv[i] + 8 << std::endl;
+                return 1;
+            }
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    std::string doc = "{\n  \"sizes\": [";
+    for (size_t i = 0; i < bench::sizes().size(); i++)
+        doc += (i ? ", " : "") + std::to_string(bench::sizes()[i]);
+    doc += "],\n  \"results\": [";
+    bool first = true;
+
+    for (const bench::Entry& entry : bench::registry()) {
+        if (!std::strstr(entry.name, filter))
+            continue;
+
+        std::vector<bench::Measurement> results;
+        size_t failed = bench::failures().size();
+        entry.func(results);
+        for (size_t i = failed; i < bench::failures().size(); i++)
+            bench::failures()[i] = std::string(entry.name) + ": " + bench::failures()[i];
+
+        for (const bench::Measurement& m : results) {
+            if (!json) {
+                std::cout << entry.name << "/" << m.name << ": " << m.value << " " << m.unit << std::endl;
+                continue;
+            }
+            char value[64] = "null";
+            if (std::isfinite(m.value))
+                std::snprintf(value, sizeof(value), "%.9g", m.value);
+            doc += first ? "\n" : ",\n";
+            doc += "    {\"bench\": " + jsonString(entry.name) + ", \"name\": " + jsonString(m.name) +
+                   ", \"value\": " + value + ", \"unit\": " + jsonString(m.unit) + "}";
+            first = false;
+            // Progress, so long runs don't look hung
+            if (jsonPath)
+                std::cout << entry.name << "/" << m.name << ": " << m.value << " " << m.unit << std::endl;
+        }
+    }
+
+    if (json) {
+        doc += "\n  ]\n}\n";
+        if (!jsonPath) {
+            std::cout << doc;
+        } else {
+            FILE* f = std::fopen(jsonPath, "w");
+            if (!f || std::fputs(doc.c_str(), f) < 0) {
+                std::cerr << "can't write " << jsonPath << std::endl;
+                if (f)
+                    std::fclose(f);
+                return 1;
+            }
+            std::fclose(f);
+        }
+    }
+
+    for (const std::string& why : bench::failures())
+        std::cerr << "FAILED " << why << std::endl;
+    return bench::failures().empty() ? 0 : 1;
+}
@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_bus.h"
+#include "soloud_trace.h"
+#include "soloud_wav.h"
+#include "soloud_wavstream.h"
+
+namespace
+{
+    const unsigned int kDeviceRate = 44100;
+    const unsigned int kBlock = 4096;
+    const unsigned int kVoices = 32;
+    const unsigned int kBlocks = 400;
+
+    // Two seconds of a tone with some overtones, so nothing is silent
+    void makeTone(SoLoud::Wav& wav, float samplerate, unsigned int channels)
+    {
+        unsigned int frames = (unsigned int)(samplerate * 2);
+        std::vector<float> data(frames * channels);
+        for (unsigned int c = 0; c < channels; c++)
+            for (unsigned int i = 0; i < frames; i++)
+                data[c * frames + i] = 0.1f * std::sin(i * 0.031f * (c + 1)) + 0.05f * std::sin(i * 0.173f);
+        wav.loadRawWave(data.data(), frames * channels, samplerate, channels, true);
+    }
+
+    void put16(std::vector<unsigned char>& out, uint16_t v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back(v >> 8);
+    }
+
+    void put32(std::vector<unsigned char>& out, uint32_t v)
+    {
+        put16(out, v & 0xffff);
+        put16(out, v >> 16);
+    }
+
+    // The same tone as a 16-bit mono RIFF wave, for going through the loaders
+    std::vector<unsigned char> makeToneFile(unsigned int samplerate, unsigned int seconds)
+    {
+        const unsigned int frames = samplerate * seconds;
+        std::vector<unsigned char> out;
+        out.insert(out.end(), {'R', 'I', 'F', 'F'});
+        put32(out, 36 + frames * 2);
+        out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        put32(out, 16);
+        put16(out, 1);
+        put16(out, 1);
+        put32(out, samplerate);
+        put32(out, samplerate * 2);
+        put16(out, 2);
+        put16(out, 16);
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        put32(out, frames * 2);
+        for (unsigned int i = 0; i < frames; i++)
+            put16(out, (uint16_t)(int16_t)(3000 * std::sin(i * 0.031f) + 1500 * std::sin(i * 0.173f)));
+        return out;
+    }
+
+    // Nanoseconds spent mixing one output frame of one voice
+    double mixCost(SoLoud::Wav& wav, unsigned int flags = SoLoud::Soloud::CLIP_ROUNDOFF)
+    {
+        SoLoud::Soloud soloud;
+        soloud.init(flags, SoLoud::Soloud::NULLDRIVER, kDeviceRate, kBlock, 2);
+        soloud.setMaxActiveVoiceCount(kVoices);
+
+        for (unsigned int i = 0; i < kVoices; i++) {
+            SoLoud::handle h = soloud.play(wav, 0.5f, (i % 3) - 1.0f);
+            soloud.setLooping(h, true);
+        }
+
+        std::vector<float> out(kBlock * 2);
+        for (int i = 0; i < 10; i++)
+            soloud.mix(out.data(), kBlock);
+
+        double elapsed = bench::seconds([&] {
+            for (unsigned int i = 0; i < kBlocks; i++)
+                soloud.mix(out.data(), kBlock);
+        });
+
+        soloud.deinit();
+        return elapsed * 1e9 / ((double)kVoices * kBlocks * kBlock);
+    }
+
+    double mixCost(float samplerate, unsigned int channels)
+    {
+        SoLoud::Wav wav;
+        makeTone(wav, samplerate, channels);
+        return mixCost(wav);
+    }
+}
+
+// Per-voice mixing cost at the device rate (the direct path) against sources
+// that need resampling.
+BENCH(mix_voice)
+{
+    out.push_back({"mono_44100", mixCost(44100, 1), "ns/frame"});
+    out.push_back({"stereo_44100", mixCost(44100, 2), "ns/frame"});
+    out.push_back({"mono_22050", mixCost(22050, 1), "ns/frame"});
+    out.push_back({"mono_48000", mixCost(48000, 1), "ns/frame"});
+}
+
+// Cost of keeping inaudible voices ticking (distant looping 3d emitters)
+BENCH(tick_inaudible)
+{
+    const unsigned int voices = 200;
+
+    SoLoud::Soloud soloud;
+    soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, kBlock, 2);
+    soloud.setMaxActiveVoiceCount(voices);
+
+    SoLoud::Wav wav;
+    makeTone(wav, 22050, 1);
+    wav.setInaudibleBehavior(true, false);
+    wav.setLooping(true);
+
+    for (unsigned int i = 0; i < voices; i++)
+        soloud.play3d(wav, 0, 0, 0, 0, 0, 0, 0.0f);
+
+    std::vector<float> buffer(kBlock * 2);
+    double elapsed = bench::seconds([&] {
+        for (unsigned int i = 0; i < kBlocks; i++)
+            soloud.mix(buffer.data(), kBlock);
+    });
+
+    soloud.deinit();
+    out.push_back({"mono_22050", elapsed * 1e9 / ((double)voices * kBlocks * kBlock), "ns/frame"});
+}
+
+namespace
+{
+    // Sources that can't report their frame are ticked by decoding into the resample
+    // buffers, as every source was before advance()
+    class DecodingWavInstance : public SoLoud::WavInstance
+    {
+    public:
+        explicit DecodingWavInstance(SoLoud::Wav* aParent) : SoLoud::WavInstance(aParent) {}
+        unsigned int tellFrame() override { return NO_FRAME; }
+    };
+
+    class DecodingWav : public SoLoud::Wav
+    {
+    public:
+        SoLoud::AudioSourceInstance* createInstance() override { return new DecodingWavInstance(this); }
+    };
+
+    class DecodingWavStreamInstance : public SoLoud::WavStreamInstance
+    {
+    public:
+        explicit DecodingWavStreamInstance(SoLoud::WavStream* aParent) : SoLoud::WavStreamInstance(aParent) {}
+        unsigned int tellFrame() override { return NO_FRAME; }
+    };
+
+    class DecodingWavStream : public SoLoud::WavStream
+    {
+    public:
+        SoLoud::AudioSourceInstance* createInstance() override { return new DecodingWavStreamInstance(this); }
+    };
+}
+
+// Inaudible ticking through advance() against the decode-and-discard ticking it
+// replaced, and against voices that are never made inaudible and so are fully
+// decoded and resampled. Looping Wav and WavStream voices at mixed speeds, loop
+// points and delays play audible, are held inaudible long enough to loop, and
+// turn audible again. After every block the stream positions, loop counts and
+// resampler offsets of all three have to agree, and the output has to match
+// the decode-and-discard mix throughout and the always audible one outside the
+// held stretch. Any mismatch fails the run.
+BENCH(tick_parity)
+{
+    const unsigned int voices = 12;
+    const unsigned int audibleBlocks = 20;
+    const unsigned int inaudibleBlocks = 77;
+    const unsigned int blocks = audibleBlocks * 2 + inaudibleBlocks;
+    enum { ADVANCE, DECODE, AUDIBLE, ENGINES };
+    std::vector<unsigned char> file = makeToneFile(8000, 1);
+
+    SoLoud::Wav wav[2];
+    SoLoud::WavStream stream[2];
+    DecodingWav decodingWav;
+    DecodingWavStream decodingStream;
+    SoLoud::AudioSource* sources[ENGINES][2] = {{&wav[0], &stream[0]}, {&decodingWav, &decodingStream}, {&wav[1], &stream[1]}};
+    for (auto& pair : sources) {
+        if (static_cast<SoLoud::Wav*>(pair[0])->loadMem(file.data(), (unsigned int)file.size(), false, false) != SoLoud::SO_NO_ERROR ||
+            static_cast<SoLoud::WavStream*>(pair[1])->loadMem(file.data(), (unsigned int)file.size(), false, false) != SoLoud::SO_NO_ERROR) {
+            bench::fail("could not load the test tone");
+            return;
+        }
+        pair[0]->setLoopPoint(0.25);
+        pair[1]->setLoopPoint(0.1);
+        for (SoLoud::AudioSource* source : pair) {
+            source->setLooping(true);
+            source->setInaudibleBehavior(true, false);
+        }
+    }
+
+    SoLoud::Soloud soloud[ENGINES];
+    SoLoud::handle handles[ENGINES][voices];
+    for (int e = 0; e < ENGINES; e++) {
+        soloud[e].init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, SAMPLE_GRANULARITY, 2);
+        soloud[e].setMaxActiveVoiceCount(voices);
+        for (unsigned int i = 0; i < voices; i++) {
+            SoLoud::handle h = soloud[e].play3d(*sources[e][i & 1], (float)i - 6, 0, 1, 0, 0, 0, 0.5f, true);
+            soloud[e].setRelativePlaySpeed(h, 0.6f + 0.13f * i);
+            soloud[e].setDelaySamples(h, i * 97);
+            soloud[e].setPause(h, false);
+            handles[e][i] = h;
+        }
+    }
+
+    std::vector<float> buffer[ENGINES];
+    for (std::vector<float>& b : buffer)
+        b.resize(SAMPLE_GRANULARITY * 2);
+    unsigned int positions = 0, loops = 0, srcOffsets = 0, decodeOutputs = 0, audibleOutputs = 0, ticked = 0;
+    for (unsigned int b = 0; b < blocks; b++) {
+        for (int e = 0; e < ENGINES; e++) {
+            if (b == audibleBlocks || b == audibleBlocks + inaudibleBlocks) {
+                if (e != AUDIBLE) {
+                    for (SoLoud::handle h : handles[e])
+                        soloud[e].setVolume(h, b == audibleBlocks ? 0.0f : 0.5f);
+                }
+                soloud[e].update3dAudio();
+            }
+            soloud[e].mix(buffer[e].data(), SAMPLE_GRANULARITY);
+        }
+
+        if (buffer[ADVANCE] != buffer[DECODE])
+            decodeOutputs++;
+        bool held = b >= audibleBlocks && b < audibleBlocks + inaudibleBlocks;
+        if (!held && buffer[ADVANCE] != buffer[AUDIBLE])
+            audibleOutputs++;
+        for (unsigned int i = 0; i < voices; i++) {
+            SoLoud::handle h0 = handles[ADVANCE][i];
+            SoLoud::AudioSourceInstance* v0 = soloud[ADVANCE].mVoice[soloud[ADVANCE].getVoiceFromHandle_internal(h0)];
+            for (int e = DECODE; e < ENGINES; e++) {
+                SoLoud::handle h = handles[e][i];
+                SoLoud::AudioSourceInstance* v = soloud[e].mVoice[soloud[e].getVoiceFromHandle_internal(h)];
+                if (soloud[ADVANCE].getStreamPosition(h0) != soloud[e].getStreamPosition(h))
+                    positions++;
+                if (soloud[ADVANCE].getLoopCount(h0) != soloud[e].getLoopCount(h))
+                    loops++;
+                if (v0->mSrcOffset != v->mSrcOffset)
+                    srcOffsets++;
+            }
+            if (v0->mFlags & SoLoud::AudioSourceInstance::INAUDIBLE)
+                ticked++;
+        }
+    }
+
+    unsigned int looped = 0;
+    for (SoLoud::handle h : handles[ADVANCE])
+        looped += soloud[ADVANCE].getLoopCount(h);
+    for (SoLoud::Soloud& s : soloud)
+        s.deinit();
+
+    out.push_back({"voice_blocks", (double)voices * blocks, ""});
+    out.push_back({"ticked_voice_blocks", (double)ticked, ""});
+    out.push_back({"loops", (double)looped, ""});
+    out.push_back({"position_mismatches", (double)positions, ""});
+    out.push_back({"loop_count_mismatches", (double)loops, ""});
+    out.push_back({"src_offset_mismatches", (double)srcOffsets, ""});
+    out.push_back({"decode_output_mismatches", (double)decodeOutputs, "blocks"});
+    out.push_back({"audible_output_mismatches", (double)audibleOutputs, "blocks"});
+
+    // The voices have to have been ticked and looped while inaudible, or the check proves nothing
+    if (ticked != voices * inaudibleBlocks || !looped)
+        bench::fail("voices were not ticked and looped while inaudible");
+    if (positions || loops || srcOffsets || decodeOutputs || audibleOutputs)
+        bench::fail("advance() diverged from decoding");
+}
+
+// Converting an 11025 Hz sound to the device rate once at load time: the load
+// cost, and the per-voice mixing cost with and without it.
+BENCH(load_resample)
+{
+    const unsigned int seconds = 10;
+    std::vector<unsigned char> file = makeToneFile(11025, seconds);
+
+    SoLoud::Wav plain;
+    double plainLoad = bench::seconds([&] {
+        plain.loadMem(file.data(), (unsigned int)file.size(), false, false);
+    });
+
+    SoLoud::Wav converted;
+    converted.setLoadSamplerate((float)kDeviceRate);
+    double convertedLoad = bench::seconds([&] {
+        converted.loadMem(file.data(), (unsigned int)file.size(), false, false);
+    });
+
+    out.push_back({"load_11025", plainLoad * 1e3 / seconds, "ms/s"});
+    out.push_back({"load_11025_to_device", convertedLoad * 1e3 / seconds, "ms/s"});
+    out.push_back({"mix_11025", mixCost(plain), "ns/frame"});
+    out.push_back({"mix_11025_to_device", mixCost(converted), "ns/frame"});
+}
+
+// What the stage profiler adds to mixing, with small blocks where the
+// per-block timestamps weigh the most.
+BENCH(profiler_overhead)
+{
+    const unsigned int block = SAMPLE_GRANULARITY;
+    SoLoud::Wav wav;
+    makeTone(wav, 22050, 1);
+    wav.setLooping(true);
+
+    const unsigned int flags[] = {SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::CLIP_ROUNDOFF | SoLoud::Soloud::ENABLE_PROFILING};
+    for (unsigned int f : flags) {
+        SoLoud::Soloud soloud;
+        soloud.init(f, SoLoud::Soloud::NULLDRIVER, kDeviceRate, block, 2);
+        for (unsigned int i = 0; i < 4; i++)
+            soloud.play(wav);
+
+        std::vector<float> buffer(block * 2);
+        const unsigned int blocks = 20000;
+        double elapsed = bench::seconds([&] {
+            for (unsigned int i = 0; i < blocks; i++)
+                soloud.mix(buffer.data(), block);
+        });
+        soloud.deinit();
+        out.push_back({f & SoLoud::Soloud::ENABLE_PROFILING ? "profiled" : "plain", elapsed * 1e9 / blocks, "ns/block"});
+    }
+}
+
+// Voice profiling cost with every voice resampled through a bus, and where the
+// profiled time went.
+BENCH(voice_cpu)
+{
+    const unsigned int block = SAMPLE_GRANULARITY;
+    SoLoud::Wav wav;
+    makeTone(wav, 22050, 1);
+    wav.setLooping(true);
+
+    const bool profiled[] = {false, true};
+    for (bool p : profiled) {
+        SoLoud::Soloud soloud;
+        soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, block, 2);
+        soloud.setVoiceProfilingEnable(p);
+        SoLoud::Bus bus;
+        soloud.play(bus);
+        for (unsigned int i = 0; i < kVoices; i++)
+            bus.play(wav);
+
+        std::vector<float> buffer(block * 2);
+        const unsigned int blocks = 4000;
+        double elapsed = bench::seconds([&] {
+            for (unsigned int i = 0; i < blocks; i++)
+                soloud.mix(buffer.data(), block);
+        });
+        out.push_back({p ? "voice_profiled" : "plain", elapsed * 1e9 / blocks, "ns/block"});
+        if (p) {
+            const char *names[] = {"decode", "filters", "resample", "pan"};
+            double total = soloud.getSourceCpuTime(wav);
+            for (unsigned int i = 0; i < SoLoud::AudioSourceInstance::CPU_STAGE_COUNT; i++)
+                out.push_back({std::string("wav_") + names[i], total > 0 ? soloud.getSourceCpuTime(wav, i) * 100 / total : 0.0, "%"});
+        }
+        soloud.deinit();
+    }
+}
+
+// Timeline tracing cost on a bus mix at a typical device block size. The two
+// modes alternate and the best round of each counts, as the difference is small.
+BENCH(trace_overhead)
+{
+    const unsigned int block = 512;
+    SoLoud::Wav wav;
+    makeTone(wav, 22050, 1);
+    wav.setLooping(true);
+
+    SoLoud::Soloud soloud;
+    soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, block, 2);
+    SoLoud::Bus bus;
+    soloud.play(bus);
+    for (unsigned int i = 0; i < kVoices; i++)
+        bus.play(wav);
+
+    std::vector<float> buffer(block * 2);
+    const unsigned int blocks = 500;
+    double best[2] = {1e30, 1e30};
+    for (unsigned int round = 0; round < 20; round++) {
+        for (unsigned int t = 0; t < 2; t++) {
+            soloud.setTraceEnable(t != 0);
+            double elapsed = bench::seconds([&] {
+                for (unsigned int i = 0; i < blocks; i++)
+                    soloud.mix(buffer.data(), block);
+            });
+            best[t] = std::min(best[t], elapsed);
+        }
+    }
+    soloud.setTraceEnable(false);
+    soloud.deinit();
+    out.push_back({"plain", best[0] * 1e9 / blocks, "ns/block"});
+    out.push_back({"traced", best[1] * 1e9 / blocks, "ns/block"});
+    out.push_back({"overhead", (best[1] / best[0] - 1) * 100, "%"});
+}
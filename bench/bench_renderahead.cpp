@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_wav.h"
+
+// Render-ahead (Soloud::setRenderAhead) against mixing in the callback. A thread
+// stands in for the device, calling mix() once a period on a fixed clock and wanting
+// the buffer back within SOLOUD_BENCH_BUDGET percent of a period, the rest going to
+// the backend and the hardware. Mixing in the callback gets only that; the render
+// thread gets the whole period between two reads, plus a period per extra one in the
+// ring. Given a full period, the callback and a one period ring are the same schedule.
+//
+// spike: one voice stalls the mixer every 64 periods, for SOLOUD_BENCH_SHORT_SPIKE_MS
+// (default three quarters of a period) and SOLOUD_BENCH_SPIKE_MS (default one and a
+// half periods). The callback should underrun on both, one period of render-ahead
+// only on the long one, and two or more on neither.
+//
+// clicks: the game thread plays a click every 37 ms, off the period grid. The spread
+// of where the clicks land in the output against when play() was called shows how
+// sample accurate starts are. In the callback they snap to the next period.
+//
+// Environment:
+//   SOLOUD_BENCH_SECONDS         audio rendered per run, default 2
+//   SOLOUD_BENCH_BUDGET          percent of a period the device waits for mix(), default 50
+//   SOLOUD_BENCH_SHORT_SPIKE_MS  length of the short mixer stall, default 8
+//   SOLOUD_BENCH_SPIKE_MS        length of the long mixer stall, default 16
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const unsigned int kDeviceRate = 48000;
+    const unsigned int kPeriod = 512;
+    const unsigned int kSpikeEvery = 64;
+
+    unsigned int envUint(const char* name, unsigned int fallback)
+    {
+        const char* v = std::getenv(name);
+        return v && std::atoi(v) > 0 ? (unsigned int)std::atoi(v) : fallback;
+    }
+
+    // Silent voice that busy-waits for a while every kSpikeEvery blocks, standing in
+    // for a preset switch or a slow decode
+    class Spike;
+
+    class SpikeInstance : public SoLoud::AudioSourceInstance
+    {
+    public:
+        SpikeInstance(const Spike* aParent) : mParent(aParent), mCalls(0) {}
+        unsigned int getAudio(float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize) override;
+        bool hasEnded() override { return false; }
+
+    private:
+        const Spike* mParent;
+        unsigned int mCalls;
+    };
+
+    class Spike : public SoLoud::AudioSource
+    {
+    public:
+        explicit Spike(unsigned int aMicros) : mMicros(aMicros)
+        {
+            mBaseSamplerate = (float)kDeviceRate;
+            mChannels = 1;
+        }
+        SoLoud::AudioSourceInstance* createInstance() override { return new SpikeInstance(this); }
+
+        unsigned int mMicros;
+    };
+
+    unsigned int SpikeInstance::getAudio(float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
+    {
+        std::fill(aBuffer, aBuffer + aBufferSize * mChannels, 0.0f);
+        if (++mCalls % kSpikeEvery == 0) {
+            Clock::time_point until = Clock::now() + std::chrono::microseconds(mParent->mMicros);
+            while (Clock::now() < until) {
+            }
+        }
+        return aSamplesToRead;
+    }
+
+    struct Run
+    {
+        unsigned int underruns;
+        unsigned int callbacks;
+        double callbackP99;
+        // Spread of click onsets against their play() calls, in frames
+        double onsetSpread;
+    };
+
+    // aAhead periods of render-ahead, 0 for mixing in the callback
+    Run run(unsigned int aAhead, unsigned int aSeconds, unsigned int aBudget, SoLoud::AudioSource* aSpike, SoLoud::Wav* aClick)
+    {
+        SoLoud::Soloud soloud;
+        soloud.setRenderAhead(aAhead, kPeriod);
+        Run result = {0, 0, 0, 0};
+        if (soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, kPeriod, 2) != SoLoud::SO_NO_ERROR)
+            return result;
+        if (aSpike)
+            soloud.play(*aSpike);
+
+        const unsigned int blocks = aSeconds * kDeviceRate / kPeriod;
+        const auto period = std::chrono::nanoseconds(1000000000ull * kPeriod / kDeviceRate);
+        const auto budget = period * aBudget / 100;
+        std::vector<float> output(blocks * kPeriod * 2);
+        std::vector<double> callback(blocks);
+        std::atomic<bool> done(false);
+        const Clock::time_point first = Clock::now() + period;
+
+        std::thread device([&] {
+            Clock::time_point deadline = first;
+            for (unsigned int b = 0; b < blocks; b++, deadline += period) {
+                std::this_thread::sleep_until(deadline);
+                Clock::time_point start = Clock::now();
+                soloud.mix(output.data() + b * kPeriod * 2, kPeriod);
+                Clock::time_point end = Clock::now();
+                callback[b] = std::chrono::duration<double, std::micro>(end - start).count();
+                // The device needed this buffer before it was ready
+                if (end > deadline + budget)
+                    result.underruns++;
+            }
+            done = true;
+        });
+
+        // The device plays frame f at about first + f / rate, give or take a constant
+        std::vector<double> issued;
+        if (aClick) {
+            Clock::time_point next = first + std::chrono::milliseconds(50);
+            while (!done) {
+                std::this_thread::sleep_until(next);
+                if (done)
+                    break;
+                issued.push_back(std::chrono::duration<double>(Clock::now() - first).count() * kDeviceRate);
+                soloud.play(*aClick, 1.0f);
+                next += std::chrono::milliseconds(37);
+            }
+        }
+        device.join();
+        result.underruns += soloud.getRenderAheadUnderrunCount();
+        result.callbacks = blocks;
+        soloud.deinit();
+
+        std::sort(callback.begin(), callback.end());
+        result.callbackP99 = callback[(callback.size() * 99) / 100];
+
+        if (aClick) {
+            std::vector<double> residual;
+            size_t k = 0;
+            unsigned int last = 0;
+            for (unsigned int f = 1; f < blocks * kPeriod && k < issued.size(); f++) {
+                if (output[f * 2] > 0.25f && output[(f - 1) * 2] <= 0.25f && (last == 0 || f - last > 256)) {
+                    residual.push_back(f - issued[k++]);
+                    last = f;
+                }
+            }
+            if (residual.size() > 2) {
+                // The last click may have been cut off by the end of the run
+                residual.pop_back();
+                auto mm = std::minmax_element(residual.begin(), residual.end());
+                result.onsetSpread = *mm.second - *mm.first;
+            }
+        }
+        return result;
+    }
+}
+
+BENCH(render_ahead)
+{
+    const unsigned int seconds = envUint("SOLOUD_BENCH_SECONDS", 2);
+    const unsigned int budget = std::min(envUint("SOLOUD_BENCH_BUDGET", 50), 100u);
+    Spike shortSpike(envUint("SOLOUD_BENCH_SHORT_SPIKE_MS", 8) * 1000);
+    Spike spike(envUint("SOLOUD_BENCH_SPIKE_MS", 16) * 1000);
+
+    SoLoud::Wav click;
+    std::vector<float> impulse(64, 0.0f);
+    impulse[0] = 1.0f;
+    click.loadRawWave(impulse.data(), (unsigned int)impulse.size(), (float)kDeviceRate, 1, true);
+
+    for (unsigned int ahead : {0u, 1u, 2u, 3u}) {
+        std::string name = ahead ? "ahead" + std::to_string(ahead) : std::string("callback");
+        Run shortSpiked = run(ahead, seconds, budget, &shortSpike, nullptr);
+        out.push_back({name + "_short_spike_underruns", (double)shortSpiked.underruns, "count"});
+        Run spiked = run(ahead, seconds, budget, &spike, nullptr);
+        out.push_back({name + "_spike_underruns", (double)spiked.underruns, "count"});
+        out.push_back({name + "_spike_underrun_rate", spiked.callbacks ? 100.0 * spiked.underruns / spiked.callbacks : 0, "%"});
+        out.push_back({name + "_spike_callback_p99", spiked.callbackP99, "us"});
+        Run clicks = run(ahead, seconds, budget, nullptr, &click);
+        out.push_back({name + "_click_onset_spread", clicks.onsetSpread, "frames"});
+        out.push_back({name + "_latency", (double)ahead * kPeriod * 1000 / kDeviceRate, "ms"});
+    }
+}
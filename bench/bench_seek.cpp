@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_wav.h"
+#include "soloud_wavstream.h"
+
+namespace
+{
+    const unsigned int kRate = 44100;
+    const unsigned int kSeconds = 30;
+    const int kSeeks = 50;
+
+    void put16(std::vector<unsigned char>& out, uint16_t v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back(v >> 8);
+    }
+
+    void put32(std::vector<unsigned char>& out, uint32_t v)
+    {
+        put16(out, v & 0xffff);
+        put16(out, v >> 16);
+    }
+
+    // A 16-bit stereo RIFF wave, built in memory so the benchmark needs no files
+    std::vector<unsigned char> makeWaveFile()
+    {
+        const unsigned int frames = kRate * kSeconds;
+        std::vector<unsigned char> out;
+        out.insert(out.end(), {'R', 'I', 'F', 'F'});
+        put32(out, 36 + frames * 4);
+        out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        put32(out, 16);
+        put16(out, 1);
+        put16(out, 2);
+        put32(out, kRate);
+        put32(out, kRate * 4);
+        put16(out, 4);
+        put16(out, 16);
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        put32(out, frames * 4);
+        for (unsigned int i = 0; i < frames; i++) {
+            put16(out, (uint16_t)(int16_t)(8000 * std::sin(i * 0.01f)));
+            put16(out, (uint16_t)(int16_t)(6000 * std::sin(i * 0.023f)));
+        }
+        return out;
+    }
+
+    // Microseconds per seek to aSeconds, followed by a short read
+    double seekCost(SoLoud::AudioSource& source, double seconds)
+    {
+        SoLoud::AudioSourceInstance* instance = source.createInstance();
+        instance->init(source, 0);
+        std::vector<float> scratch(SAMPLE_GRANULARITY * MAX_CHANNELS);
+        std::vector<float> buffer(SAMPLE_GRANULARITY * 2);
+
+        double elapsed = bench::seconds([&] {
+            for (int i = 0; i < kSeeks; i++) {
+                instance->seek(seconds, scratch.data(), (unsigned int)scratch.size());
+                instance->getAudio(buffer.data(), SAMPLE_GRANULARITY, SAMPLE_GRANULARITY);
+                // Start from the top each time so every seek covers the same distance
+                instance->rewind();
+            }
+        });
+
+        delete instance;
+        return elapsed * 1e6 / kSeeks;
+    }
+}
+
+// Seek cost at increasing positions; constant if seeking doesn't decode its
+// way to the target.
+BENCH(seek)
+{
+    std::vector<unsigned char> file = makeWaveFile();
+
+    SoLoud::Wav wav;
+    wav.loadMem(file.data(), (unsigned int)file.size(), true, false);
+    SoLoud::WavStream stream;
+    stream.loadMem(file.data(), (unsigned int)file.size(), true, false);
+
+    const double positions[] = {1, 10, 25};
+    for (double position : positions) {
+        std::string at = std::to_string((int)position) + "s";
+        out.push_back({"wav_" + at, seekCost(wav, position), "us"});
+        out.push_back({"wavstream_" + at, seekCost(stream, position), "us"});
+    }
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_streamfile.h"
+#include "soloud_wavstream.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const unsigned int kRate = 44100;
+    const unsigned int kStreams = 128;
+    const unsigned int kSeconds = 3;
+    const unsigned int kBlock = 512;
+    const int kCallbacks = 200;
+
+    void put16(std::vector<unsigned char>& out, uint16_t v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back(v >> 8);
+    }
+
+    void put32(std::vector<unsigned char>& out, uint32_t v)
+    {
+        put16(out, v & 0xffff);
+        put16(out, v >> 16);
+    }
+
+    std::vector<unsigned char> makeWaveFile(unsigned int seed)
+    {
+        const unsigned int frames = kRate * kSeconds;
+        std::vector<unsigned char> out;
+        out.insert(out.end(), {'R', 'I', 'F', 'F'});
+        put32(out, 36 + frames * 4);
+        out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        put32(out, 16);
+        put16(out, 1);
+        put16(out, 2);
+        put32(out, kRate);
+        put32(out, kRate * 4);
+        put16(out, 4);
+        put16(out, 16);
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        put32(out, frames * 4);
+        float f = 0.005f + seed * 0.0001f;
+        for (unsigned int i = 0; i < frames; i++) {
+            put16(out, (uint16_t)(int16_t)(8000 * std::sin(i * f)));
+            put16(out, (uint16_t)(int16_t)(6000 * std::sin(i * f * 1.5f)));
+        }
+        return out;
+    }
+
+    // Push the files out of the page cache, so the first pass over them really
+    // goes to the disk. Needs no privileges, unlike drop_caches.
+    void evict(const std::vector<std::string>& paths)
+    {
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+        for (const std::string& path : paths) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                continue;
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+#else
+        (void)paths;
+#endif
+    }
+
+    struct Result
+    {
+        double p99;
+        double max;
+        double stalls;
+    };
+
+    // Every stream delivers one block per simulated audio callback, paced at
+    // the block's real-time duration; returns callback times in milliseconds.
+    Result play(const std::vector<std::string>& paths, bool readAhead)
+    {
+        evict(paths);
+
+        std::vector<std::unique_ptr<SoLoud::WavStream>> streams;
+        std::vector<std::unique_ptr<SoLoud::AudioSourceInstance>> instances;
+        for (const std::string& path : paths) {
+            streams.emplace_back(new SoLoud::WavStream);
+            streams.back()->setReadAhead(readAhead);
+            streams.back()->load(path.c_str());
+            instances.emplace_back(streams.back()->createInstance());
+            instances.back()->init(*streams.back(), 0);
+        }
+
+        // Opening parses the header before anything can be read ahead; only
+        // count what happens during playback
+        double opening = 0;
+        for (auto& instance : instances)
+            opening += instance->getInfo(SoLoud::WavStreamInstance::INFO_READ_STALLS);
+
+        std::vector<float> buffer(kBlock * 2);
+        std::vector<double> times;
+        const auto period = std::chrono::microseconds(kBlock * 1000000 / kRate);
+        auto next = std::chrono::steady_clock::now();
+        for (int i = 0; i < kCallbacks; i++) {
+            times.push_back(1e3 * bench::seconds([&] {
+                for (auto& instance : instances)
+                    instance->getAudio(buffer.data(), kBlock, kBlock);
+            }));
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+
+        Result r;
+        r.stalls = -opening;
+        for (auto& instance : instances)
+            r.stalls += instance->getInfo(SoLoud::WavStreamInstance::INFO_READ_STALLS);
+        std::sort(times.begin(), times.end());
+        r.p99 = times[times.size() * 99 / 100];
+        r.max = times.back();
+        return r;
+    }
+}
+
+// Audio callback cost with many cold streams open, reading on the audio
+// thread versus through StreamFile's read-ahead.
+BENCH(stream_many)
+{
+    std::vector<std::string> paths;
+    for (unsigned int i = 0; i < kStreams; i++) {
+        std::string path = "soloud_bench_stream_" + std::to_string(i) + ".wav";
+        std::vector<unsigned char> data = makeWaveFile(i);
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f)
+            return;
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+        paths.push_back(path);
+    }
+
+    Result disk = play(paths, false);
+    Result ahead = play(paths, true);
+    out.push_back({"diskfile_p99", disk.p99, "ms"});
+    out.push_back({"diskfile_max", disk.max, "ms"});
+    out.push_back({"streamfile_p99", ahead.p99, "ms"});
+    out.push_back({"streamfile_max", ahead.max, "ms"});
+    out.push_back({"streamfile_stalls", ahead.stalls, "reads"});
+    out.push_back({"io_uring", SoLoud::StreamFile::isUsingIoUring() ? 1.0 : 0.0, ""});
+
+    for (const std::string& path : paths)
+        std::remove(path.c_str());
+}
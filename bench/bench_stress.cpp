@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "bench.h"
+#include "soloud.h"
+#include "soloud_bus.h"
+#include "soloud_wav.h"
+#include "reverb/PSXReverbFilter.h"
+
+#ifndef SOLOUD_BENCH_SFX_DIR
+#define SOLOUD_BENCH_SFX_DIR "sfx"
+#endif
+
+// Whole-mixer scenario: real sfx files, looping 2D and 3D voices at their own
+// sample rates, spread over zone buses nested a few levels deep with a PSX reverb
+// on every bus, mixed through Soloud::mix a block at a time.
+//
+// Environment:
+//   SOLOUD_BENCH_VOICES     voice counts to run, default 64,256,1024 (capped so
+//                           voices and buses fit in VOICE_COUNT). Past the
+//                           mixer's 255 active voices the rest run virtual.
+//   SOLOUD_BENCH_ZONES      top level buses, default 16
+//   SOLOUD_BENCH_BUS_DEPTH  buses from a zone down to where voices play, default 2
+//   SOLOUD_BENCH_SECONDS    audio rendered per run, default 5
+//
+// Memory is the peak resident set size while each voice count ran, and its growth
+// over what was resident when the run started. After other benchmarks the heap
+// they freed gets reused and hides that growth; run mixer_stress on its own for
+// the mixer's footprint.
+namespace
+{
+    const unsigned int kDeviceRate = 44100;
+    const unsigned int kBlock = 512;
+    const unsigned int kSounds = 64;
+    // mapResampleBuffers_internal's ceiling on mixed voices
+    const unsigned int kMaxActive = 255;
+
+    unsigned int envUint(const char* name, unsigned int fallback)
+    {
+        const char* v = std::getenv(name);
+        return v && std::atoi(v) > 0 ? (unsigned int)std::atoi(v) : fallback;
+    }
+
+    std::vector<unsigned int> envList(const char* name, std::vector<unsigned int> fallback)
+    {
+        const char* v = std::getenv(name);
+        if (!v)
+            return fallback;
+        std::vector<unsigned int> list;
+        for (const char* p = v; *p;) {
+            char* end;
+            unsigned long n = std::strtoul(p, &end, 10);
+            if (end == p)
+                break;
+            if (n)
+                list.push_back((unsigned int)n);
+            p = *end ? end + 1 : end;
+        }
+        return list.empty() ? fallback : list;
+    }
+
+    // The first kSounds files of the corpus that load
+    std::vector<std::unique_ptr<SoLoud::Wav>> loadSounds()
+    {
+        const char* dir = std::getenv("SOLOUD_BENCH_SFX");
+        if (!dir)
+            dir = SOLOUD_BENCH_SFX_DIR;
+        std::vector<std::string> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+
+        std::vector<std::unique_ptr<SoLoud::Wav>> sounds;
+        for (const auto& file : files) {
+            if (sounds.size() == kSounds)
+                break;
+            std::unique_ptr<SoLoud::Wav> wav(new SoLoud::Wav);
+            if (wav->load(file.c_str()) != SoLoud::SO_NO_ERROR || wav->getLength() <= 0)
+                continue;
+            wav->setLooping(true);
+            wav->set3dMinMaxDistance(1, 200);
+            wav->set3dAttenuation(SoLoud::AudioSource::INVERSE_DISTANCE, 0.5f);
+            sounds.push_back(std::move(wav));
+        }
+        return sounds;
+    }
+
+    // Restart the peak resident set size (VmHWM) from the current one; Linux 4.0+ only
+    bool resetPeakRss()
+    {
+        FILE* f = std::fopen("/proc/self/clear_refs", "w");
+        if (!f)
+            return false;
+        bool ok = std::fputs("5", f) >= 0;
+        return std::fclose(f) == 0 && ok;
+    }
+
+    // A size field of /proc/self/status in MB, or -1
+    double statusMb(const char* field)
+    {
+        FILE* f = std::fopen("/proc/self/status", "r");
+        if (!f)
+            return -1;
+        char line[128];
+        long kb = -1;
+        size_t len = std::strlen(field);
+        while (std::fgets(line, sizeof(line), f)) {
+            if (std::strncmp(line, field, len) == 0 && line[len] == ':') {
+                kb = std::atol(line + len + 1);
+                break;
+            }
+        }
+        std::fclose(f);
+        return kb < 0 ? -1 : kb / 1024.0;
+    }
+
+    // Process lifetime peak, whatever ran before this benchmark included
+    double processPeakRssMb()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        // Kilobytes on Linux
+        return usage.ru_maxrss / 1024.0;
+    }
+}
+
+BENCH(mixer_stress)
+{
+    std::vector<std::unique_ptr<SoLoud::Wav>> sounds = loadSounds();
+    if (sounds.empty())
+        return;
+
+    const unsigned int zones = envUint("SOLOUD_BENCH_ZONES", 16);
+    const unsigned int depth = envUint("SOLOUD_BENCH_BUS_DEPTH", 2);
+    const unsigned int seconds = envUint("SOLOUD_BENCH_SECONDS", 5);
+    const unsigned int busCount = zones * depth;
+    if (busCount + 1 >= VOICE_COUNT)
+        return;
+
+    PSXReverbFilter reverb;
+    bool scenarioRss = true;
+    for (unsigned int requested : envList("SOLOUD_BENCH_VOICES", {64, 256, 1024})) {
+        const unsigned int voices = std::min(requested, VOICE_COUNT - 1 - busCount);
+        // The peak from here on belongs to this scenario. It still counts whatever
+        // was resident when it started (the sounds, heap kept from earlier benchmarks);
+        // the growth over that is the scenario's own.
+        scenarioRss = scenarioRss && resetPeakRss();
+        double startRss = scenarioRss ? statusMb("VmRSS") : -1;
+
+        SoLoud::Soloud soloud;
+        soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kDeviceRate, kBlock, 2);
+        soloud.setMaxActiveVoiceCount(std::min(voices + busCount, kMaxActive));
+        soloud.set3dListenerParameters(0, 0, 0, 0, 0, 1, 0, 1, 0);
+
+        // Each zone is a chain of depth buses; voices play on the innermost ones
+        std::vector<std::unique_ptr<SoLoud::Bus>> buses;
+        std::vector<SoLoud::Bus*> leaves;
+        for (unsigned int z = 0; z < zones; z++) {
+            SoLoud::Bus* parent = nullptr;
+            for (unsigned int d = 0; d < depth; d++) {
+                buses.emplace_back(new SoLoud::Bus);
+                SoLoud::Bus* bus = buses.back().get();
+                bus->setFilter(0, &reverb);
+                if (parent)
+                    parent->play(*bus);
+                else
+                    soloud.play(*bus);
+                parent = bus;
+            }
+            leaves.push_back(parent);
+        }
+
+        for (unsigned int i = 0; i < voices; i++) {
+            SoLoud::Bus* bus = leaves[i % leaves.size()];
+            SoLoud::Wav& wav = *sounds[i % sounds.size()];
+            SoLoud::handle h;
+            if (i & 1) {
+                float a = i * 0.61f;
+                h = bus->play3d(wav, 20 * std::cos(a), 0, 20 * std::sin(a), 0, 0, 0, 0.5f);
+            } else {
+                h = bus->play(wav, 0.5f, ((i % 9) - 4) * 0.2f);
+            }
+            // Off-rate playback on top of the files' own 22050 and 44100 Hz
+            if (i % 4 == 2)
+                soloud.setRelativePlaySpeed(h, 0.9f + (i % 5) * 0.05f);
+        }
+
+        std::vector<float> buffer(kBlock * 2);
+        const unsigned int blocks = seconds * kDeviceRate / kBlock;
+        std::vector<double> blockTime;
+        blockTime.reserve(blocks);
+        double total = bench::seconds([&] {
+            for (unsigned int b = 0; b < blocks; b++) {
+                // The listener turns a little every block, as in a game
+                float a = b * 0.002f;
+                double t = bench::seconds([&] {
+                    soloud.set3dListenerAt(std::sin(a), 0, std::cos(a));
+                    soloud.update3dAudio();
+                    soloud.mix(buffer.data(), kBlock);
+                });
+                blockTime.push_back(t);
+            }
+        });
+        soloud.deinit();
+
+        std::sort(blockTime.begin(), blockTime.end());
+        double blockSeconds = (double)kBlock / kDeviceRate;
+        std::string name = "v" + std::to_string(voices) + "_z" + std::to_string(zones) + "_d" + std::to_string(depth);
+        out.push_back({name + "_realtime", blocks * blockSeconds / total, "x"});
+        out.push_back({name + "_block_p50", blockTime[blockTime.size() / 2] * 1e6, "us"});
+        out.push_back({name + "_block_p99", blockTime[(blockTime.size() * 99) / 100] * 1e6, "us"});
+        out.push_back({name + "_block_max", blockTime.back() * 1e6, "us"});
+        out.push_back({name + "_block_budget", blockSeconds * 1e6, "us"});
+        double rss = scenarioRss ? statusMb("VmHWM") : -1;
+        if (rss >= 0 && startRss >= 0) {
+            out.push_back({name + "_peak_rss", rss, "MB"});
+            out.push_back({name + "_peak_rss_growth", rss - startRss, "MB"});
+        } else {
+            scenarioRss = false;
+        }
+    }
+    if (!scenarioRss)
+        out.push_back({"process_peak_rss", processPeakRssMb(), "MB"});
+}
@@ -27,6 +27,7 @@ freely, subject to the following restrictions:
 
 #include <stdlib.h> // rand
 #include <math.h> // sin
+#include <atomic>
 
 #ifdef SOLOUD_NO_ASSERTS
 #define SOLOUD_ASSERT(x)
@@ -70,6 +71,9 @@ freely, subject to the following restrictions:
 #if !defined(DISABLE_SIMD)
 #if defined(__x86_64__) || defined( _M_X64 ) || defined( __i386 ) || defined( _M_IX86 )
 #define SOLOUD_SSE_INTRINSICS
+#if defined(__AVX__)
+#define SOLOUD_AVX_INTRINSICS
+#endif
 #endif
 #endif
 
@@ -94,6 +98,12 @@ freely, subject to the following restrictions:
 // 1)mono, 2)stereo 4)quad 6)5.1 8)7.1
 #define MAX_CHANNELS 8
 
+// Maximum nesting depth of busses; each level gets its own mixing scratch
+#define MAX_BUS_DEPTH 4
+
+// Alignment of the mixer memory arena, in bytes (one cache line)
+#define ARENA_ALIGNMENT 64
+
 //
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
@@ -112,18 +122,24 @@ namespace SoLoud
 
 namespace SoLoud
 {
+	class Profiler;
+	struct Profile;
+	class RenderAhead;
+
 	// Class that handles aligned allocations to support vectorized operations
 	class AlignedFloatBuffer
 	{
 	public:
 		float *mData; // aligned pointer
-		unsigned char *mBasePtr; // raw allocated pointer (for delete)
+		unsigned char *mBasePtr; // raw allocated pointer (for delete); NULL for views
 		int mFloats; // size of buffer (w/out padding)
 
 		// ctor
 		AlignedFloatBuffer();
 		// Allocate and align buffer
-		result init(unsigned int aFloats);
+		result init(unsigned int aFloats, unsigned int aAlignment = 16);
+		// Point at memory owned by someone else (such as the mixer arena). The memory is not freed by this buffer.
+		void attach(float *aData, unsigned int aFloats);
 		// Clear data to zero.
 		void clear();
 		// dtor
@@ -198,7 +214,28 @@ namespace SoLoud
 			CLIP_ROUNDOFF = 1,
 			ENABLE_VISUALIZATION = 2,
 			LEFT_HANDED_3D = 4,
-			NO_FPU_REGISTER_CHANGE = 8
+			NO_FPU_REGISTER_CHANGE = 8,
+			// Time the audio thread's mixing stages; see getProfile
+			ENABLE_PROFILING = 16,
+			// Charge mixing time to voices, audio sources and filters; see getVoiceCpuTime
+			ENABLE_VOICE_PROFILING = 32,
+			// Harden the mixing thread and its memory for real-time use; see setRealtimeParameters
+			ENABLE_REALTIME = 64
+		};
+
+		// Parts of ENABLE_REALTIME that took effect; see getRealtimeStatus
+		enum REALTIME_STATUS
+		{
+			// Mixing thread runs at real-time priority (SCHED_FIFO)
+			REALTIME_SCHEDULING = 1,
+			// Mixing thread is pinned to the configured CPU
+			REALTIME_PINNED = 2,
+			// Mixer arena is locked in memory
+			REALTIME_LOCKED_MEMORY = 4,
+			// All current and future process memory is locked, reverb rings included
+			REALTIME_LOCKED_ALL = 8,
+			// Mixing kernels were run once before the first block
+			REALTIME_WARMED_UP = 16
 		};
 
 		// Initialize SoLoud. Must be called before SoLoud can be used.
@@ -353,6 +390,44 @@ namespace SoLoud
 
 		// Enable or disable visualization data gathering
 		void setVisualizationEnable(bool aEnable);
+		// When there are more voices than active voice slots, rank them by volume times
+		// the loudness of their content (see AudioSourceInstance::getContentLevel) instead
+		// of volume alone. Content levels are sampled whenever the active voice set is
+		// recalculated: a voice starting, stopping, pausing or changing volume.
+		void setLoudnessVoiceSelection(bool aEnable);
+
+		// Enable or disable timing of the audio thread's mixing stages
+		void setProfilingEnable(bool aEnable);
+		// Stage time histograms and block load gathered so far. Returns INVALID_PARAMETER
+		// if profiling was never enabled.
+		result getProfile(Profile &aProfile);
+		// Clear the profile
+		void resetProfile();
+		// Print the profile as a table to stderr every aInterval seconds; 0 stops
+		result setProfileDump(time aInterval);
+		// Enable or disable per voice CPU accounting (see getVoiceCpuTime). Adds two
+		// clock reads per voice stage, so it's off by default.
+		void setVoiceProfilingEnable(bool aEnable);
+		// Real-time priority (1-99) and CPU the mixing thread moves to under ENABLE_REALTIME;
+		// aCpu -1 leaves it unpinned. Call before init, or the thread picks it up on its next block.
+		result setRealtimeParameters(int aPriority, int aCpu = -1);
+		// Which parts of ENABLE_REALTIME took effect, as REALTIME_STATUS bits. What the
+		// platform or the process' privileges don't allow is left out rather than failing.
+		unsigned int getRealtimeStatus() const;
+		// Mix on a dedicated thread, aPeriods periods of aPeriodSize frames ahead of the
+		// device, so the backend callback only copies finished audio out and a slow block
+		// doesn't become an underrun. Adds that much latency; sounds started with play()
+		// are delayed to match, so they keep their timing relative to each other. 0 periods
+		// (the default) mixes in the callback; aPeriodSize 0 is the backend buffer size.
+		// Takes effect at the next init.
+		result setRenderAhead(unsigned int aPeriods, unsigned int aPeriodSize = 0);
+		// Callbacks that found the render-ahead ring short of what they asked for, since init
+		unsigned int getRenderAheadUnderrunCount() const;
+		// Record a timeline of mix stages, audio mutex waits, decoding and thread pool
+		// tasks (see soloud_trace.h). Tracing is process wide, shared by all instances.
+		void setTraceEnable(bool aEnable);
+		// Write the timeline recorded so far as Chrome trace-event JSON
+		result saveTrace(const char *aFilename);
 
 		// Calculate and get 256 floats of FFT data for visualization. Visualization has to be enabled before use.
 		float *calcFFT();
@@ -369,6 +444,15 @@ namespace SoLoud
 		// Get audiosource-specific information from a voice.
 		float getInfo(handle aVoiceHandle, unsigned int aInfoKey);
 
+		// Seconds of mixing time voice profiling charged to a voice, for one
+		// AudioSourceInstance::CPU_STAGE, or all of them for CPU_STAGE_COUNT. A bus voice's
+		// decode time includes everything playing through it. Returns 0 if handle is not valid.
+		time getVoiceCpuTime(handle aVoiceHandle, unsigned int aStage = AudioSourceInstance::CPU_STAGE_COUNT);
+		// As getVoiceCpuTime, summed over every voice played from aSound since the profile was reset
+		time getSourceCpuTime(AudioSource &aSound, unsigned int aStage = AudioSourceInstance::CPU_STAGE_COUNT);
+		// Seconds spent in instances of aFilter, across all voices and buses, since the profile was reset
+		time getFilterCpuTime(Filter &aFilter);
+
 		// Create a voice group. Returns 0 if unable (out of voice groups / out of memory)
 		handle createVoiceGroup();
 		// Destroy a voice group.
@@ -418,18 +502,31 @@ namespace SoLoud
 		// Returns mixed 16-bit signed integer samples in buffer. Called by the back-end, or user with null driver.
 		void mixSigned16(short *aBuffer, unsigned int aSamples);
 	public:
-		// Mix N samples * M channels. Called by other mix_ functions.
-		void mix_internal(unsigned int aSamples);
+		// Mix aSamples interleaved frames into aBuffer, mScratchSize at a time. Audio mutex held.
+		void mixInterleaved_internal(float *aBuffer, unsigned int aSamples);
+		// Mix one render-ahead period into aBuffer. Called by the render thread.
+		void renderAhead_internal(float *aBuffer, unsigned int aSamples);
+		// Mix N samples * M channels. Called by other mix_ functions with the audio mutex held; aSamples may not exceed mScratchSize.
+		// Returns true if the block is silent, in which case mScratch is left untouched.
+		bool mix_internal(unsigned int aSamples);
 
 		// Handle rest of initialization (called from backend)
 		void postinit_internal(unsigned int aSamplerate, unsigned int aBufferSize, unsigned int aFlags, unsigned int aChannels);
+		// (Re)allocate the mixer arena for given number of active voices and carve the working buffers out of it
+		result initArena_internal(unsigned int aVoiceCount);
+		// Lock the mixer's memory for ENABLE_REALTIME; everything when the limits allow, else the arena
+		void lockMemory_internal();
+		// Run every mixing kernel once on the arena so the first block doesn't take the cold misses
+		void warmUp_internal();
+		// Move the calling (mixing) thread to the real-time priority and CPU
+		void hardenThread_internal();
 
 		// Update list of active voices
 		void calcActiveVoices_internal();
 		// Map resample buffers to active voices
 		void mapResampleBuffers_internal();
-		// Perform mixing for a specific bus
-		void mixBus_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize, float *aScratch, unsigned int aBus, float aSamplerate, unsigned int aChannels);
+		// Perform mixing for a specific bus. Returns true if nothing audible was mixed, in which case aBuffer is left untouched.
+		bool mixBus_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize, float *aScratch, unsigned int aBus, float aSamplerate, unsigned int aChannels);
 		// Find a free voice, stopping the oldest if no free voice is found.
 		int findFreeVoice_internal();
 		// Converts handle to voice, if the handle is valid. Returns -1 if not.
@@ -468,15 +565,20 @@ namespace SoLoud
 		unsigned int mMaxActiveVoices;
 		// Highest voice in use so far
 		unsigned int mHighestVoice;
-		// Scratch buffer, used for resampling.
+		// Single aligned allocation all of the mixer working buffers below are carved from.
+		// Only reallocated from the game thread (init, setMaxActiveVoiceCount), never while mixing.
+		AlignedFloatBuffer *mArena;
+		// Scratch buffer, used for resampling. View into the arena.
 		AlignedFloatBuffer mScratch;
 		// Current size of the scratch, in samples.
 		unsigned int mScratchSize;
-		// Amount of scratch needed.
-		unsigned int mScratchNeeded;
-		// Output scratch buffer, used in mix_().
+		// Output scratch buffer, used in mix_(). View into the arena.
 		AlignedFloatBuffer mOutputScratch;
-		// Resampler buffers, two per active voice.
+		// Scratch buffers for nested bus mixing, one per nesting level. Views into the arena.
+		AlignedFloatBuffer mBusScratch[MAX_BUS_DEPTH];
+		// Current bus nesting level while mixing.
+		unsigned int mBusDepth;
+		// Resampler buffers, two per active voice. Views into the arena.
 		AlignedFloatBuffer *mResampleData;
 		// Owners of the resample data
 		AudioSourceInstance **mResampleDataOwner;
@@ -538,6 +640,8 @@ namespace SoLoud
 
 		// Data related to 3d processing, separate from AudioSource so we can do 3d calculations without audio mutex.
 		AudioSourceInstance3dData m3dData[VOICE_COUNT];
+		// Positions, velocities and distance model of the 3d voices, one array per field so update3dVoices_internal can work on several voices at once
+		AudioSourceInstance3dArrays m3dArrays;
 
 		// For each voice group, first int is number of ints alocated.
 		unsigned int **mVoiceGroup;
@@ -549,6 +653,24 @@ namespace SoLoud
 		unsigned int mActiveVoiceCount;
 		// Active voices list needs to be recalculated
 		bool mActiveVoiceDirty;
+		// Rank voices by content loudness too; see setLoudnessVoiceSelection
+		bool mLoudnessVoiceSelection;
+		// Ranking keys for the active voice selection, by voice
+		float mVoiceRank[VOICE_COUNT];
+		// Stage timings; created when profiling is first enabled, NULL before
+		Profiler *mProfiler;
+		// ENABLE_REALTIME thread priority and CPU (-1 for any); see setRealtimeParameters
+		int mRealtimePriority;
+		int mRealtimeCpu;
+		// Bumped by setRealtimeParameters so the mixing thread re-applies them
+		std::atomic<unsigned int> mRealtimeGeneration;
+		// REALTIME_STATUS bits; the mixing thread updates them while others read
+		std::atomic<unsigned int> mRealtimeStatus;
+		// Render-ahead periods and period size (0 for the backend's); see setRenderAhead
+		unsigned int mRenderAheadPeriods;
+		unsigned int mRenderAheadPeriodSize;
+		// Render thread and ring; created at init when render-ahead is on, NULL before
+		RenderAhead *mRenderAhead;
 	};
 };
 
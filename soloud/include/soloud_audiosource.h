@@ -98,6 +98,35 @@ namespace SoLoud
 		handle mHandle;
 	};
 
+	// Per voice 3d parameters, one array per field indexed by voice. update3dVoices_internal
+	// reads these; the matching AudioSourceInstance3dData fields are kept as a copy for colliders.
+	class AudioSourceInstance3dArrays
+	{
+	public:
+		// ctor
+		AudioSourceInstance3dArrays();
+		// Set settings of aVoice from audiosource
+		void init(unsigned int aVoice, AudioSource &aSource);
+		// 3d position
+		float mPositionX[VOICE_COUNT];
+		float mPositionY[VOICE_COUNT];
+		float mPositionZ[VOICE_COUNT];
+		// 3d velocity
+		float mVelocityX[VOICE_COUNT];
+		float mVelocityY[VOICE_COUNT];
+		float mVelocityZ[VOICE_COUNT];
+		// 3d min distance
+		float mMinDistance[VOICE_COUNT];
+		// 3d max distance
+		float mMaxDistance[VOICE_COUNT];
+		// 3d attenuation rolloff factor
+		float mAttenuationRolloff[VOICE_COUNT];
+		// 3d doppler factor
+		float mDopplerFactor[VOICE_COUNT];
+		// 3d attenuation model
+		unsigned int mAttenuationModel[VOICE_COUNT];
+	};
+
 	// Base class for audio instances
 	class AudioSourceInstance
 	{
@@ -119,7 +148,24 @@ namespace SoLoud
 			// If inaudible, should be killed (default = don't kill kill)
 			INAUDIBLE_KILL = 64,
 			// If inaudible, should still be ticked (default = pause)
-			INAUDIBLE_TICK = 128
+			INAUDIBLE_TICK = 128,
+			// Set by getAudio() when the block it produced is silent; the buffer contents are then undefined.
+			// Cleared by the caller before asking for more data.
+			SILENT = 256
+		};
+		// tellFrame() of sources that can't seek back exactly
+		static const unsigned int NO_FRAME = 0xffffffff;
+		// Mixing work tracked per voice while voice profiling is on (Soloud::ENABLE_VOICE_PROFILING)
+		enum CPU_STAGE
+		{
+			// getAudio / advance, including looping; for a bus, everything mixed into it
+			CPU_DECODE = 0,
+			// Per-stream filters
+			CPU_FILTERS,
+			CPU_RESAMPLE,
+			// Panning and channel expansion into the bus
+			CPU_PAN,
+			CPU_STAGE_COUNT
 		};
 		// Ctor
 		AudioSourceInstance();
@@ -173,10 +219,15 @@ namespace SoLoud
 		unsigned int mBusHandle;
 		// Filter pointer
 		FilterInstance *mFilter[FILTERS_PER_STREAM];
+		// Nanoseconds spent on this voice, by CPU_STAGE
+		unsigned long long mCpuTime[CPU_STAGE_COUNT];
 		// Initialize instance. Mostly internal use.
 		void init(AudioSource &aSource, int aPlayIndex);
 		// Buffers for the resampler
 		AlignedFloatBuffer *mResampleData[2];
+		// Silence of the resampler buffers; bit 0 for mResampleData[0], bit 1 for mResampleData[1].
+		// A silent buffer only has its last sample of each channel defined (as zero).
+		unsigned int mResampleDataSilent;
 		// Sub-sample playhead; 16.16 fixed point
 		unsigned int mSrcOffset;
 		// Samples left over from earlier pass
@@ -185,6 +236,10 @@ namespace SoLoud
 		unsigned int mDelaySamples;
 		// When looping, start playing from this time
 		time mLoopPoint;
+		// Frames the last resampler blocks skipped by advance() started at, newest first, and how
+		// many of them (0-2) the resample buffers still lack; see tellFrame()
+		unsigned int mSkippedFrame[2];
+		unsigned int mSkippedBlocks;
 
 		// Get N samples from the stream to the buffer. Report samples written.
 		virtual unsigned int getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize) = 0;
@@ -192,10 +247,22 @@ namespace SoLoud
 		virtual bool hasEnded() = 0;
 		// Seek to certain place in the stream. Base implementation is generic "tape" seek (and slow).
 		virtual result seek(time aSeconds, float *mScratch, unsigned int mScratchSize);
+		// Skip N samples of the stream without producing them. Report samples skipped, which is
+		// less than N only at the end of the stream. Base implementation reads into the scratch.
+		virtual unsigned int advance(unsigned int aSamples, float *aScratch, unsigned int aScratchSize);
+		// Source frame the next getAudio() or advance() reads, or NO_FRAME if the source can't
+		// return to it. Inaudible voices only skip decoding through advance() if they can, so
+		// that the skipped blocks can be decoded again when they turn audible. Base returns NO_FRAME.
+		virtual unsigned int tellFrame();
+		// Continue reading at a frame tellFrame() returned. Base returns NOT_IMPLEMENTED.
+		virtual result seekFrame(unsigned int aFrame);
 		// Rewind stream. Base implementation returns NOT_IMPLEMENTED, meaning it can't rewind.
 		virtual result rewind();
 		// Get information. Returns 0 by default.
 		virtual float getInfo(unsigned int aInfoKey);
+		// Linear level of the audio coming up, for loudness-aware voice selection.
+		// Returns 1 (unknown) by default.
+		virtual float getContentLevel();
 	};
 
 	class Soloud;
@@ -267,6 +334,10 @@ namespace SoLoud
 		int mColliderData;
 		// When looping, start playing from this time
 		time mLoopPoint;
+		// Frames the last resampler blocks skipped by advance() started at, newest first, and how
+		// many of them (0-2) the resample buffers still lack; see tellFrame()
+		unsigned int mSkippedFrame[2];
+		unsigned int mSkippedBlocks;
 
 		// CTor
 		AudioSource();
@@ -0,0 +1,101 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_AUDIT_H
+#define SOLOUD_AUDIT_H
+
+#include <stddef.h>
+#include "soloud.h"
+
+// Call sites kept apart in the report; further new sites are only counted
+#define AUDIT_MAX_SITES 256
+// Stack frames recorded per site
+#define AUDIT_MAX_FRAMES 12
+
+// Real-time safety hooks. They compile to nothing unless SOLOUD_AUDIT is defined.
+#ifdef SOLOUD_AUDIT
+#define SOLOUD_AUDIT_ENTER() SoLoud::Audit::enter()
+#define SOLOUD_AUDIT_LEAVE() SoLoud::Audit::leave()
+#define SOLOUD_AUDIT_CHECK(aKind, aBytes) SoLoud::Audit::check(SoLoud::Audit::aKind, aBytes)
+#else
+#define SOLOUD_AUDIT_ENTER()
+#define SOLOUD_AUDIT_LEAVE()
+#define SOLOUD_AUDIT_CHECK(aKind, aBytes)
+#endif
+
+namespace SoLoud
+{
+	// Real-time safety audit of the mixer. In builds with SOLOUD_AUDIT defined, a
+	// thread marks itself for as long as it is inside Soloud::mix_internal. Heap
+	// allocations and frees, mutex locks and file I/O it does while marked are
+	// grouped by call stack, or abort the process on the spot.
+	//
+	// The heap is watched through malloc, calloc, realloc and free on glibc. Elsewhere
+	// the replaceable operator new and delete are used, so C allocations go unseen.
+	// Audit builds don't mix with sanitizers, which replace the same functions.
+	// Without SOLOUD_AUDIT nothing is recorded and report() says so.
+	class Audit
+	{
+	public:
+		enum KIND
+		{
+			ALLOC,
+			FREE,
+			// A mutex that was free at the time; still a system call away from blocking
+			LOCK,
+			// A mutex held by another thread; the mixer waited for it
+			LOCK_WAIT,
+			FILE_IO,
+			KIND_COUNT
+		};
+
+		enum MODE
+		{
+			OFF,
+			// Record call sites for report()
+			COUNT,
+			// Print the offending stack to stderr and abort()
+			ABORT
+		};
+
+		static void setMode(MODE aMode);
+		static MODE getMode();
+		// Mark the calling thread as mixing until the matching leave(). Nests.
+		static void enter();
+		static void leave();
+		// True when the calling thread is marked and the audit is on
+		static bool isAuditing();
+		// Report aKind on the calling thread if it is marked; aBytes for the heap and file kinds
+		static void check(KIND aKind, size_t aBytes = 0);
+		// Violations of aKind recorded since the last clear()
+		static unsigned int getCount(KIND aKind);
+		static const char *getKindName(KIND aKind);
+		static void clear();
+		// Write the recorded call sites, most frequent first, to aFilename (stdout for NULL)
+		static result report(const char *aFilename = 0);
+	};
+};
+
+#endif
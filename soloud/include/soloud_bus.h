@@ -34,8 +34,6 @@ namespace SoLoud
 	class BusInstance : public AudioSourceInstance
 	{
 		Bus *mParent;
-		unsigned int mScratchSize;
-		AlignedFloatBuffer mScratch;
 	public:
 		// Approximate volume for channels.
 		float mVisualizationChannelVolume[MAX_CHANNELS];
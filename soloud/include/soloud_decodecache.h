@@ -0,0 +1,110 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_DECODECACHE_H
+#define SOLOUD_DECODECACHE_H
+
+#include <atomic>
+#include "soloud.h"
+
+namespace SoLoud
+{
+	class File;
+	class MappedFile;
+
+	// On-disk cache of decoded samples for compressed sources (ogg, mp3, flac and
+	// non-PCM wav such as ADPCM), so they are decoded once instead of on every run.
+	//
+	// Each entry is one file in the cache directory, named after a 64-bit hash of
+	// the source file's contents:
+	//   DecodeCacheHeader
+	//   planar samples (f32 or s16), starting at mPayloadOffset (64-byte aligned)
+	// The payload is checksummed; damaged or stale entries are ignored and rewritten.
+	// f32 entries are played straight from the mapped cache file.
+	enum DECODECACHE_FORMAT
+	{
+		DECODECACHE_F32 = 0,
+		DECODECACHE_S16 = 1
+	};
+
+	enum DECODECACHE_CONSTANTS
+	{
+		// Bump when the layout or the decoders' output changes
+		DECODECACHE_VERSION = 1,
+		DECODECACHE_ALIGNMENT = 64
+	};
+
+	struct DecodeCacheHeader
+	{
+		char mMagic[4]; // "SLDC"
+		unsigned int mVersion;
+		unsigned int mFormat;
+		unsigned int mChannels;
+		float mSamplerate;
+		unsigned int mFrames;
+		unsigned int mSourceLength;
+		unsigned int mPayloadOffset;
+		unsigned int mPayloadLength;
+		unsigned int mReserved;
+		unsigned long long mSourceHash;
+		unsigned long long mPayloadChecksum;
+	};
+
+	class DecodeCache
+	{
+	public:
+		DecodeCache();
+		~DecodeCache();
+		// Use aDirectory (which must exist) for cache files, storing samples as aFormat
+		result init(const char *aDirectory, unsigned int aFormat = DECODECACHE_F32);
+
+		// Whether decoding this source is worth caching; plain PCM/float wav isn't
+		bool isCacheable(File *aSource);
+		// Content hash of a source, used as the cache key
+		static unsigned long long hash(const unsigned char *aData, unsigned int aLength);
+
+		// Map a valid entry for the key. Returns 0 on a miss; on a hit fills aHeader
+		// and returns the mapped file, which the caller then owns.
+		MappedFile *lookup(unsigned long long aSourceHash, unsigned int aSourceLength, DecodeCacheHeader &aHeader);
+		// Write an entry for planar float data
+		result store(unsigned long long aSourceHash, unsigned int aSourceLength, const float *aData, unsigned int aFrames, unsigned int aChannels, float aSamplerate);
+
+		unsigned int getHitCount();
+		unsigned int getMissCount();
+		// Entries found but thrown away (bad checksum, version or header)
+		unsigned int getRejectCount();
+
+		void getPath_internal(unsigned long long aSourceHash, char *aPath, unsigned int aPathSize);
+
+		char *mDirectory;
+		unsigned int mFormat;
+		std::atomic<unsigned int> mHits;
+		std::atomic<unsigned int> mMisses;
+		std::atomic<unsigned int> mRejects;
+		std::atomic<unsigned int> mTempSerial;
+	};
+};
+
+#endif
@@ -52,6 +52,9 @@ namespace SoLoud
 	{
 	public:
 		FILE *mFileHandle;
+		// File length, looked up once on first length() call; files are opened read-only
+		unsigned int mLength;
+		bool mLengthKnown;
 
 		virtual int eof();
 		virtual unsigned int read(unsigned char *aDst, unsigned int aBytes);
@@ -85,6 +88,29 @@ namespace SoLoud
 		result openToMem(const char *aFilename);
 		result openFileToMem(File *aFile);
 	};
+
+	// Read-only memory mapped file. getMemPtr() returns the mapping itself,
+	// so memory decoders can work on the file without an intermediate copy.
+	class MappedFile : public File
+	{
+	public:
+		const unsigned char *mDataPtr;
+		unsigned int mDataLength;
+		unsigned int mOffset;
+		void *mFileHandle;
+		void *mMapHandle;
+
+		virtual int eof();
+		virtual unsigned int read(unsigned char *aDst, unsigned int aBytes);
+		virtual unsigned int length();
+		virtual void seek(int aOffset);
+		virtual unsigned int pos();
+		virtual const unsigned char * getMemPtr();
+		virtual ~MappedFile();
+		MappedFile();
+		result open(const char *aFilename);
+		void close();
+	};
 };
 
 #endif
@@ -30,14 +30,24 @@ freely, subject to the following restrictions:
 namespace SoLoud
 {
 	class Fader;
+	class Filter;
 
 	class FilterInstance
 	{
 	public:
+		enum TAIL
+		{
+			// Output doesn't decay into silence (or the filter can't tell); the filter is always run
+			TAIL_INFINITE = 0xffffffff
+		};
 		unsigned int mNumParams;
 		unsigned int mParamChanged;
 		float *mParam;
 		Fader *mParamFader;
+		// Samples of silent input processed since the input last had signal
+		unsigned int mSilentSamples;
+		// Filter this instance was created from, for CPU accounting; set by whoever creates it
+		Filter *mSourceFilter;
 		
 
 		FilterInstance();
@@ -49,6 +59,10 @@ namespace SoLoud
 		virtual void setFilterParameter(unsigned int aAttributeId, float aValue);
 		virtual void fadeFilterParameter(unsigned int aAttributeId, float aTo, time aTime, time aStartTime);
 		virtual void oscillateFilterParameter(unsigned int aAttributeId, float aFrom, float aTo, time aTime, time aStartTime);
+		// Number of samples the filter keeps producing output after its input goes silent. Default is TAIL_INFINITE.
+		virtual unsigned int getTailSamples(float aSamplerate);
+		// Check whether the filter needs to run for a block of (possibly silent) input. Mostly internal use.
+		bool needsProcessing_internal(bool aSilent, unsigned int aSamples, float aSamplerate);
 		virtual ~FilterInstance();
 	};
 
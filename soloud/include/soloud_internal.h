@@ -83,9 +83,21 @@ namespace SoLoud
 	// null driver back-end initialization call
 	result null_init(SoLoud::Soloud *aSoloud, unsigned int aFlags = Soloud::CLIP_ROUNDOFF, unsigned int aSamplerate = 44100, unsigned int aBuffer = 2048, unsigned int aChannels = 2);
 
+	// Linearly interpolate aDstSampleCount samples out of source block aSrc (aSrc1 being the
+	// block before it), starting at aSrcOffset and advancing aStepFixed per sample, both in
+	// FIXPOINT_FRAC_BITS fixed point
+	void resample(float *aSrc, float *aSrc1, float *aDst, int aSrcOffset, int aDstSampleCount, float aSrcSamplerate, float aDstSamplerate, int aStepFixed);
+
+	// Pan and expand/shrink aVoice's planar samples in aScratch to aChannels, adding them to aBuffer
+	void panAndExpand(AudioSourceInstance *aVoice, float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize, float *aScratch, unsigned int aChannels);
+
 	// Deinterlace samples in a buffer. From 12121212 to 11112222
 	void deinterlace_samples_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aSamples, unsigned int aChannels);
 
+	// Deinterlace aFrames frames of aSourceChannels interleaved samples into the first
+	// aDestChannels planes of aDestBuffer, aDestStride floats apart. From 121212 to 111.222
+	void deinterlace_frames_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aFrames, unsigned int aSourceChannels, unsigned int aDestChannels, unsigned int aDestStride);
+
 	// Interlace samples in a buffer. From 11112222 to 12121212
 	void interlace_samples_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aSamples, unsigned int aChannels);
 
@@ -93,6 +105,11 @@ namespace SoLoud
 	void interlace_samples_s16(const float *aSourceBuffer, short *aDestBuffer, unsigned int aSamples, unsigned int aChannels);
 };
 
+// Resampler source position format
+#define FIXPOINT_FRAC_BITS 20
+#define FIXPOINT_FRAC_MUL (1 << FIXPOINT_FRAC_BITS)
+#define FIXPOINT_FRAC_MASK ((1 << FIXPOINT_FRAC_BITS) - 1)
+
 #define FOR_ALL_VOICES_PRE \
 		handle *h_ = NULL; \
 		handle th_[2] = { aVoiceHandle, 0 }; \
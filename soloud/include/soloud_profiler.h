@@ -0,0 +1,143 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_PROFILER_H
+#define SOLOUD_PROFILER_H
+
+#include <atomic>
+#include "soloud.h"
+#include "soloud_audiosource.h"
+#include "soloud_thread.h"
+
+// Histograms are exact below 2^PROFILE_SUB_BITS, then split every power of two
+// into 2^PROFILE_SUB_BITS buckets (about 6% resolution), up to 2^PROFILE_MAX_BITS.
+#define PROFILE_SUB_BITS 4
+#define PROFILE_MAX_BITS 40
+#define PROFILE_BUCKETS (((PROFILE_MAX_BITS - PROFILE_SUB_BITS) << PROFILE_SUB_BITS) + (2 << PROFILE_SUB_BITS))
+// Distinct audio sources and filters voice profiling keeps totals for (powers of two);
+// anything past that is lumped into one uncounted overflow slot.
+#define PROFILE_SOURCE_SLOTS 256
+#define PROFILE_FILTER_SLOTS 64
+
+namespace SoLoud
+{
+	// Audio thread stages timed by the profiler, in mix order
+	enum PROFILE_STAGE
+	{
+		PROFILE_FADERS = 0,
+		PROFILE_ACTIVE_VOICES,
+		PROFILE_MIX_BUSES,
+		PROFILE_GLOBAL_FILTERS,
+		PROFILE_CLIP,
+		PROFILE_VISUALIZATION,
+		// Everything above, for one mixed block
+		PROFILE_BLOCK,
+		PROFILE_STAGE_COUNT
+	};
+
+	// Log-linear (HDR style) histogram of integer samples. One thread records,
+	// any thread may read; everything is a relaxed atomic.
+	class ProfileHistogram
+	{
+	public:
+		ProfileHistogram();
+		void record(unsigned long long aValue);
+		void reset();
+		// Upper bound of the bucket holding the aFraction quantile, at most the maximum
+		unsigned long long percentile(double aFraction) const;
+
+		std::atomic<unsigned int> mBucket[PROFILE_BUCKETS];
+		std::atomic<unsigned long long> mCount;
+		std::atomic<unsigned long long> mSum;
+		std::atomic<unsigned long long> mMax;
+	};
+
+	struct ProfileStats
+	{
+		unsigned long long mCount;
+		double mMean;
+		double mP50;
+		double mP99;
+		double mMax;
+	};
+
+	// Snapshot returned by Soloud::getProfile
+	struct Profile
+	{
+		// Stage times in microseconds
+		ProfileStats mStage[PROFILE_STAGE_COUNT];
+		// Block compute time over block duration; 1 uses up the whole real-time budget
+		ProfileStats mLoad;
+	};
+
+	// Voice profiling totals for one key (audio source ID or Filter address), in nanoseconds
+	struct ProfileCpuSlot
+	{
+		std::atomic<unsigned long long> mKey;
+		std::atomic<unsigned long long> mTime[AudioSourceInstance::CPU_STAGE_COUNT];
+	};
+
+	class Profiler
+	{
+	public:
+		Profiler();
+		~Profiler();
+		// Monotonic clock, in nanoseconds
+		static unsigned long long now();
+		static const char *getStageName(unsigned int aStage);
+		// Record aStage as having run from aStart until now; returns now
+		unsigned long long lap(unsigned int aStage, unsigned long long aStart);
+		// Record a whole block of aSamples frames that started at aStart
+		void block(unsigned long long aStart, unsigned int aSamples, unsigned int aSamplerate);
+		void reset();
+		void get(Profile &aProfile) const;
+		// Text table of get(), as much as fits in aBuffer; returns the length
+		unsigned int format(char *aBuffer, unsigned int aSize) const;
+		// Print format() to stderr every aInterval seconds on a background thread; 0 stops
+		void setDump(double aInterval);
+
+		// Voice profiling, audio thread side. Add the time since aStart to aVoice's
+		// aStage counter; returns now.
+		unsigned long long voiceLap(AudioSourceInstance *aVoice, unsigned int aStage, unsigned long long aStart);
+		// As voiceLap for CPU_FILTERS, also charging aFilter's source Filter. aVoice may be NULL.
+		unsigned long long filterLap(AudioSourceInstance *aVoice, FilterInstance *aFilter, unsigned long long aStart);
+		// Add what aVoice's counters gained since aBefore to its audio source's totals
+		void voiceDone(AudioSourceInstance *aVoice, const unsigned long long *aBefore);
+		// Totals in seconds; aStage CPU_STAGE_COUNT sums all stages. Unknown keys give 0.
+		time getSourceTime(unsigned int aAudioSourceID, unsigned int aStage) const;
+		time getFilterTime(Filter *aFilter) const;
+
+		ProfileHistogram mStage[PROFILE_STAGE_COUNT];
+		// Load in 1/10000ths
+		ProfileHistogram mLoad;
+		Thread::ThreadHandle mDumpThread;
+		std::atomic<int> mDumpIntervalMs;
+		// Open addressed on the key, with the overflow slot last. Only the audio thread inserts.
+		ProfileCpuSlot mSource[PROFILE_SOURCE_SLOTS + 1];
+		ProfileCpuSlot mFilter[PROFILE_FILTER_SLOTS + 1];
+	};
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_RENDERAHEAD_H
+#define SOLOUD_RENDERAHEAD_H
+
+#include <atomic>
+#include "soloud.h"
+#include "soloud_thread.h"
+
+namespace SoLoud
+{
+	// Render-ahead ring (see Soloud::setRenderAhead). A render thread mixes whole
+	// periods into the ring ahead of the device and the backend callback only copies
+	// them out; the two share nothing but the free-running frame counters.
+	class RenderAhead
+	{
+	public:
+		RenderAhead();
+		// Stops the render thread if it's still running
+		~RenderAhead();
+		// Allocate aPeriods periods of aPeriodSize frames and start mixing aSoloud into them.
+		// Returns once the ring is full, so the first callback finds it ready, or after a
+		// second if the mixer is that slow; the ring keeps filling and earlier callbacks
+		// get silence.
+		result start(Soloud *aSoloud, unsigned int aPeriods, unsigned int aPeriodSize, unsigned int aChannels);
+		// Stop and join the render thread. The backend must be done calling read by now.
+		void stop();
+		bool isRunning() const;
+		// Callback side: copy aFrames interleaved frames out, with silence for whatever
+		// isn't rendered yet. Never blocks.
+		void read(float *aBuffer, unsigned int aFrames);
+		void readSigned16(short *aBuffer, unsigned int aFrames);
+		// Game thread side, with the audio mutex held: samples to delay something started
+		// now so that it's heard the lookahead after it was issued, rather than at
+		// wherever the render thread happens to be
+		unsigned int getCommandDelay(unsigned int aSamplerate);
+		// Callbacks that found less than they asked for
+		unsigned int getUnderrunCount() const;
+
+		// Frames mixed so far. Only changed with the audio mutex held.
+		unsigned long long mRendered;
+
+	private:
+		static void renderThread(void *aParam);
+		// Copy what's ready of aFrames to aBuffer or aBuffer16, silence the rest and
+		// hand the space back to the render thread
+		void copyOut(float *aBuffer, short *aBuffer16, unsigned int aFrames);
+
+		Soloud *mSoloud;
+		// Interleaved ring of mCapacity frames, a whole number of periods, so a period
+		// is always rendered in one piece
+		AlignedFloatBuffer mRing;
+		unsigned int mCapacity;
+		unsigned int mPeriodSize;
+		unsigned int mChannels;
+		// Free-running frame counters; the render thread only writes mWritten and the
+		// callback only writes mRead
+		std::atomic<unsigned long long> mWritten;
+		std::atomic<unsigned long long> mRead;
+		// When mRead last moved (Profiler::now), for getCommandDelay. mReadSeq is odd
+		// while the two are being updated.
+		std::atomic<unsigned long long> mReadTime;
+		std::atomic<unsigned int> mReadSeq;
+		std::atomic<unsigned int> mUnderruns;
+		std::atomic<bool> mRunning;
+		// Signaled by the callback every time it frees space
+		void *mWake;
+		// Signaled once by the render thread, when the ring first fills up
+		void *mFilled;
+		Thread::ThreadHandle mThread;
+	};
+};
+
+#endif
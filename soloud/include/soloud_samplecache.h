@@ -0,0 +1,97 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_SAMPLECACHE_H
+#define SOLOUD_SAMPLECACHE_H
+
+#include "soloud.h"
+
+namespace SoLoud
+{
+	class Wav;
+	class SoundBank;
+	struct SampleCacheEntry;
+
+	// Keeps decoded Wavs around under a memory budget.
+	//
+	// acquire() returns a cached Wav (loading it on a miss) and takes a reference;
+	// release() drops it. When the decoded data goes over budget, least recently
+	// used sounds that have no references and aren't playing are evicted. Sounds
+	// still referenced or playing are never evicted, so the budget can be exceeded
+	// while they are in use. Only data the cache owns counts toward the budget:
+	// sounds that point into a mapped file or a SoundBank count as 0 bytes.
+	class SampleCache
+	{
+	public:
+		SampleCache();
+		// Deletes every cached Wav (stopping any that still play)
+		~SampleCache();
+		// Maximum bytes of decoded sample data to keep; 0 means unlimited
+		void setBudget(unsigned long long aBytes);
+		unsigned long long getBudget();
+
+		// Get the sound for a file, or sound aId from a bank. Returns 0 if it fails to load.
+		Wav *acquire(const char *aFilename);
+		Wav *acquire(SoundBank *aBank, unsigned int aId);
+		// Drop a reference taken by acquire()
+		void release(Wav *aWav);
+		// Evict everything that can be evicted
+		void trim();
+
+		unsigned int getHitCount();
+		unsigned int getMissCount();
+		unsigned int getEvictionCount();
+		unsigned int getEntryCount();
+		// Decoded bytes owned by cached sounds
+		unsigned long long getResidentBytes();
+		void resetCounters();
+
+		SampleCacheEntry *find_internal(const char *aKey, unsigned int aHash);
+		SampleCacheEntry *findWav_internal(Wav *aWav);
+		Wav *acquire_internal(const char *aKey, const char *aFilename, SoundBank *aBank, unsigned int aId);
+		void evict_internal(unsigned long long aBudget);
+		// Evict one entry unless it is referenced or playing
+		bool evictEntry_internal(SampleCacheEntry *aEntry);
+		void unlink_internal(SampleCacheEntry *aEntry);
+		void touch_internal(SampleCacheEntry *aEntry);
+
+		void *mMutex;
+		// Hash tables by key and by Wav pointer, both mBucketCount long
+		SampleCacheEntry **mBucket;
+		SampleCacheEntry **mWavBucket;
+		unsigned int mBucketCount;
+		// LRU list, most recently used at the head
+		SampleCacheEntry *mHead;
+		SampleCacheEntry *mTail;
+		unsigned long long mBudget;
+		unsigned long long mResidentBytes;
+		unsigned int mEntryCount;
+		unsigned int mHits;
+		unsigned int mMisses;
+		unsigned int mEvictions;
+	};
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_SOUNDBANK_H
+#define SOLOUD_SOUNDBANK_H
+
+#include "soloud.h"
+
+namespace SoLoud
+{
+	class MappedFile;
+
+	// Packed sound bank: many sounds in one file, found through a sorted index.
+	//
+	// Layout (little endian):
+	//   SoundBankHeader
+	//   SoundBankEntry[mCount], sorted by id
+	//   payloads, each starting on a SOUNDBANK_ALIGNMENT boundary
+	//
+	// FILE payloads are the original encoded file (wav, ogg, flac, mp3) and are
+	// decoded on load. FLOAT32 payloads are planar float samples laid out the
+	// way Wav keeps them in memory, and are used in place without decoding.
+	enum SOUNDBANK_CONSTANTS
+	{
+		SOUNDBANK_VERSION = 1,
+		SOUNDBANK_ALIGNMENT = 64
+	};
+
+	enum SOUNDBANK_FORMAT
+	{
+		SOUNDBANK_FORMAT_FILE = 0,
+		SOUNDBANK_FORMAT_FLOAT32 = 1
+	};
+
+	struct SoundBankHeader
+	{
+		char mMagic[4]; // "SLBK"
+		unsigned int mVersion;
+		unsigned int mCount;
+		unsigned int mAlignment;
+	};
+
+	struct SoundBankEntry
+	{
+		unsigned int mId;
+		unsigned int mFormat;
+		unsigned int mOffset;
+		unsigned int mLength;
+		float mSamplerate;
+		unsigned int mChannels;
+		unsigned int mFrames;
+		unsigned int mReserved;
+	};
+
+	class SoundBank
+	{
+	public:
+		MappedFile *mFile;
+		const SoundBankEntry *mEntries;
+		unsigned int mCount;
+
+		SoundBank();
+		~SoundBank();
+		// Map a bank file. Sounds loaded from the bank may point into the mapping,
+		// so the bank has to outlive them. Banks with an unknown entry format, a
+		// misaligned payload or a payload past the end of the file are rejected.
+		result open(const char *aFilename);
+		void close();
+		// Binary search the index; returns 0 if the id is not in the bank
+		const SoundBankEntry *find(unsigned int aId) const;
+		// Start of an entry's payload inside the mapping
+		const unsigned char *getPayload(const SoundBankEntry *aEntry) const;
+
+		// Pack files into a bank. aIds must be unique. With aDecode set, sounds are
+		// stored as FLOAT32 so loading them is zero-copy (at the cost of a larger bank).
+		static result write(const char *aFilename, const unsigned int *aIds, const char * const *aFiles, unsigned int aCount, bool aDecode);
+	};
+};
+
+#endif
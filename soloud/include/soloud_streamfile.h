@@ -0,0 +1,70 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_STREAMFILE_H
+#define SOLOUD_STREAMFILE_H
+
+#include "soloud.h"
+#include "soloud_file.h"
+
+namespace SoLoud
+{
+	struct StreamFileState;
+
+	// Read-ahead disk file for streaming.
+	//
+	// One background thread keeps a window of large, chunk aligned reads in flight
+	// for every open StreamFile: through io_uring on Linux, or a small pool of
+	// pread threads where io_uring isn't available. read() copies from completed
+	// chunks; only if the data hasn't arrived yet does it fall back to a blocking
+	// read, which is counted as a stall. The thread sleeps (in the ring, or on a
+	// semaphore) until a stream moves on or a read lands.
+	//
+	// Available on POSIX systems; open() returns NOT_IMPLEMENTED elsewhere.
+	class StreamFile : public File
+	{
+	public:
+		StreamFile();
+		virtual ~StreamFile();
+		result open(const char *aFilename);
+
+		virtual int eof();
+		virtual unsigned int read(unsigned char *aDst, unsigned int aBytes);
+		virtual unsigned int length();
+		virtual void seek(int aOffset);
+		virtual unsigned int pos();
+
+		// Reads that had to wait for the disk
+		unsigned int getStallCount();
+		// True if the reader thread is using io_uring rather than pread threads
+		static bool isUsingIoUring();
+
+		StreamFileState *mState;
+		unsigned int mOffset;
+		unsigned int mLength;
+	};
+};
+
+#endif
@@ -41,6 +41,14 @@ namespace SoLoud
 		void lockMutex(void *aHandle);
 		void unlockMutex(void *aHandle);
 
+		// Counting semaphore, for waking a thread up without a mutex. Signaling never
+		// blocks, so an audio callback may do it.
+		void * createSemaphore();
+		void destroySemaphore(void *aHandle);
+		void signalSemaphore(void *aHandle);
+		// Wait until signaled or aMSec milliseconds pass; returns false on timeout
+		bool waitSemaphore(void *aHandle, int aMSec);
+
 		ThreadHandle createThread(threadFunction aThreadFunction, void *aParameter);
 
 		void sleep(int aMSec);
@@ -48,6 +56,12 @@ namespace SoLoud
         void release(ThreadHandle aThreadHandle);
 		int getTimeMillis();
 
+		// Move the calling thread to real-time scheduling (SCHED_FIFO) at aPriority, 1-99.
+		// Returns false when the platform or the process' privileges don't allow it.
+		bool setRealtimePriority(int aPriority);
+		// Pin the calling thread to CPU aCpu. Returns false if it can't be pinned.
+		bool setAffinity(int aCpu);
+
 #define MAX_THREADPOOL_TASKS 1024
 
 		class PoolTask
@@ -73,6 +87,7 @@ namespace SoLoud
 			int mThreadCount; // number of threads
 			ThreadHandle *mThread; // array of thread handles
 			void *mWorkMutex; // mutex to protect task array/maxtask
+			void *mWorkSemaphore; // signaled per added task; idle threads wait on it
 			PoolTask *mTaskArray[MAX_THREADPOOL_TASKS]; // pointers to tasks
 			int mMaxTask; // how many tasks are pending
 			int mRobin; // cyclic counter, used to pick jobs for threads
@@ -0,0 +1,89 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_TRACE_H
+#define SOLOUD_TRACE_H
+
+#include <atomic>
+#include "soloud.h"
+
+// Events kept per thread; older ones are overwritten (power of two)
+#define TRACE_RING_SIZE 32768
+
+namespace SoLoud
+{
+	// One complete ("X") event. Fields are relaxed atomics so save() can copy a ring
+	// while its thread keeps writing; torn copies are recognized and dropped.
+	struct TraceEvent
+	{
+		std::atomic<const char *> mName;
+		std::atomic<unsigned long long> mStart;
+		std::atomic<unsigned long long> mEnd;
+		std::atomic<int> mArg;
+	};
+
+	// Single producer ring, owned by the thread that records into it. When the thread
+	// exits the ring is marked free, and the next thread to start tracing takes it over.
+	struct TraceRing
+	{
+		std::atomic<unsigned long long> mHead;
+		// Events before this were recorded by a thread that has since exited
+		std::atomic<unsigned long long> mFirst;
+		std::atomic<bool> mFree;
+		std::atomic<const char *> mName;
+		unsigned int mId;
+		TraceRing *mNext;
+		TraceEvent mEvent[TRACE_RING_SIZE];
+	};
+
+	// Process wide timeline of the audio pipeline: mix stages, audio mutex waits,
+	// decoder calls, filters and thread pool tasks, saved as Chrome trace-event JSON
+	// (chrome://tracing, ui.perfetto.dev). Every SoLoud instance records into it.
+	class Trace
+	{
+	public:
+		static void setEnable(bool aEnable);
+		static bool isEnabled()
+		{
+			return mEnabled.load(std::memory_order_relaxed);
+		}
+		// Timestamp to pass to end(), or 0 when tracing is off
+		static unsigned long long begin();
+		// Record aName from aStart until now; no-op for aStart 0. aArg < 0 has no argument.
+		static void end(const char *aName, unsigned long long aStart, int aArg = -1);
+		// Record an event with both ends known
+		static void event(const char *aName, unsigned long long aStart, unsigned long long aEnd, int aArg = -1);
+		// Label the calling thread's track. aName must outlive the trace.
+		static void setThreadName(const char *aName);
+		// Drop everything recorded so far
+		static void clear();
+		// Write the rings to a JSON file. Safe while recording.
+		static result save(const char *aFilename);
+
+		static std::atomic<bool> mEnabled;
+	};
+};
+
+#endif
@@ -25,6 +25,7 @@ freely, subject to the following restrictions:
 #ifndef SOLOUD_WAV_H
 #define SOLOUD_WAV_H
 
+#include <atomic>
 #include "soloud.h"
 
 struct stb_vorbis;
@@ -34,6 +35,19 @@ namespace SoLoud
 	class Wav;
 	class File;
 	class MemoryFile;
+	class SoundBank;
+	class WavLoader;
+	class DecodeCache;
+
+	enum WAVENVELOPE
+	{
+		// Per block envelope values: peak and RMS in dBFS, and loudness in LUFS over the
+		// 400 ms starting at the block (what is about to play)
+		WAVENVELOPE_PEAK = 0,
+		WAVENVELOPE_RMS = 1,
+		WAVENVELOPE_LOUDNESS = 2,
+		WAVENVELOPE_VALUES = 3
+	};
 
 	class WavInstance : public AudioSourceInstance
 	{
@@ -43,25 +57,97 @@ namespace SoLoud
 		WavInstance(Wav *aParent);
 		virtual unsigned int getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
 		virtual result rewind();
+		virtual result seek(time aSeconds, float *aScratch, unsigned int aScratchSize);
+		virtual unsigned int advance(unsigned int aSamples, float *aScratch, unsigned int aScratchSize);
+		virtual unsigned int tellFrame();
+		virtual result seekFrame(unsigned int aFrame);
 		virtual bool hasEnded();
+		virtual float getContentLevel();
 	};
 
 	class Wav : public AudioSource
 	{
-		result loadwav(MemoryFile *aReader);
-		result loadogg(MemoryFile *aReader);
-		result loadmp3(MemoryFile *aReader);
-		result loadflac(MemoryFile *aReader);
-		result testAndLoadFile(MemoryFile *aReader);
+		result loadwav(File *aReader, bool aReference);
+		result loadogg(File *aReader);
+		result loadmp3(File *aReader);
+		result loadflac(File *aReader);
+		result testAndLoadFile(File *aReader, bool aReference = false);
+		result loadCached_internal(DecodeCache *aCache, File *aReader);
+		void freeData_internal();
+		// Convert freshly loaded data to mLoadSamplerate, trim and analyze it; passes a failed aRes through
+		result finishLoad_internal(result aRes);
+		void convertSamplerate_internal();
+		void trimSilence_internal();
+		void analyzeLoudness_internal();
 	public:
+		// Take over the sample data of a Wav decoded elsewhere (used by WavLoader)
+		void adoptData_internal(Wav &aSource);
+		// Drop a pending loadAsync, if any
+		void cancelLoad_internal();
 		float *mData;
 		unsigned int mSampleCount;
+		// If set, mData points straight into this file's mapping instead of an owned buffer
+		File *mDataFile;
+		// mData points into memory owned by someone else (a SoundBank)
+		bool mDataShared;
+		// Loader handling a pending loadAsync, and its outcome
+		WavLoader *mLoader;
+		std::atomic<int> mLoadPending;
+		result mLoadResult;
+		// Samplerate loads convert to, or 0 to keep the source rate
+		float mLoadSamplerate;
+		// Load time analysis settings; see setTrimSilence and setAnalyzeLoudness
+		float mTrimThreshold;
+		bool mAnalyzeLoudness;
+		// Frames of silence trimmed off the start and end, at the stored samplerate
+		unsigned int mTrimStart;
+		unsigned int mTrimEnd;
+		// Whole sound statistics: linear peak and RMS, integrated (gated) loudness in LUFS
+		float mPeak;
+		float mRms;
+		float mLoudness;
+		// mEnvelopeCount blocks of mEnvelopeBlock frames, WAVENVELOPE_VALUES bytes each,
+		// in -0.5 dB steps; NULL unless analyzed
+		unsigned char *mEnvelope;
+		unsigned int mEnvelopeBlock;
+		unsigned int mEnvelopeCount;
 
 		Wav();
 		virtual ~Wav();
 		result load(const char *aFilename);
 		result loadMem(const unsigned char *aMem, unsigned int aLength, bool aCopy = false, bool aTakeOwnership = true);
 		result loadFile(File *aFile);
+		// Load sound aId from a bank. FLOAT32 entries are used in place, so the bank must outlive this Wav.
+		result loadBank(SoundBank *aBank, unsigned int aId);
+		// Opt in to caching decoded compressed sources on disk for every Wav::load; 0 turns it off.
+		// The cache must outlive all loads using it.
+		static void setDecodeCache(DecodeCache *aCache);
+		static DecodeCache *getDecodeCache();
+		// Queue the file for decoding on a loader's worker threads (a shared default loader if none is given).
+		// Higher priorities are decoded first. Don't play the sound before isLoading() returns false.
+		result loadAsync(const char *aFilename, int aPriority = 0, WavLoader *aLoader = 0);
+		// loadAsync for sound aId of a bank. The bank must outlive the load, and for FLOAT32 entries the Wav.
+		result loadBankAsync(SoundBank *aBank, unsigned int aId, int aPriority = 0, WavLoader *aLoader = 0);
+		bool isLoading();
+		// Wait for a pending loadAsync or loadBankAsync to finish and return its result. Runs the load on
+		// the calling thread if no worker has picked it up yet.
+		result waitLoad();
+		// Convert to aSamplerate with a windowed-sinc resampler while loading (load, loadMem,
+		// loadFile, loadBank and loadAsync). Played at the engine's samplerate, such sounds
+		// skip the mixer's linear resampler. 0 (the default) keeps the source rate.
+		void setLoadSamplerate(float aSamplerate);
+		// Cut leading and trailing frames where every channel stays at or below aThreshold
+		// while loading. 0 turns it off.
+		void setTrimSilence(float aThreshold);
+		// Frames setTrimSilence cut off the start and the end, at the stored samplerate.
+		// Add getTrimStart() to a frame of the trimmed sound to find it in the source.
+		unsigned int getTrimStart();
+		unsigned int getTrimEnd();
+		// Measure peak, RMS and loudness (ITU-R BS.1770) while loading, for the whole sound
+		// and as a 100 ms block envelope. Instances report it for loudness-aware voice selection.
+		void setAnalyzeLoudness(bool aEnable);
+		// Envelope value (a WAVENVELOPE kind) at aFrame; the floor value if not analyzed
+		float getEnvelope(unsigned int aFrame, unsigned int aKind);
 		result loadRawWave8(unsigned char *aMem, unsigned int aLength, float aSamplerate = 44100.0f, unsigned int aChannels = 1);
 		result loadRawWave16(short *aMem, unsigned int aLength, float aSamplerate = 44100.0f, unsigned int aChannels = 1);
 		result loadRawWave(float *aMem, unsigned int aLength, float aSamplerate = 44100.0f, unsigned int aChannels = 1, bool aCopy = false, bool aTakeOwnership = true);
@@ -0,0 +1,100 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#ifndef SOLOUD_WAVLOADER_H
+#define SOLOUD_WAVLOADER_H
+
+#include <atomic>
+#include "soloud.h"
+#include "soloud_thread.h"
+
+namespace SoLoud
+{
+	class Wav;
+	class SoundBank;
+	class WavLoader;
+	struct WavLoadJob;
+
+	// Occupies one pool thread for the loader's lifetime, taking queued loads
+	class WavLoaderTask : public Thread::PoolTask
+	{
+	public:
+		WavLoader *mLoader;
+		virtual void work();
+	};
+
+	// Decodes Wav files on a thread pool. Queued loads are kept in priority order;
+	// each worker keeps taking the highest priority load that is still waiting, so
+	// raising the priority of a sound that's about to play gets it decoded next.
+	// However many loads are queued, they wait for a worker; none run on the caller.
+	class WavLoader
+	{
+	public:
+		WavLoader();
+		~WavLoader();
+		// Start the worker threads; 0 uses one per hardware thread. Called
+		// automatically with 0 on the first load if not called before.
+		result init(int aThreadCount = 0);
+		// Queue a load into aWav. Normally called through Wav::loadAsync.
+		result load(Wav *aWav, const char *aFilename, int aPriority = 0);
+		// Queue loading sound aId of aBank into aWav. Normally called through Wav::loadBankAsync.
+		result loadBank(Wav *aWav, SoundBank *aBank, unsigned int aId, int aPriority = 0);
+		// Queue loads for aCount sounds at once
+		result loadBatch(Wav *aWavs, const char * const *aFilenames, unsigned int aCount, int aPriority = 0);
+		// Wait until every queued load has finished
+		void waitAll();
+		// Number of loads queued or in progress
+		unsigned int getPendingCount();
+
+		// Remove aWav's load from the queue, or detach it from the worker decoding it
+		void cancel_internal(Wav *aWav);
+		// Run aWav's load on the calling thread if it is still queued; returns false if not found
+		bool runNow_internal(Wav *aWav);
+		// Pop and run the highest priority queued load; returns false if the queue was empty
+		bool runOne_internal();
+		// Worker loop: run queued loads until the loader is destroyed
+		void work_internal();
+
+		// Shared loader used by Wav::loadAsync when no loader is given
+		static WavLoader *getDefault();
+
+		Thread::Pool *mPool;
+		WavLoaderTask *mTasks;
+		// Signaled once per queued load, and once per worker on shutdown
+		void *mWake;
+		std::atomic<int> mQuit;
+		void *mMutex;
+		WavLoadJob *mQueue;
+		WavLoadJob *mRunning;
+		unsigned int mPending;
+	private:
+		result initPool_internal(int aThreadCount);
+		// Fill in aJob for aWav and put it in the queue
+		result queue_internal(Wav *aWav, WavLoadJob *aJob, int aPriority);
+		void finish_internal(WavLoadJob *aJob, Wav &aResult, result aRes);
+	};
+};
+
+#endif
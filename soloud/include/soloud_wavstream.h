@@ -26,6 +26,7 @@ freely, subject to the following restrictions:
 #define SOLOUD_WAVSTREAM_H
 
 #include <stdio.h>
+#include <atomic>
 #include "soloud.h"
 
 struct stb_vorbis;
@@ -43,12 +44,16 @@ namespace SoLoud
 {
 	class WavStream;
 	class File;
+	struct WavStreamAhead;
 
 	class WavStreamInstance : public AudioSourceInstance
 	{
+		friend struct WavStreamAhead;
 		WavStream *mParent;
 		unsigned int mOffset;
 		File *mFile;
+		// mFile is a StreamFile
+		bool mReadAheadFile;
 		union codec
 		{
 			stb_vorbis *mOgg;
@@ -59,11 +64,36 @@ namespace SoLoud
 		unsigned int mOggFrameSize;
 		unsigned int mOggFrameOffset;
 		float **mOggOutputs;
+		// advance() only moves mOffset; the decoder catches up on the next read
+		bool mSeekPending;
+		// Decode-ahead ring fed by the decoder thread, or NULL when decoding on the audio thread
+		WavStreamAhead *mAhead;
+		result seekFrame_internal(unsigned int aFrame);
+		// Decode straight from the codec
+		unsigned int decode_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
+		unsigned int readAhead_internal(float *aBuffer, unsigned int aSamples, unsigned int aBufferSize);
+		result seekAhead_internal(unsigned int aFrame);
 	public:
-		WavStreamInstance(WavStream *aParent);
+		enum INFO
+		{
+			// Times the decode-ahead ring ran dry, and the samples of silence played instead
+			INFO_UNDERRUNS = 0,
+			INFO_UNDERRUN_SAMPLES = 1,
+			// Decoded samples waiting in the decode-ahead ring
+			INFO_BUFFERED_SAMPLES = 2,
+			// Reads that had to wait for the disk, when read-ahead is on
+			INFO_READ_STALLS = 3
+		};
+
+		WavStreamInstance(WavStream *aParent, bool aAllowDecodeAhead = true);
 		virtual unsigned int getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
 		virtual result rewind();
+		virtual result seek(time aSeconds, float *aScratch, unsigned int aScratchSize);
+		virtual unsigned int advance(unsigned int aSamples, float *aScratch, unsigned int aScratchSize);
+		virtual unsigned int tellFrame();
+		virtual result seekFrame(unsigned int aFrame);
 		virtual bool hasEnded();
+		virtual float getInfo(unsigned int aInfoKey);
 		virtual ~WavStreamInstance();
 	};
 
@@ -81,12 +111,26 @@ namespace SoLoud
 		result loadogg(File *fp);
 		result loadflac(File *fp);
 		result loadmp3(File *fp);
+		// Stop the instances and free the loaded data, once the decoder thread has let go of it
+		void clear_internal();
 	public:
 		int mFiletype;
 		char *mFilename;
 		File *mMemFile;
 		File *mStreamFile;
 		unsigned int mSampleCount;
+		// mp3 seek table (drmp3_seek_point array), shared by all instances
+		void *mMp3SeekPoints;
+		unsigned int mMp3SeekPointCount;
+		// How far ahead new instances are decoded on the decoder thread; 0 decodes on the audio thread
+		unsigned int mDecodeAheadMs;
+		// Instances of file based streams read through a StreamFile
+		bool mReadAhead;
+		// Decode-ahead instances the decoder thread hasn't released yet
+		std::atomic<int> mAheadInstances;
+		// Decode-ahead underruns over all instances
+		std::atomic<unsigned int> mUnderruns;
+		std::atomic<unsigned int> mUnderrunSamples;
 
 		WavStream();
 		virtual ~WavStream();
@@ -95,6 +139,15 @@ namespace SoLoud
 		result loadToMem(const char *aFilename);
 		result loadFile(File *aFile);
 		result loadFileToMem(File *aFile);		
+		// Decode new instances on a shared background thread, keeping aMilliseconds of audio
+		// buffered so the audio thread never waits on the decoder or file. 0 turns it off.
+		result setDecodeAhead(unsigned int aMilliseconds);
+		// Read file based streams through a StreamFile, which keeps large reads in flight
+		// on a background thread instead of reading from the audio thread.
+		result setReadAhead(bool aEnable);
+		// Decode-ahead underruns and the samples of silence they caused, over all instances
+		unsigned int getUnderrunCount();
+		unsigned int getUnderrunSamples();
 		virtual AudioSourceInstance *createInstance();
 		time getLength();
 
@@ -0,0 +1,267 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include <stdio.h>
+#if defined(_WIN32)||defined(_WIN64)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include "soloud.h"
+#include "soloud_file.h"
+#include "soloud_decodecache.h"
+
+namespace SoLoud
+{
+	DecodeCache::DecodeCache()
+	{
+		mDirectory = 0;
+		mFormat = DECODECACHE_F32;
+		mHits.store(0);
+		mMisses.store(0);
+		mRejects.store(0);
+		mTempSerial.store(0);
+	}
+
+	DecodeCache::~DecodeCache()
+	{
+		delete[] mDirectory;
+	}
+
+	result DecodeCache::init(const char *aDirectory, unsigned int aFormat)
+	{
+		if (!aDirectory || (aFormat != DECODECACHE_F32 && aFormat != DECODECACHE_S16))
+			return INVALID_PARAMETER;
+		delete[] mDirectory;
+		int len = (int)strlen(aDirectory);
+		mDirectory = new char[len + 1];
+		memcpy(mDirectory, aDirectory, len + 1);
+		mFormat = aFormat;
+		return SO_NO_ERROR;
+	}
+
+	unsigned long long DecodeCache::hash(const unsigned char *aData, unsigned int aLength)
+	{
+		// FNV-1a style, a word at a time so hashing stays well ahead of the disk
+		const unsigned long long prime = 0x100000001b3ULL;
+		unsigned long long h = 0xcbf29ce484222325ULL ^ aLength;
+		unsigned int i = 0;
+		for (; i + 8 <= aLength; i += 8)
+		{
+			unsigned long long w;
+			memcpy(&w, aData + i, 8);
+			h = (h ^ w) * prime;
+			h ^= h >> 29;
+		}
+		for (; i < aLength; i++)
+			h = (h ^ aData[i]) * prime;
+		return h ^ (h >> 32);
+	}
+
+	static unsigned int read16le(const unsigned char *p)
+	{
+		return p[0] | (p[1] << 8);
+	}
+
+	static unsigned int read32le(const unsigned char *p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+
+	bool DecodeCache::isCacheable(File *aSource)
+	{
+		const unsigned char *p = aSource->getMemPtr();
+		unsigned int len = aSource->length();
+		if (!p || len < 12)
+			return false;
+		if (memcmp(p, "RIFF", 4) != 0)
+			return true; // ogg, flac or mp3
+
+		// Find the fmt chunk; plain integer or float PCM is cheaper to decode than to cache
+		unsigned int ofs = 12;
+		while (ofs + 8 <= len)
+		{
+			unsigned int size = read32le(p + ofs + 4);
+			if (memcmp(p + ofs, "fmt ", 4) == 0)
+			{
+				if (size < 16 || ofs + 8 + size > len)
+					return false;
+				unsigned int tag = read16le(p + ofs + 8);
+				if (tag == 0xfffe && size >= 26)
+					tag = read16le(p + ofs + 8 + 24); // WAVE_FORMAT_EXTENSIBLE sub format
+				return tag != 1 && tag != 3;
+			}
+			ofs += 8 + size + (size & 1);
+		}
+		return false;
+	}
+
+	void DecodeCache::getPath_internal(unsigned long long aSourceHash, char *aPath, unsigned int aPathSize)
+	{
+		snprintf(aPath, aPathSize, "%s/%08x%08x.sldc", mDirectory, (unsigned int)(aSourceHash >> 32), (unsigned int)aSourceHash);
+	}
+
+	MappedFile *DecodeCache::lookup(unsigned long long aSourceHash, unsigned int aSourceLength, DecodeCacheHeader &aHeader)
+	{
+		if (!mDirectory)
+			return 0;
+		char path[1024];
+		getPath_internal(aSourceHash, path, sizeof(path));
+
+		MappedFile *mf = new MappedFile;
+		if (mf->open(path) != SO_NO_ERROR)
+		{
+			delete mf;
+			mMisses++;
+			return 0;
+		}
+
+		const unsigned char *p = mf->getMemPtr();
+		unsigned int len = mf->length();
+		bool ok = len >= sizeof(DecodeCacheHeader);
+		if (ok)
+		{
+			memcpy(&aHeader, p, sizeof(DecodeCacheHeader));
+			unsigned int sampleSize = aHeader.mFormat == DECODECACHE_S16 ? 2 : 4;
+			ok = memcmp(aHeader.mMagic, "SLDC", 4) == 0 &&
+				aHeader.mVersion == DECODECACHE_VERSION &&
+				(aHeader.mFormat == DECODECACHE_F32 || aHeader.mFormat == DECODECACHE_S16) &&
+				aHeader.mSourceHash == aSourceHash &&
+				aHeader.mSourceLength == aSourceLength &&
+				aHeader.mChannels >= 1 && aHeader.mChannels <= MAX_CHANNELS &&
+				aHeader.mFrames > 0 &&
+				aHeader.mPayloadOffset % DECODECACHE_ALIGNMENT == 0 &&
+				aHeader.mPayloadOffset <= len &&
+				aHeader.mPayloadLength <= len - aHeader.mPayloadOffset &&
+				(unsigned long long)aHeader.mFrames * aHeader.mChannels * sampleSize == aHeader.mPayloadLength;
+		}
+		if (ok)
+			ok = hash(p + aHeader.mPayloadOffset, aHeader.mPayloadLength) == aHeader.mPayloadChecksum;
+
+		if (!ok)
+		{
+			delete mf;
+			mRejects++;
+			mMisses++;
+			return 0;
+		}
+		mHits++;
+		return mf;
+	}
+
+	result DecodeCache::store(unsigned long long aSourceHash, unsigned int aSourceLength, const float *aData, unsigned int aFrames, unsigned int aChannels, float aSamplerate)
+	{
+		if (!mDirectory)
+			return INVALID_PARAMETER;
+		if (!aData || aFrames == 0 || aChannels < 1 || aChannels > MAX_CHANNELS)
+			return INVALID_PARAMETER;
+
+		unsigned int sampleSize = mFormat == DECODECACHE_S16 ? 2 : 4;
+		unsigned long long bytes = (unsigned long long)aFrames * aChannels * sampleSize;
+		if (bytes > 0xffffffffULL - DECODECACHE_ALIGNMENT * 2)
+			return OUT_OF_MEMORY;
+
+		DecodeCacheHeader hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.mMagic, "SLDC", 4);
+		hdr.mVersion = DECODECACHE_VERSION;
+		hdr.mFormat = mFormat;
+		hdr.mChannels = aChannels;
+		hdr.mSamplerate = aSamplerate;
+		hdr.mFrames = aFrames;
+		hdr.mSourceLength = aSourceLength;
+		hdr.mPayloadOffset = (sizeof(hdr) + DECODECACHE_ALIGNMENT - 1) / DECODECACHE_ALIGNMENT * DECODECACHE_ALIGNMENT;
+		hdr.mPayloadLength = (unsigned int)bytes;
+		hdr.mSourceHash = aSourceHash;
+
+		const unsigned char *payload = (const unsigned char *)aData;
+		short *s16 = 0;
+		if (mFormat == DECODECACHE_S16)
+		{
+			unsigned int i, n = aFrames * aChannels;
+			s16 = new short[n];
+			for (i = 0; i < n; i++)
+			{
+				float v = aData[i] * 32768.0f;
+				if (v > 32767.0f) v = 32767.0f;
+				if (v < -32768.0f) v = -32768.0f;
+				s16[i] = (short)(v < 0 ? v - 0.5f : v + 0.5f);
+			}
+			payload = (const unsigned char *)s16;
+		}
+		hdr.mPayloadChecksum = hash(payload, hdr.mPayloadLength);
+
+		// Write under a unique name and rename into place, so a concurrent reader
+		// (or a crash) never sees a half written entry
+		char path[1024], temp[1100];
+		getPath_internal(aSourceHash, path, sizeof(path));
+		snprintf(temp, sizeof(temp), "%s.%d.%u.tmp", path, (int)getpid(), mTempSerial.fetch_add(1));
+
+		result res = SO_NO_ERROR;
+		FILE *f = fopen(temp, "wb");
+		if (!f)
+			res = FILE_NOT_FOUND;
+		else
+		{
+			static const unsigned char zero[DECODECACHE_ALIGNMENT] = { 0 };
+			unsigned int pad = hdr.mPayloadOffset - (unsigned int)sizeof(hdr);
+			if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+				(pad && fwrite(zero, 1, pad, f) != pad) ||
+				fwrite(payload, 1, hdr.mPayloadLength, f) != hdr.mPayloadLength)
+				res = FILE_LOAD_FAILED;
+			if (fclose(f) != 0)
+				res = FILE_LOAD_FAILED;
+			if (res == SO_NO_ERROR)
+			{
+#if defined(_WIN32)||defined(_WIN64)
+				remove(path); // rename() won't replace an existing file here
+#endif
+				if (rename(temp, path) != 0)
+					res = FILE_LOAD_FAILED;
+			}
+			if (res != SO_NO_ERROR)
+				remove(temp);
+		}
+		delete[] s16;
+		return res;
+	}
+
+	unsigned int DecodeCache::getHitCount()
+	{
+		return mHits.load();
+	}
+
+	unsigned int DecodeCache::getMissCount()
+	{
+		return mMisses.load();
+	}
+
+	unsigned int DecodeCache::getRejectCount()
+	{
+		return mRejects.load();
+	}
+};
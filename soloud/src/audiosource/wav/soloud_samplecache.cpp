@@ -0,0 +1,400 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include <stdio.h>
+#include "soloud.h"
+#include "soloud_thread.h"
+#include "soloud_wav.h"
+#include "soloud_soundbank.h"
+#include "soloud_samplecache.h"
+
+namespace SoLoud
+{
+	struct SampleCacheEntry
+	{
+		char *mKey;
+		unsigned int mHash;
+		Wav *mWav;
+		unsigned long long mBytes;
+		int mRefs;
+		SampleCacheEntry *mBucketNext;
+		// Chain in the table keyed by mWav, so release() finds the entry directly
+		SampleCacheEntry *mWavBucketNext;
+		SampleCacheEntry *mPrev;
+		SampleCacheEntry *mNext;
+	};
+
+	// FNV-1a
+	static unsigned int hashKey(const char *aKey)
+	{
+		unsigned int h = 2166136261u;
+		while (*aKey)
+		{
+			h ^= (unsigned char)*aKey++;
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	static unsigned int hashWav(Wav *aWav)
+	{
+		// Drop the alignment bits, then spread the rest over the table
+		return (unsigned int)((size_t)aWav >> 4) * 2654435761u;
+	}
+
+	// Bytes the cache frees by evicting aWav. Data mapped from a file or shared
+	// with a SoundBank belongs to someone else, so it doesn't count.
+	static unsigned long long wavBytes(Wav *aWav)
+	{
+		if (aWav->mDataFile || aWav->mDataShared)
+			return 0;
+		return (unsigned long long)aWav->mSampleCount * aWav->mChannels * sizeof(float);
+	}
+
+	static bool isPlaying(Wav *aWav)
+	{
+		return aWav->mSoloud && aWav->mSoloud->countAudioSource(*aWav) > 0;
+	}
+
+	SampleCache::SampleCache()
+	{
+		mMutex = Thread::createMutex();
+		mBucketCount = 64;
+		mBucket = new SampleCacheEntry*[mBucketCount];
+		memset(mBucket, 0, sizeof(SampleCacheEntry*) * mBucketCount);
+		mWavBucket = new SampleCacheEntry*[mBucketCount];
+		memset(mWavBucket, 0, sizeof(SampleCacheEntry*) * mBucketCount);
+		mHead = 0;
+		mTail = 0;
+		mBudget = 0;
+		mResidentBytes = 0;
+		mEntryCount = 0;
+		mHits = 0;
+		mMisses = 0;
+		mEvictions = 0;
+	}
+
+	SampleCache::~SampleCache()
+	{
+		while (mHead)
+		{
+			SampleCacheEntry *e = mHead;
+			unlink_internal(e);
+			delete e->mWav;
+			delete[] e->mKey;
+			delete e;
+		}
+		delete[] mBucket;
+		delete[] mWavBucket;
+		Thread::destroyMutex(mMutex);
+	}
+
+	void SampleCache::setBudget(unsigned long long aBytes)
+	{
+		Thread::lockMutex(mMutex);
+		mBudget = aBytes;
+		if (mBudget)
+			evict_internal(mBudget);
+		Thread::unlockMutex(mMutex);
+	}
+
+	unsigned long long SampleCache::getBudget()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned long long budget = mBudget;
+		Thread::unlockMutex(mMutex);
+		return budget;
+	}
+
+	SampleCacheEntry *SampleCache::find_internal(const char *aKey, unsigned int aHash)
+	{
+		SampleCacheEntry *e = mBucket[aHash & (mBucketCount - 1)];
+		while (e && (e->mHash != aHash || strcmp(e->mKey, aKey) != 0))
+			e = e->mBucketNext;
+		return e;
+	}
+
+	SampleCacheEntry *SampleCache::findWav_internal(Wav *aWav)
+	{
+		SampleCacheEntry *e = mWavBucket[hashWav(aWav) & (mBucketCount - 1)];
+		while (e && e->mWav != aWav)
+			e = e->mWavBucketNext;
+		return e;
+	}
+
+	void SampleCache::touch_internal(SampleCacheEntry *aEntry)
+	{
+		if (mHead == aEntry)
+			return;
+		// Move to the front of the LRU list
+		aEntry->mPrev->mNext = aEntry->mNext;
+		if (aEntry->mNext)
+			aEntry->mNext->mPrev = aEntry->mPrev;
+		else
+			mTail = aEntry->mPrev;
+		aEntry->mPrev = 0;
+		aEntry->mNext = mHead;
+		mHead->mPrev = aEntry;
+		mHead = aEntry;
+	}
+
+	void SampleCache::unlink_internal(SampleCacheEntry *aEntry)
+	{
+		SampleCacheEntry **p = &mBucket[aEntry->mHash & (mBucketCount - 1)];
+		while (*p != aEntry)
+			p = &(*p)->mBucketNext;
+		*p = aEntry->mBucketNext;
+		p = &mWavBucket[hashWav(aEntry->mWav) & (mBucketCount - 1)];
+		while (*p != aEntry)
+			p = &(*p)->mWavBucketNext;
+		*p = aEntry->mWavBucketNext;
+
+		if (aEntry->mPrev)
+			aEntry->mPrev->mNext = aEntry->mNext;
+		else
+			mHead = aEntry->mNext;
+		if (aEntry->mNext)
+			aEntry->mNext->mPrev = aEntry->mPrev;
+		else
+			mTail = aEntry->mPrev;
+
+		mResidentBytes -= aEntry->mBytes;
+		mEntryCount--;
+	}
+
+	bool SampleCache::evictEntry_internal(SampleCacheEntry *aEntry)
+	{
+		if (aEntry->mRefs != 0 || isPlaying(aEntry->mWav))
+			return false;
+		unlink_internal(aEntry);
+		// ~Wav stops it, which also covers a voice started since the check
+		delete aEntry->mWav;
+		delete[] aEntry->mKey;
+		delete aEntry;
+		mEvictions++;
+		return true;
+	}
+
+	void SampleCache::evict_internal(unsigned long long aBudget)
+	{
+		// Oldest first; skip anything in use, and sounds whose data isn't ours
+		// since evicting them wouldn't bring the total down
+		SampleCacheEntry *e = mTail;
+		while (e && mResidentBytes > aBudget)
+		{
+			SampleCacheEntry *prev = e->mPrev;
+			if (e->mBytes)
+				evictEntry_internal(e);
+			e = prev;
+		}
+	}
+
+	Wav *SampleCache::acquire_internal(const char *aKey, const char *aFilename, SoundBank *aBank, unsigned int aId)
+	{
+		unsigned int hash = hashKey(aKey);
+
+		Thread::lockMutex(mMutex);
+		SampleCacheEntry *e = find_internal(aKey, hash);
+		if (e)
+		{
+			e->mRefs++;
+			touch_internal(e);
+			mHits++;
+			Thread::unlockMutex(mMutex);
+			return e->mWav;
+		}
+		mMisses++;
+		Thread::unlockMutex(mMutex);
+
+		// Decode outside the lock so other lookups aren't held up
+		Wav *wav = new Wav;
+		result res = aFilename ? wav->load(aFilename) : wav->loadBank(aBank, aId);
+		if (res != SO_NO_ERROR)
+		{
+			delete wav;
+			return 0;
+		}
+
+		Thread::lockMutex(mMutex);
+		e = find_internal(aKey, hash);
+		if (e)
+		{
+			// Someone else loaded it meanwhile
+			e->mRefs++;
+			touch_internal(e);
+			Thread::unlockMutex(mMutex);
+			delete wav;
+			return e->mWav;
+		}
+
+		e = new SampleCacheEntry;
+		int len = (int)strlen(aKey);
+		e->mKey = new char[len + 1];
+		memcpy(e->mKey, aKey, len + 1);
+		e->mHash = hash;
+		e->mWav = wav;
+		e->mBytes = wavBytes(wav);
+		e->mRefs = 1;
+
+		if (mEntryCount >= mBucketCount * 2)
+		{
+			// Grow the tables; entries keep their hashes so this is just relinking
+			unsigned int count = mBucketCount * 4;
+			SampleCacheEntry **bucket = new SampleCacheEntry*[count];
+			SampleCacheEntry **wavBucket = new SampleCacheEntry*[count];
+			memset(bucket, 0, sizeof(SampleCacheEntry*) * count);
+			memset(wavBucket, 0, sizeof(SampleCacheEntry*) * count);
+			SampleCacheEntry *it;
+			for (it = mHead; it; it = it->mNext)
+			{
+				it->mBucketNext = bucket[it->mHash & (count - 1)];
+				bucket[it->mHash & (count - 1)] = it;
+				unsigned int slot = hashWav(it->mWav) & (count - 1);
+				it->mWavBucketNext = wavBucket[slot];
+				wavBucket[slot] = it;
+			}
+			delete[] mBucket;
+			delete[] mWavBucket;
+			mBucket = bucket;
+			mWavBucket = wavBucket;
+			mBucketCount = count;
+		}
+
+		e->mBucketNext = mBucket[hash & (mBucketCount - 1)];
+		mBucket[hash & (mBucketCount - 1)] = e;
+		unsigned int slot = hashWav(wav) & (mBucketCount - 1);
+		e->mWavBucketNext = mWavBucket[slot];
+		mWavBucket[slot] = e;
+		e->mPrev = 0;
+		e->mNext = mHead;
+		if (mHead)
+			mHead->mPrev = e;
+		else
+			mTail = e;
+		mHead = e;
+		mResidentBytes += e->mBytes;
+		mEntryCount++;
+
+		if (mBudget)
+			evict_internal(mBudget);
+		Thread::unlockMutex(mMutex);
+		return wav;
+	}
+
+	Wav *SampleCache::acquire(const char *aFilename)
+	{
+		if (!aFilename)
+			return 0;
+		return acquire_internal(aFilename, aFilename, 0, 0);
+	}
+
+	Wav *SampleCache::acquire(SoundBank *aBank, unsigned int aId)
+	{
+		if (!aBank)
+			return 0;
+		// Bank sounds share the key space with paths; '\1' can't start a file name
+		char key[64];
+		sprintf(key, "\1%p:%u", (void *)aBank, aId);
+		return acquire_internal(key, 0, aBank, aId);
+	}
+
+	void SampleCache::release(Wav *aWav)
+	{
+		if (!aWav)
+			return;
+		Thread::lockMutex(mMutex);
+		SampleCacheEntry *e = findWav_internal(aWav);
+		if (e && e->mRefs > 0)
+		{
+			e->mRefs--;
+			if (e->mRefs == 0 && mBudget && mResidentBytes > mBudget)
+				evict_internal(mBudget);
+		}
+		Thread::unlockMutex(mMutex);
+	}
+
+	void SampleCache::trim()
+	{
+		Thread::lockMutex(mMutex);
+		SampleCacheEntry *e = mTail;
+		while (e)
+		{
+			SampleCacheEntry *prev = e->mPrev;
+			evictEntry_internal(e);
+			e = prev;
+		}
+		Thread::unlockMutex(mMutex);
+	}
+
+	unsigned int SampleCache::getHitCount()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned int n = mHits;
+		Thread::unlockMutex(mMutex);
+		return n;
+	}
+
+	unsigned int SampleCache::getMissCount()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned int n = mMisses;
+		Thread::unlockMutex(mMutex);
+		return n;
+	}
+
+	unsigned int SampleCache::getEvictionCount()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned int n = mEvictions;
+		Thread::unlockMutex(mMutex);
+		return n;
+	}
+
+	unsigned int SampleCache::getEntryCount()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned int n = mEntryCount;
+		Thread::unlockMutex(mMutex);
+		return n;
+	}
+
+	unsigned long long SampleCache::getResidentBytes()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned long long bytes = mResidentBytes;
+		Thread::unlockMutex(mMutex);
+		return bytes;
+	}
+
+	void SampleCache::resetCounters()
+	{
+		Thread::lockMutex(mMutex);
+		mHits = 0;
+		mMisses = 0;
+		mEvictions = 0;
+		Thread::unlockMutex(mMutex);
+	}
+};
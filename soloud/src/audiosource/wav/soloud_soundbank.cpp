@@ -0,0 +1,269 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "soloud.h"
+#include "soloud_file.h"
+#include "soloud_wav.h"
+#include "soloud_soundbank.h"
+
+namespace SoLoud
+{
+	SoundBank::SoundBank()
+	{
+		mFile = 0;
+		mEntries = 0;
+		mCount = 0;
+	}
+
+	SoundBank::~SoundBank()
+	{
+		close();
+	}
+
+	void SoundBank::close()
+	{
+		delete mFile;
+		mFile = 0;
+		mEntries = 0;
+		mCount = 0;
+	}
+
+	result SoundBank::open(const char *aFilename)
+	{
+		if (!aFilename)
+			return INVALID_PARAMETER;
+		close();
+
+		MappedFile *mf = new MappedFile;
+		result res = mf->open(aFilename);
+		if (res != SO_NO_ERROR)
+		{
+			delete mf;
+			return res;
+		}
+
+		const unsigned char *base = mf->getMemPtr();
+		unsigned int len = mf->length();
+		const SoundBankHeader *hdr = (const SoundBankHeader *)base;
+		if (len < sizeof(SoundBankHeader) ||
+			memcmp(hdr->mMagic, "SLBK", 4) != 0 ||
+			hdr->mVersion != SOUNDBANK_VERSION ||
+			hdr->mAlignment != SOUNDBANK_ALIGNMENT ||
+			hdr->mCount > (len - sizeof(SoundBankHeader)) / sizeof(SoundBankEntry))
+		{
+			delete mf;
+			return FILE_LOAD_FAILED;
+		}
+
+		const SoundBankEntry *entries = (const SoundBankEntry *)(base + sizeof(SoundBankHeader));
+		unsigned int i;
+		for (i = 0; i < hdr->mCount; i++)
+		{
+			// Reject anything that would make find() or a load read out of bounds,
+			// and payloads that could not be used in place as floats
+			if ((entries[i].mFormat != SOUNDBANK_FORMAT_FILE && entries[i].mFormat != SOUNDBANK_FORMAT_FLOAT32) ||
+				entries[i].mOffset % SOUNDBANK_ALIGNMENT != 0 ||
+				entries[i].mOffset > len ||
+				entries[i].mLength > len - entries[i].mOffset ||
+				(i > 0 && entries[i].mId <= entries[i - 1].mId))
+			{
+				delete mf;
+				return FILE_LOAD_FAILED;
+			}
+		}
+
+		mFile = mf;
+		mEntries = entries;
+		mCount = hdr->mCount;
+		return SO_NO_ERROR;
+	}
+
+	const SoundBankEntry *SoundBank::find(unsigned int aId) const
+	{
+		unsigned int lo = 0, hi = mCount;
+		while (lo < hi)
+		{
+			unsigned int mid = (lo + hi) / 2;
+			if (mEntries[mid].mId < aId)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < mCount && mEntries[lo].mId == aId)
+			return mEntries + lo;
+		return 0;
+	}
+
+	const unsigned char *SoundBank::getPayload(const SoundBankEntry *aEntry) const
+	{
+		if (!mFile || !aEntry)
+			return 0;
+		return mFile->getMemPtr() + aEntry->mOffset;
+	}
+
+	struct SoundBankSortItem
+	{
+		unsigned int mId;
+		unsigned int mIndex;
+	};
+
+	static int compareIds(const void *a, const void *b)
+	{
+		unsigned int ia = ((const SoundBankSortItem *)a)->mId;
+		unsigned int ib = ((const SoundBankSortItem *)b)->mId;
+		return ia < ib ? -1 : ia > ib ? 1 : 0;
+	}
+
+	static bool padTo(FILE *f, unsigned int &aPos, unsigned int aAlign)
+	{
+		static const unsigned char zero[SOUNDBANK_ALIGNMENT] = { 0 };
+		unsigned int pad = (aAlign - (aPos % aAlign)) % aAlign;
+		if (pad && fwrite(zero, 1, pad, f) != pad)
+			return false;
+		aPos += pad;
+		return true;
+	}
+
+	result SoundBank::write(const char *aFilename, const unsigned int *aIds, const char * const *aFiles, unsigned int aCount, bool aDecode)
+	{
+		if (!aFilename || !aIds || !aFiles || aCount == 0)
+			return INVALID_PARAMETER;
+
+		SoundBankSortItem *order = new SoundBankSortItem[aCount];
+		unsigned int i;
+		for (i = 0; i < aCount; i++)
+		{
+			order[i].mId = aIds[i];
+			order[i].mIndex = i;
+		}
+		qsort(order, aCount, sizeof(SoundBankSortItem), compareIds);
+		for (i = 1; i < aCount; i++)
+		{
+			if (order[i].mId == order[i - 1].mId)
+			{
+				delete[] order;
+				return INVALID_PARAMETER;
+			}
+		}
+
+		FILE *f = fopen(aFilename, "wb");
+		if (!f)
+		{
+			delete[] order;
+			return FILE_NOT_FOUND;
+		}
+
+		SoundBankHeader hdr;
+		memcpy(hdr.mMagic, "SLBK", 4);
+		hdr.mVersion = SOUNDBANK_VERSION;
+		hdr.mCount = aCount;
+		hdr.mAlignment = SOUNDBANK_ALIGNMENT;
+
+		SoundBankEntry *entries = new SoundBankEntry[aCount];
+		memset(entries, 0, sizeof(SoundBankEntry) * aCount);
+
+		// Leave room for the index, which is written once the payload offsets are known
+		unsigned int pos = 0;
+		result res = SO_NO_ERROR;
+		if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+			fwrite(entries, sizeof(SoundBankEntry), aCount, f) != aCount)
+			res = FILE_LOAD_FAILED;
+		pos = sizeof(hdr) + sizeof(SoundBankEntry) * aCount;
+
+		for (i = 0; i < aCount && res == SO_NO_ERROR; i++)
+		{
+			const char *name = aFiles[order[i].mIndex];
+			SoundBankEntry &e = entries[i];
+
+			// Decode once even for FILE payloads: it validates the file and gives us the index fields
+			Wav wav;
+			res = wav.load(name);
+			if (res != SO_NO_ERROR)
+				break;
+
+			e.mId = order[i].mId;
+			e.mSamplerate = wav.mBaseSamplerate;
+			e.mChannels = wav.mChannels;
+			e.mFrames = wav.mSampleCount;
+
+			if (!padTo(f, pos, SOUNDBANK_ALIGNMENT))
+			{
+				res = FILE_LOAD_FAILED;
+				break;
+			}
+			e.mOffset = pos;
+
+			if (aDecode)
+			{
+				e.mFormat = SOUNDBANK_FORMAT_FLOAT32;
+				unsigned long long bytes = (unsigned long long)wav.mSampleCount * wav.mChannels * sizeof(float);
+				if (bytes > 0xffffffffULL - pos)
+				{
+					res = OUT_OF_MEMORY;
+					break;
+				}
+				e.mLength = (unsigned int)bytes;
+				if (fwrite(wav.mData, 1, e.mLength, f) != e.mLength)
+					res = FILE_LOAD_FAILED;
+			}
+			else
+			{
+				e.mFormat = SOUNDBANK_FORMAT_FILE;
+				MemoryFile mf;
+				res = mf.openToMem(name);
+				if (res != SO_NO_ERROR)
+					break;
+				e.mLength = mf.length();
+				if (e.mLength > 0xffffffff - pos)
+				{
+					res = OUT_OF_MEMORY;
+					break;
+				}
+				if (fwrite(mf.getMemPtr(), 1, e.mLength, f) != e.mLength)
+					res = FILE_LOAD_FAILED;
+			}
+			pos += e.mLength;
+		}
+
+		if (res == SO_NO_ERROR)
+		{
+			if (fseek(f, sizeof(hdr), SEEK_SET) != 0 ||
+				fwrite(entries, sizeof(SoundBankEntry), aCount, f) != aCount)
+				res = FILE_LOAD_FAILED;
+		}
+
+		if (fclose(f) != 0 && res == SO_NO_ERROR)
+			res = FILE_LOAD_FAILED;
+		if (res != SO_NO_ERROR)
+			remove(aFilename);
+
+		delete[] entries;
+		delete[] order;
+		return res;
+	}
+};
@@ -25,14 +25,24 @@ freely, subject to the following restrictions:
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <thread>
 #include "soloud.h"
+#include "soloud_internal.h"
 #include "soloud_wav.h"
 #include "soloud_file.h"
+#include "soloud_soundbank.h"
+#include "soloud_thread.h"
+#include "soloud_wavloader.h"
+#include "soloud_decodecache.h"
 #include "stb_vorbis.h"
 #include "dr_mp3.h"
 #include "dr_wav.h"
 #include "dr_flac.h"
 
+// Envelope bytes hold -0.5 dB steps down from 0 dB, to this floor
+#define WAV_LEVEL_FLOOR -127.5f
+
 namespace SoLoud
 {
 	WavInstance::WavInstance(Wav *aParent)
@@ -68,6 +78,44 @@ namespace SoLoud
 		return 0;
 	}
 
+	result WavInstance::seek(double aSeconds, float * /*aScratch*/, unsigned int /*aScratchSize*/)
+	{
+		// The data is all in memory, so seeking is just moving the read offset
+		double pos = floor(aSeconds * mBaseSamplerate);
+		if (pos < 0)
+			pos = 0;
+		if (pos > mParent->mSampleCount)
+			pos = mParent->mSampleCount;
+		mOffset = (unsigned int)pos;
+		mStreamPosition = mOffset / mBaseSamplerate;
+		return SO_NO_ERROR;
+	}
+
+	unsigned int WavInstance::advance(unsigned int aSamples, float * /*aScratch*/, unsigned int /*aScratchSize*/)
+	{
+		if (mParent->mData == NULL)
+			return 0;
+
+		unsigned int dataleft = mParent->mSampleCount - mOffset;
+		if (aSamples > dataleft)
+			aSamples = dataleft;
+		mOffset += aSamples;
+		return aSamples;
+	}
+
+	unsigned int WavInstance::tellFrame()
+	{
+		return mOffset;
+	}
+
+	result WavInstance::seekFrame(unsigned int aFrame)
+	{
+		if (aFrame > mParent->mSampleCount)
+			return INVALID_PARAMETER;
+		mOffset = aFrame;
+		return SO_NO_ERROR;
+	}
+
 	bool WavInstance::hasEnded()
 	{
 		if (!(mFlags & AudioSourceInstance::LOOPING) && mOffset >= mParent->mSampleCount)
@@ -77,21 +125,621 @@ namespace SoLoud
 		return 0;
 	}
 
+	float WavInstance::getContentLevel()
+	{
+		if (!mParent->mEnvelope)
+			return 1;
+		return (float)pow(10.0, mParent->getEnvelope(mOffset, WAVENVELOPE_LOUDNESS) / 20);
+	}
+
 	Wav::Wav()
 	{
 		mData = NULL;
 		mSampleCount = 0;
+		mDataFile = NULL;
+		mDataShared = false;
+		mLoader = NULL;
+		mLoadPending.store(0);
+		mLoadResult = SO_NO_ERROR;
+		mLoadSamplerate = 0;
+		mTrimThreshold = 0;
+		mAnalyzeLoudness = false;
+		mEnvelope = NULL;
+		freeData_internal();
 	}
 	
 	Wav::~Wav()
 	{
+		cancelLoad_internal();
 		stop();
-		delete[] mData;
+		freeData_internal();
+	}
+
+	void Wav::cancelLoad_internal()
+	{
+		if (mLoadPending.load(std::memory_order_acquire) && mLoader)
+			mLoader->cancel_internal(this);
+		mLoader = NULL;
+	}
+
+	void Wav::adoptData_internal(Wav &aSource)
+	{
+		freeData_internal();
+		mData = aSource.mData;
+		mDataFile = aSource.mDataFile;
+		mDataShared = aSource.mDataShared;
+		mSampleCount = aSource.mSampleCount;
+		mChannels = aSource.mChannels;
+		mBaseSamplerate = aSource.mBaseSamplerate;
+		mEnvelope = aSource.mEnvelope;
+		mEnvelopeBlock = aSource.mEnvelopeBlock;
+		mEnvelopeCount = aSource.mEnvelopeCount;
+		mTrimStart = aSource.mTrimStart;
+		mTrimEnd = aSource.mTrimEnd;
+		mPeak = aSource.mPeak;
+		mRms = aSource.mRms;
+		mLoudness = aSource.mLoudness;
+		aSource.mData = NULL;
+		aSource.mDataFile = NULL;
+		aSource.mDataShared = false;
+		aSource.mSampleCount = 0;
+		aSource.mEnvelope = NULL;
+	}
+
+	result Wav::loadAsync(const char *aFilename, int aPriority, WavLoader *aLoader)
+	{
+		if (aFilename == 0)
+			return INVALID_PARAMETER;
+		if (!aLoader)
+			aLoader = WavLoader::getDefault();
+		return aLoader->load(this, aFilename, aPriority);
+	}
+
+	result Wav::loadBankAsync(SoundBank *aBank, unsigned int aId, int aPriority, WavLoader *aLoader)
+	{
+		if (aBank == 0)
+			return INVALID_PARAMETER;
+		if (!aLoader)
+			aLoader = WavLoader::getDefault();
+		return aLoader->loadBank(this, aBank, aId, aPriority);
+	}
+
+	bool Wav::isLoading()
+	{
+		return mLoadPending.load(std::memory_order_acquire) != 0;
+	}
+
+	result Wav::waitLoad()
+	{
+		while (mLoadPending.load(std::memory_order_acquire) && mLoader)
+		{
+			// Decode it here if no worker has got to it yet
+			if (!mLoader->runNow_internal(this))
+				Thread::sleep(1);
+		}
+		mLoader = NULL;
+		return mLoadResult;
+	}
+
+	void Wav::freeData_internal()
+	{
+		if (mDataFile)
+			delete mDataFile;
+		else if (!mDataShared)
+			delete[] mData;
+		mDataFile = NULL;
+		mDataShared = false;
+		mData = NULL;
+		delete[] mEnvelope;
+		mEnvelope = NULL;
+		mEnvelopeBlock = 0;
+		mEnvelopeCount = 0;
+		mTrimStart = 0;
+		mTrimEnd = 0;
+		mPeak = 0;
+		mRms = 0;
+		mLoudness = WAV_LEVEL_FLOOR;
+	}
+
+	// Load time samplerate conversion: a Kaiser windowed sinc, tabulated at
+	// SINC_PHASES sub-sample offsets and interpolated linearly in between.
+	// Output is cut into SINC_BLOCK frame blocks, shared out over a thread pool.
+#define SINC_ZERO_CROSSINGS 16
+#define SINC_PHASES 256
+#define SINC_KAISER_BETA 8.6
+#define SINC_BLOCK 16384
+// Bounds the kernel for large downsampling ratios, at the cost of a wider transition band
+#define SINC_MAX_HALF 256
+
+	static double besselI0(double aX)
+	{
+		double sum = 1, term = 1, x2 = aX * aX / 4;
+		int k;
+		for (k = 1; k < 50 && term > sum * 1e-12; k++)
+		{
+			term *= x2 / (k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	struct SincResampler
+	{
+		const float *mSrc;
+		float *mDst;
+		unsigned int mSrcFrames;
+		unsigned int mDstFrames;
+		unsigned int mChannels;
+		// Source frames per output frame
+		double mStep;
+		// Kernel reaches mHalf source frames either side; rows of 2 * mHalf taps
+		int mHalf;
+		float *mTable;
+		unsigned int mBlocks;
+		std::atomic<unsigned int> mNextBlock;
+		// Signaled by each pool task once it is done with the resampler
+		void *mTaskDone;
+
+		void buildTable()
+		{
+			// Cut off a little below the lower Nyquist frequency
+			double cutoff = (mStep > 1 ? 1 / mStep : 1) * 0.95;
+			mHalf = (int)ceil(SINC_ZERO_CROSSINGS / cutoff);
+			if (mHalf > SINC_MAX_HALF)
+				mHalf = SINC_MAX_HALF;
+			int taps = mHalf * 2;
+			mTable = new float[(SINC_PHASES + 1) * taps];
+			double norm = besselI0(SINC_KAISER_BETA);
+			int p, k;
+			for (p = 0; p <= SINC_PHASES; p++)
+			{
+				float *row = mTable + p * taps;
+				double sum = 0;
+				for (k = 0; k < taps; k++)
+				{
+					double x = k - mHalf + 1 - p / (double)SINC_PHASES;
+					double w = x / mHalf;
+					double h = 0;
+					if (w > -1 && w < 1)
+					{
+						double y = M_PI * cutoff * x;
+						h = cutoff * (y == 0 ? 1 : sin(y) / y) * besselI0(SINC_KAISER_BETA * sqrt(1 - w * w)) / norm;
+					}
+					row[k] = (float)h;
+					sum += h;
+				}
+				// Unity gain at DC for every phase
+				for (k = 0; k < taps; k++)
+					row[k] = (float)(row[k] / sum);
+			}
+		}
+
+		void runBlock(unsigned int aBlock)
+		{
+			unsigned int first = aBlock * SINC_BLOCK;
+			unsigned int last = first + SINC_BLOCK;
+			if (last > mDstFrames)
+				last = mDstFrames;
+			int taps = mHalf * 2;
+			float coef[SINC_MAX_HALF * 2];
+			unsigned int i, c;
+			for (i = first; i < last; i++)
+			{
+				double t = i * mStep;
+				int base = (int)floor(t);
+				double phase = (t - base) * SINC_PHASES;
+				int p = (int)phase;
+				if (p >= SINC_PHASES)
+					p = SINC_PHASES - 1;
+				float mix = (float)(phase - p);
+				const float *row0 = mTable + p * taps;
+				const float *row1 = row0 + taps;
+				int k;
+				for (k = 0; k < taps; k++)
+					coef[k] = row0[k] + (row1[k] - row0[k]) * mix;
+
+				// Taps falling outside the source read silence
+				int start = base - mHalf + 1;
+				int k0 = start < 0 ? -start : 0;
+				int k1 = taps;
+				if (start + k1 > (int)mSrcFrames)
+					k1 = (int)mSrcFrames - start;
+				for (c = 0; c < mChannels; c++)
+				{
+					const float *src = mSrc + c * mSrcFrames;
+					float acc = 0;
+					for (k = k0; k < k1; k++)
+						acc += src[start + k] * coef[k];
+					mDst[c * mDstFrames + i] = acc;
+				}
+			}
+		}
+
+		void run()
+		{
+			for (;;)
+			{
+				unsigned int b = mNextBlock.fetch_add(1, std::memory_order_relaxed);
+				if (b >= mBlocks)
+					break;
+				runBlock(b);
+			}
+		}
+	};
+
+	struct SincTask : public Thread::PoolTask
+	{
+		SincResampler *mResampler;
+		virtual void work()
+		{
+			mResampler->run();
+			// Last touch; the resampler goes away once every task has reported in
+			Thread::signalSemaphore(mResampler->mTaskDone);
+		}
+	};
+
+	static Thread::Pool *sincPool(unsigned int &aThreads)
+	{
+		static Thread::Pool *pool = NULL;
+		static unsigned int threads = 0;
+		static void *mutex = Thread::createMutex();
+		Thread::lockMutex(mutex);
+		if (!pool)
+		{
+			// The loading thread does its share, so one worker less than there are cores
+			threads = std::thread::hardware_concurrency();
+			threads = threads > 1 ? threads - 1 : 0;
+			if (threads > 8)
+				threads = 8;
+			if (threads)
+			{
+				pool = new Thread::Pool;
+				pool->init(threads);
+			}
+		}
+		Thread::unlockMutex(mutex);
+		aThreads = threads;
+		return pool;
+	}
+
+	result Wav::finishLoad_internal(result aRes)
+	{
+		if (aRes != SO_NO_ERROR || mData == NULL || mSampleCount == 0)
+			return aRes;
+		convertSamplerate_internal();
+		if (mTrimThreshold > 0)
+			trimSilence_internal();
+		if (mAnalyzeLoudness)
+			analyzeLoudness_internal();
+		return aRes;
+	}
+
+	void Wav::convertSamplerate_internal()
+	{
+		if (mLoadSamplerate <= 0 || mBaseSamplerate <= 0 || mBaseSamplerate == mLoadSamplerate)
+			return;
+
+		double frames = floor(mSampleCount * (double)mLoadSamplerate / mBaseSamplerate + 0.5);
+		// Leave sounds that can't be converted at their own rate
+		if (frames < 1 || frames * mChannels >= 0x7fffffff)
+			return;
+
+		SincResampler r;
+		r.mSrc = mData;
+		r.mSrcFrames = mSampleCount;
+		r.mDstFrames = (unsigned int)frames;
+		r.mChannels = mChannels;
+		r.mStep = mBaseSamplerate / (double)mLoadSamplerate;
+		r.buildTable();
+		r.mDst = new float[r.mDstFrames * mChannels];
+		r.mBlocks = (r.mDstFrames + SINC_BLOCK - 1) / SINC_BLOCK;
+		r.mNextBlock.store(0);
+		r.mTaskDone = NULL;
+
+		unsigned int threads = 0;
+		Thread::Pool *pool = r.mBlocks > 1 ? sincPool(threads) : NULL;
+		if (threads > r.mBlocks - 1)
+			threads = r.mBlocks - 1;
+		SincTask tasks[8];
+		if (threads)
+			r.mTaskDone = Thread::createSemaphore();
+		unsigned int i;
+		for (i = 0; i < threads; i++)
+		{
+			tasks[i].mResampler = &r;
+			pool->addWork(&tasks[i]);
+		}
+		r.run();
+		// Queued tasks point at r; wait for all of them, even ones that find nothing left to do
+		for (i = 0; i < threads; i++)
+		{
+			while (!Thread::waitSemaphore(r.mTaskDone, 1000))
+			{
+			}
+		}
+		if (r.mTaskDone)
+			Thread::destroySemaphore(r.mTaskDone);
+
+		delete[] r.mTable;
+		freeData_internal();
+		mData = r.mDst;
+		mSampleCount = r.mDstFrames;
+		mBaseSamplerate = mLoadSamplerate;
+	}
+
+	void Wav::setTrimSilence(float aThreshold)
+	{
+		mTrimThreshold = aThreshold > 0 ? aThreshold : 0;
+	}
+
+	void Wav::setAnalyzeLoudness(bool aEnable)
+	{
+		mAnalyzeLoudness = aEnable;
+	}
+
+	void Wav::trimSilence_internal()
+	{
+		unsigned int first = mSampleCount, last = 0;
+		unsigned int i, c;
+		for (c = 0; c < mChannels; c++)
+		{
+			const float *ch = mData + c * mSampleCount;
+			for (i = 0; i < first; i++)
+			{
+				if (fabs(ch[i]) > mTrimThreshold)
+				{
+					first = i;
+					break;
+				}
+			}
+			for (i = mSampleCount; i > last + 1; i--)
+			{
+				if (fabs(ch[i - 1]) > mTrimThreshold)
+				{
+					last = i - 1;
+					break;
+				}
+			}
+		}
+		// All silent: keep a single frame rather than an empty sound
+		if (first > last)
+			first = last = 0;
+		unsigned int count = last - first + 1;
+		if (count == mSampleCount)
+			return;
+
+		if (mChannels == 1 && (mDataFile || mDataShared))
+		{
+			// Not ours to move; just look at less of it
+			mData += first;
+		}
+		else if (!mDataFile && !mDataShared)
+		{
+			// Channels move down in order, so every destination is at or below its source
+			for (c = 0; c < mChannels; c++)
+				memmove(mData + c * count, mData + c * mSampleCount + first, sizeof(float) * count);
+		}
+		else
+		{
+			float *data = new float[count * mChannels];
+			for (c = 0; c < mChannels; c++)
+				memcpy(data + c * count, mData + c * mSampleCount + first, sizeof(float) * count);
+			freeData_internal();
+			mData = data;
+		}
+		mTrimStart = first;
+		mTrimEnd = mSampleCount - 1 - last;
+		mSampleCount = count;
+	}
+
+	static unsigned char encodeLevel(double aDb)
+	{
+		if (!(aDb > WAV_LEVEL_FLOOR))
+			return 255;
+		if (aDb >= 0)
+			return 0;
+		return (unsigned char)(-aDb * 2 + 0.5);
+	}
+
+	static double powerToDb(double aPower)
+	{
+		return aPower > 0 ? 10 * log10(aPower) : WAV_LEVEL_FLOOR;
+	}
+
+	// BS.1770 K-weighting: a high shelf followed by a high pass, for any samplerate
+	struct KWeighting
+	{
+		double mB[2][3];
+		double mA[2][3];
+		double mZ[2][2];
+
+		KWeighting(double aSamplerate)
+		{
+			double K = tan(M_PI * 1681.974450955533 / aSamplerate);
+			double Q = 0.7071752369554196;
+			double Vh = pow(10.0, 3.999843853973347 / 20);
+			double Vb = pow(Vh, 0.4996667741545416);
+			double a0 = 1 + K / Q + K * K;
+			mB[0][0] = (Vh + Vb * K / Q + K * K) / a0;
+			mB[0][1] = 2 * (K * K - Vh) / a0;
+			mB[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+			mA[0][1] = 2 * (K * K - 1) / a0;
+			mA[0][2] = (1 - K / Q + K * K) / a0;
+
+			K = tan(M_PI * 38.13547087602444 / aSamplerate);
+			Q = 0.5003270373238773;
+			a0 = 1 + K / Q + K * K;
+			mB[1][0] = 1;
+			mB[1][1] = -2;
+			mB[1][2] = 1;
+			mA[1][1] = 2 * (K * K - 1) / a0;
+			mA[1][2] = (1 - K / Q + K * K) / a0;
+			memset(mZ, 0, sizeof(mZ));
+		}
+
+		double process(double aX)
+		{
+			int s;
+			for (s = 0; s < 2; s++)
+			{
+				// Transposed direct form II
+				double y = mB[s][0] * aX + mZ[s][0];
+				mZ[s][0] = mB[s][1] * aX - mA[s][1] * y + mZ[s][1];
+				mZ[s][1] = mB[s][2] * aX - mA[s][2] * y;
+				aX = y;
+			}
+			return aX;
+		}
+	};
+
+	void Wav::analyzeLoudness_internal()
+	{
+		unsigned int block = (unsigned int)floor(mBaseSamplerate / 10 + 0.5);
+		if (block < 1)
+			block = 1;
+		unsigned int blocks = (mSampleCount + block - 1) / block;
+		double *peak = new double[blocks * 3];
+		double *power = peak + blocks;
+		double *weighted = power + blocks;
+		memset(peak, 0, sizeof(double) * blocks * 3);
+
+		double totalPeak = 0, totalPower = 0;
+		unsigned int i, c, b;
+		for (c = 0; c < mChannels; c++)
+		{
+			// The LFE channel of 5.1 and 7.1 doesn't count; surrounds, and the rear
+			// pair of quad, weigh +1.5 dB
+			double gain = 1;
+			if (mChannels >= 6 && c == 3)
+				gain = 0;
+			else if (mChannels >= 5 && c >= 3)
+				gain = 1.41;
+			else if (mChannels == 4 && c >= 2)
+				gain = 1.41;
+			KWeighting k(mBaseSamplerate);
+			const float *ch = mData + c * mSampleCount;
+			for (b = 0; b < blocks; b++)
+			{
+				unsigned int end = (b + 1) * block;
+				if (end > mSampleCount)
+					end = mSampleCount;
+				double p = 0, sq = 0, ksq = 0;
+				for (i = b * block; i < end; i++)
+				{
+					double x = ch[i];
+					double ax = fabs(x);
+					if (ax > p)
+						p = ax;
+					sq += x * x;
+					double z = k.process(x);
+					ksq += z * z;
+				}
+				if (p > peak[b])
+					peak[b] = p;
+				power[b] += sq;
+				weighted[b] += gain * ksq;
+			}
+		}
+
+		mEnvelope = new unsigned char[blocks * WAVENVELOPE_VALUES];
+		mEnvelopeBlock = block;
+		mEnvelopeCount = blocks;
+
+		// Gating blocks for the integrated loudness are the 400 ms windows at each
+		// 100 ms step (the whole sound if it is shorter)
+		double *window = new double[blocks];
+		unsigned int windows = 0;
+		double gatedSum = 0;
+		unsigned int gatedCount = 0;
+		for (b = 0; b < blocks; b++)
+		{
+			unsigned int start = b * block;
+			unsigned int len = block * 4;
+			if (len > mSampleCount - start)
+				len = mSampleCount - start;
+			double e = 0;
+			unsigned int j;
+			for (j = b; j < b + 4 && j < blocks; j++)
+				e += weighted[j];
+			e /= len;
+
+			unsigned int n = block;
+			if (n > mSampleCount - start)
+				n = mSampleCount - start;
+			unsigned char *env = mEnvelope + b * WAVENVELOPE_VALUES;
+			env[WAVENVELOPE_PEAK] = encodeLevel(peak[b] > 0 ? 20 * log10(peak[b]) : WAV_LEVEL_FLOOR);
+			env[WAVENVELOPE_RMS] = encodeLevel(powerToDb(power[b] / ((double)n * mChannels)));
+			env[WAVENVELOPE_LOUDNESS] = encodeLevel(e > 0 ? -0.691 + powerToDb(e) : WAV_LEVEL_FLOOR);
+
+			if (peak[b] > totalPeak)
+				totalPeak = peak[b];
+			totalPower += power[b];
+
+			if (start + block * 4 <= mSampleCount || (b == 0 && windows == 0))
+			{
+				window[windows++] = e;
+				// Absolute gate at -70 LUFS
+				if (e > 0 && -0.691 + powerToDb(e) > -70)
+				{
+					gatedSum += e;
+					gatedCount++;
+				}
+			}
+		}
+
+		mLoudness = WAV_LEVEL_FLOOR;
+		if (gatedCount)
+		{
+			// Relative gate 10 LU below the absolutely gated loudness
+			double threshold = gatedSum / gatedCount * 0.1;
+			double sum = 0;
+			unsigned int count = 0;
+			for (i = 0; i < windows; i++)
+			{
+				if (window[i] > threshold && -0.691 + powerToDb(window[i]) > -70)
+				{
+					sum += window[i];
+					count++;
+				}
+			}
+			if (count)
+				mLoudness = (float)(-0.691 + powerToDb(sum / count));
+		}
+		mPeak = (float)totalPeak;
+		mRms = (float)sqrt(totalPower / ((double)mSampleCount * mChannels));
+
+		delete[] window;
+		delete[] peak;
+	}
+
+	unsigned int Wav::getTrimStart()
+	{
+		return mTrimStart;
+	}
+
+	unsigned int Wav::getTrimEnd()
+	{
+		return mTrimEnd;
+	}
+
+	float Wav::getEnvelope(unsigned int aFrame, unsigned int aKind)
+	{
+		if (!mEnvelope || aKind >= WAVENVELOPE_VALUES)
+			return WAV_LEVEL_FLOOR;
+		unsigned int b = aFrame / mEnvelopeBlock;
+		if (b >= mEnvelopeCount)
+			b = mEnvelopeCount - 1;
+		return mEnvelope[b * WAVENVELOPE_VALUES + aKind] * -0.5f;
+	}
+
+	void Wav::setLoadSamplerate(float aSamplerate)
+	{
+		mLoadSamplerate = aSamplerate > 0 ? aSamplerate : 0;
 	}
 
 #define MAKEDWORD(a,b,c,d) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a))
 
-	result Wav::loadwav(MemoryFile *aReader)
+	result Wav::loadwav(File *aReader, bool aReference)
 	{
 		drwav decoder;
 
@@ -108,31 +756,43 @@ namespace SoLoud
 			return FILE_LOAD_FAILED;
 		}
 
+		// Mono 32-bit float data is already in our sample format and layout,
+		// so if the caller hands over the file we can play it in place.
+		if (aReference &&
+			decoder.channels == 1 &&
+			decoder.translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT &&
+			decoder.bitsPerSample == 32 &&
+			(decoder.dataChunkDataPos & 3) == 0 &&
+			decoder.dataChunkDataPos + samples * 4 <= aReader->length())
+		{
+			mData = (float *)(aReader->getMemPtr() + decoder.dataChunkDataPos);
+			mDataFile = aReader;
+			mBaseSamplerate = (float)decoder.sampleRate;
+			mSampleCount = (unsigned int)samples;
+			mChannels = 1;
+			drwav_uninit(&decoder);
+			return SO_NO_ERROR;
+		}
+
 		mData = new float[(unsigned int)(samples * decoder.channels)];
 		mBaseSamplerate = (float)decoder.sampleRate;
 		mSampleCount = (unsigned int)samples;
 		mChannels = decoder.channels;
 
-		unsigned int i, j, k;
+		unsigned int i;
 		for (i = 0; i < mSampleCount; i += 512)
 		{
 			float tmp[512 * MAX_CHANNELS];
 			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drwav_read_pcm_frames_f32(&decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++)
-			{
-				for (k = 0; k < decoder.channels; k++)
-				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder.channels + k];
-				}
-			}
+			unsigned int got = (unsigned int)drwav_read_pcm_frames_f32(&decoder, blockSize, tmp);
+			deinterlace_frames_float(tmp, mData + i, got, decoder.channels, decoder.channels, mSampleCount);
 		}
 		drwav_uninit(&decoder);
 
 		return SO_NO_ERROR;
 	}
 
-	result Wav::loadogg(MemoryFile *aReader)
+	result Wav::loadogg(File *aReader)
 	{	
 		int e = 0;
 		stb_vorbis *vorbis = 0;
@@ -178,7 +838,7 @@ namespace SoLoud
 		return 0;
 	}
 
-	result Wav::loadmp3(MemoryFile *aReader)
+	result Wav::loadmp3(File *aReader)
 	{
 		drmp3 decoder;
 
@@ -201,28 +861,22 @@ namespace SoLoud
 		mChannels = decoder.channels;
 		drmp3_seek_to_pcm_frame(&decoder, 0); 
 
-		unsigned int i, j, k;
+		unsigned int i;
 		for (i = 0; i<mSampleCount; i += 512)
 		{
 			float tmp[512 * MAX_CHANNELS];
 			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drmp3_read_pcm_frames_f32(&decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++) 
-			{
-				for (k = 0; k < decoder.channels; k++) 
-				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder.channels + k];
-				}
-			}
+			unsigned int got = (unsigned int)drmp3_read_pcm_frames_f32(&decoder, blockSize, tmp);
+			deinterlace_frames_float(tmp, mData + i, got, decoder.channels, decoder.channels, mSampleCount);
 		}
 		drmp3_uninit(&decoder);
 
 		return SO_NO_ERROR;
 	}
 
-	result Wav::loadflac(MemoryFile *aReader)
+	result Wav::loadflac(File *aReader)
 	{
-		drflac *decoder = drflac_open_memory(aReader->mDataPtr, aReader->mDataLength, NULL);
+		drflac *decoder = drflac_open_memory(aReader->getMemPtr(), aReader->length(), NULL);
 
 		if (!decoder)
 		{
@@ -243,29 +897,22 @@ namespace SoLoud
 		mChannels = decoder->channels;
 		drflac_seek_to_pcm_frame(decoder, 0);
 
-		unsigned int i, j, k;
+		unsigned int i;
 		for (i = 0; i < mSampleCount; i += 512)
 		{
 			float tmp[512 * MAX_CHANNELS];
 			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drflac_read_pcm_frames_f32(decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++)
-			{
-				for (k = 0; k < decoder->channels; k++)
-				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder->channels + k];
-				}
-			}
+			unsigned int got = (unsigned int)drflac_read_pcm_frames_f32(decoder, blockSize, tmp);
+			deinterlace_frames_float(tmp, mData + i, got, decoder->channels, decoder->channels, mSampleCount);
 		}
 		drflac_close(decoder);
 
 		return SO_NO_ERROR;
 	}
 
-    result Wav::testAndLoadFile(MemoryFile *aReader)
+    result Wav::testAndLoadFile(File *aReader, bool aReference)
     {
-		delete[] mData;
-		mData = 0;
+		freeData_internal();
 		mSampleCount = 0;
 		mChannels = 1;
         int tag = aReader->read32();
@@ -276,7 +923,7 @@ namespace SoLoud
 		} 
         else if (tag == MAKEDWORD('R','I','F','F')) 
         {
-			return loadwav(aReader);
+			return loadwav(aReader, aReference);
 		}
 		else if (tag == MAKEDWORD('f', 'L', 'a', 'C'))
 		{
@@ -290,13 +937,85 @@ namespace SoLoud
 		return FILE_LOAD_FAILED;
     }
 
+	static std::atomic<DecodeCache *> gDecodeCache(NULL);
+
+	void Wav::setDecodeCache(DecodeCache *aCache)
+	{
+		gDecodeCache.store(aCache, std::memory_order_release);
+	}
+
+	DecodeCache *Wav::getDecodeCache()
+	{
+		return gDecodeCache.load(std::memory_order_acquire);
+	}
+
+	result Wav::loadCached_internal(DecodeCache *aCache, File *aReader)
+	{
+		unsigned long long key = DecodeCache::hash(aReader->getMemPtr(), aReader->length());
+		DecodeCacheHeader hdr;
+		MappedFile *cached = aCache->lookup(key, aReader->length(), hdr);
+		if (cached)
+		{
+			freeData_internal();
+			const unsigned char *payload = cached->getMemPtr() + hdr.mPayloadOffset;
+			if (hdr.mFormat == DECODECACHE_F32)
+			{
+				// Play straight from the cache file
+				mData = (float *)payload;
+				mDataFile = cached;
+			}
+			else
+			{
+				unsigned int i, n = hdr.mFrames * hdr.mChannels;
+				const short *src = (const short *)payload;
+				mData = new float[n];
+				for (i = 0; i < n; i++)
+					mData[i] = src[i] / (float)0x8000;
+				delete cached;
+			}
+			mSampleCount = hdr.mFrames;
+			mChannels = hdr.mChannels;
+			mBaseSamplerate = hdr.mSamplerate;
+			return SO_NO_ERROR;
+		}
+
+		result res = testAndLoadFile(aReader);
+		if (res == SO_NO_ERROR)
+		{
+			// Failing to write the cache only costs a decode next time
+			aCache->store(key, aReader->length(), mData, mSampleCount, mChannels, mBaseSamplerate);
+		}
+		return res;
+	}
+
 	result Wav::load(const char *aFilename)
 	{
 		if (aFilename == 0)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
+
+		// Decode straight off a mapping of the file; fall back to reading
+		// it into memory where the file can't be mapped.
+		MappedFile *mf = new MappedFile;
+		result res = mf->open(aFilename);
+		if (res == SO_NO_ERROR)
+		{
+			DecodeCache *cache = gDecodeCache.load(std::memory_order_acquire);
+			if (cache && cache->isCacheable(mf))
+				res = loadCached_internal(cache, mf);
+			else
+				res = testAndLoadFile(mf, true);
+			if (mDataFile != mf)
+				delete mf;
+			return finishLoad_internal(res);
+		}
+		delete mf;
+		if (res == FILE_NOT_FOUND)
+			return res;
+
 		DiskFile dr;
-		int res = dr.open(aFilename);
+		res = dr.open(aFilename);
 		if (res == SO_NO_ERROR)
 			return loadFile(&dr);
 		return res;
@@ -306,19 +1025,28 @@ namespace SoLoud
 	{
 		if (aMem == NULL || aLength == 0)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
 
 		MemoryFile dr;
         dr.openMem(aMem, aLength, aCopy, aTakeOwnership);
-		return testAndLoadFile(&dr);
+		return finishLoad_internal(testAndLoadFile(&dr));
 	}
 
 	result Wav::loadFile(File *aFile)
 	{
 		if (!aFile)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
 
+		// Memory backed files can be decoded in place
+		if (aFile->getMemPtr())
+		{
+			aFile->seek(0);
+			return finishLoad_internal(testAndLoadFile(aFile));
+		}
+
 		MemoryFile mr;
 		result res = mr.openFileToMem(aFile);
 
@@ -326,7 +1054,45 @@ namespace SoLoud
 		{
 			return res;
 		}
-		return testAndLoadFile(&mr);
+		return finishLoad_internal(testAndLoadFile(&mr));
+	}
+
+	result Wav::loadBank(SoundBank *aBank, unsigned int aId)
+	{
+		if (!aBank)
+			return INVALID_PARAMETER;
+		cancelLoad_internal();
+		const SoundBankEntry *e = aBank->find(aId);
+		if (!e)
+			return FILE_NOT_FOUND;
+		stop();
+
+		const unsigned char *payload = aBank->getPayload(e);
+		if (e->mFormat == SOUNDBANK_FORMAT_FLOAT32)
+		{
+			if (e->mChannels < 1 || e->mChannels > MAX_CHANNELS ||
+				(unsigned long long)e->mFrames * e->mChannels * sizeof(float) > e->mLength)
+				return FILE_LOAD_FAILED;
+			freeData_internal();
+			mData = (float *)payload;
+			mDataShared = true;
+			mSampleCount = e->mFrames;
+			mChannels = e->mChannels;
+			mBaseSamplerate = e->mSamplerate;
+			return finishLoad_internal(SO_NO_ERROR);
+		}
+
+		if (e->mFormat == SOUNDBANK_FORMAT_FILE)
+		{
+			// Decode straight from the bank's mapping
+			MemoryFile mf;
+			result res = mf.openMem(payload, e->mLength, false, false);
+			if (res != SO_NO_ERROR)
+				return res;
+			return finishLoad_internal(testAndLoadFile(&mf));
+		}
+
+		return FILE_LOAD_FAILED;
 	}
 
 	AudioSourceInstance *Wav::createInstance()
@@ -345,8 +1111,9 @@ namespace SoLoud
 	{
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
-		delete[] mData;
+		freeData_internal();
 		mData = new float[aLength];	
 		mSampleCount = aLength / aChannels;
 		mChannels = aChannels;
@@ -361,8 +1128,9 @@ namespace SoLoud
 	{
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
-		delete[] mData;
+		freeData_internal();
 		mData = new float[aLength];
 		mSampleCount = aLength / aChannels;
 		mChannels = aChannels;
@@ -377,8 +1145,9 @@ namespace SoLoud
 	{
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
+		cancelLoad_internal();
 		stop();
-		delete[] mData;
+		freeData_internal();
 		if (aCopy == true || aTakeOwndership == false)
 		{
 			mData = new float[aLength];
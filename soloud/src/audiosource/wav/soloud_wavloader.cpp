@@ -0,0 +1,339 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include <thread>
+#include "soloud.h"
+#include "soloud_wav.h"
+#include "soloud_wavloader.h"
+
+namespace SoLoud
+{
+	struct WavLoadJob
+	{
+		Wav *mWav; // cleared if the Wav cancels while the job is running
+		char *mFilename;
+		// Sound to load from a bank instead of mFilename, when mBank is set
+		SoundBank *mBank;
+		unsigned int mBankId;
+		int mPriority;
+		// Load settings of the target Wav, applied to the private one decoding
+		float mLoadSamplerate;
+		float mTrimThreshold;
+		bool mAnalyzeLoudness;
+		WavLoadJob *mNext;
+	};
+
+	static void deleteJob(WavLoadJob *aJob)
+	{
+		delete[] aJob->mFilename;
+		delete aJob;
+	}
+
+	// Decode aJob into a private Wav so the target is only touched once, under the lock
+	static result decodeJob(WavLoadJob *aJob, Wav &aDecoded)
+	{
+		aDecoded.setLoadSamplerate(aJob->mLoadSamplerate);
+		aDecoded.setTrimSilence(aJob->mTrimThreshold);
+		aDecoded.setAnalyzeLoudness(aJob->mAnalyzeLoudness);
+		if (aJob->mBank)
+			return aDecoded.loadBank(aJob->mBank, aJob->mBankId);
+		return aDecoded.load(aJob->mFilename);
+	}
+
+	void WavLoaderTask::work()
+	{
+		mLoader->work_internal();
+	}
+
+	WavLoader::WavLoader()
+	{
+		mPool = 0;
+		mTasks = 0;
+		mWake = Thread::createSemaphore();
+		mQuit.store(0, std::memory_order_relaxed);
+		mMutex = Thread::createMutex();
+		mQueue = 0;
+		mRunning = 0;
+		mPending = 0;
+	}
+
+	WavLoader::~WavLoader()
+	{
+		// Fail whatever is still queued; loads already running finish on their
+		// worker, after which the workers see mQuit and give their threads back
+		// to the pool so it can be shut down.
+		Thread::lockMutex(mMutex);
+		while (mQueue)
+		{
+			WavLoadJob *job = mQueue;
+			mQueue = job->mNext;
+			job->mWav->mLoadResult = UNKNOWN_ERROR;
+			job->mWav->mLoadPending.store(0, std::memory_order_release);
+			deleteJob(job);
+			mPending--;
+		}
+		mQuit.store(1, std::memory_order_release);
+		int threads = mPool ? mPool->mThreadCount : 0;
+		Thread::unlockMutex(mMutex);
+
+		int i;
+		for (i = 0; i < threads; i++)
+			Thread::signalSemaphore(mWake);
+		delete mPool;
+		delete[] mTasks;
+		Thread::destroySemaphore(mWake);
+		Thread::destroyMutex(mMutex);
+	}
+
+	result WavLoader::init(int aThreadCount)
+	{
+		Thread::lockMutex(mMutex);
+		result res = initPool_internal(aThreadCount);
+		Thread::unlockMutex(mMutex);
+		return res;
+	}
+
+	result WavLoader::initPool_internal(int aThreadCount)
+	{
+		if (mPool)
+			return INVALID_PARAMETER;
+		if (aThreadCount <= 0)
+		{
+			aThreadCount = (int)std::thread::hardware_concurrency();
+			if (aThreadCount <= 0)
+				aThreadCount = 1;
+		}
+		if (aThreadCount > MAX_THREADPOOL_TASKS)
+			aThreadCount = MAX_THREADPOOL_TASKS;
+		mPool = new Thread::Pool;
+		mPool->init(aThreadCount);
+		// One long-lived task per thread; loads are handed over through the queue,
+		// so the pool's task array never fills up
+		mTasks = new WavLoaderTask[aThreadCount];
+		int i;
+		for (i = 0; i < aThreadCount; i++)
+		{
+			mTasks[i].mLoader = this;
+			mPool->addWork(mTasks + i);
+		}
+		return SO_NO_ERROR;
+	}
+
+	result WavLoader::load(Wav *aWav, const char *aFilename, int aPriority)
+	{
+		if (!aWav || !aFilename)
+			return INVALID_PARAMETER;
+
+		WavLoadJob *job = new WavLoadJob;
+		int len = (int)strlen(aFilename);
+		job->mFilename = new char[len + 1];
+		memcpy(job->mFilename, aFilename, len + 1);
+		job->mBank = 0;
+		job->mBankId = 0;
+		return queue_internal(aWav, job, aPriority);
+	}
+
+	result WavLoader::loadBank(Wav *aWav, SoundBank *aBank, unsigned int aId, int aPriority)
+	{
+		if (!aWav || !aBank)
+			return INVALID_PARAMETER;
+
+		WavLoadJob *job = new WavLoadJob;
+		job->mFilename = 0;
+		job->mBank = aBank;
+		job->mBankId = aId;
+		return queue_internal(aWav, job, aPriority);
+	}
+
+	result WavLoader::queue_internal(Wav *aWav, WavLoadJob *aJob, int aPriority)
+	{
+		// A Wav only ever has one load in flight
+		aWav->cancelLoad_internal();
+		aWav->stop();
+
+		WavLoadJob *job = aJob;
+		job->mWav = aWav;
+		job->mPriority = aPriority;
+		job->mLoadSamplerate = aWav->mLoadSamplerate;
+		job->mTrimThreshold = aWav->mTrimThreshold;
+		job->mAnalyzeLoudness = aWav->mAnalyzeLoudness;
+
+		Thread::lockMutex(mMutex);
+		if (!mPool)
+			initPool_internal(0);
+		aWav->mLoader = this;
+		aWav->mLoadResult = SO_NO_ERROR;
+		aWav->mLoadPending.store(1, std::memory_order_release);
+		// Highest priority first, first come first served within a priority
+		WavLoadJob **p = &mQueue;
+		while (*p && (*p)->mPriority >= aPriority)
+			p = &(*p)->mNext;
+		job->mNext = *p;
+		*p = job;
+		mPending++;
+		Thread::unlockMutex(mMutex);
+
+		Thread::signalSemaphore(mWake);
+		return SO_NO_ERROR;
+	}
+
+	result WavLoader::loadBatch(Wav *aWavs, const char * const *aFilenames, unsigned int aCount, int aPriority)
+	{
+		if (!aWavs || !aFilenames)
+			return INVALID_PARAMETER;
+		unsigned int i;
+		for (i = 0; i < aCount; i++)
+		{
+			result res = load(aWavs + i, aFilenames[i], aPriority);
+			if (res != SO_NO_ERROR)
+				return res;
+		}
+		return SO_NO_ERROR;
+	}
+
+	void WavLoader::finish_internal(WavLoadJob *aJob, Wav &aResult, result aRes)
+	{
+		Thread::lockMutex(mMutex);
+		WavLoadJob **p = &mRunning;
+		while (*p != aJob)
+			p = &(*p)->mNext;
+		*p = aJob->mNext;
+		if (aJob->mWav)
+		{
+			aJob->mWav->adoptData_internal(aResult);
+			aJob->mWav->mLoadResult = aRes;
+			aJob->mWav->mLoadPending.store(0, std::memory_order_release);
+		}
+		mPending--;
+		Thread::unlockMutex(mMutex);
+		deleteJob(aJob);
+	}
+
+	bool WavLoader::runOne_internal()
+	{
+		Thread::lockMutex(mMutex);
+		WavLoadJob *job = mQueue;
+		if (job)
+		{
+			mQueue = job->mNext;
+			job->mNext = mRunning;
+			mRunning = job;
+		}
+		Thread::unlockMutex(mMutex);
+		if (!job)
+			return false;
+
+		Wav decoded;
+		result res = decodeJob(job, decoded);
+		finish_internal(job, decoded, res);
+		return true;
+	}
+
+	void WavLoader::work_internal()
+	{
+		while (!mQuit.load(std::memory_order_acquire))
+		{
+			// Every queued load posts the semaphore, so a wait only times out when
+			// the queue has been idle
+			if (!runOne_internal())
+				Thread::waitSemaphore(mWake, 1000);
+		}
+	}
+
+	bool WavLoader::runNow_internal(Wav *aWav)
+	{
+		Thread::lockMutex(mMutex);
+		WavLoadJob **p = &mQueue;
+		while (*p && (*p)->mWav != aWav)
+			p = &(*p)->mNext;
+		WavLoadJob *job = *p;
+		if (job)
+		{
+			*p = job->mNext;
+			job->mNext = mRunning;
+			mRunning = job;
+		}
+		Thread::unlockMutex(mMutex);
+		if (!job)
+			return false;
+
+		// The worker woken for this job will find a different job, or none
+		Wav decoded;
+		result res = decodeJob(job, decoded);
+		finish_internal(job, decoded, res);
+		return true;
+	}
+
+	void WavLoader::cancel_internal(Wav *aWav)
+	{
+		Thread::lockMutex(mMutex);
+		WavLoadJob **p = &mQueue;
+		while (*p && (*p)->mWav != aWav)
+			p = &(*p)->mNext;
+		if (*p)
+		{
+			WavLoadJob *job = *p;
+			*p = job->mNext;
+			deleteJob(job);
+			mPending--;
+		}
+		else
+		{
+			WavLoadJob *job = mRunning;
+			while (job && job->mWav != aWav)
+				job = job->mNext;
+			if (job)
+				job->mWav = 0;
+		}
+		aWav->mLoader = 0;
+		aWav->mLoadPending.store(0, std::memory_order_release);
+		Thread::unlockMutex(mMutex);
+	}
+
+	void WavLoader::waitAll()
+	{
+		// Help out instead of just waiting
+		while (runOne_internal())
+		{
+		}
+		while (getPendingCount())
+			Thread::sleep(1);
+	}
+
+	unsigned int WavLoader::getPendingCount()
+	{
+		Thread::lockMutex(mMutex);
+		unsigned int n = mPending;
+		Thread::unlockMutex(mMutex);
+		return n;
+	}
+
+	WavLoader *WavLoader::getDefault()
+	{
+		static WavLoader loader;
+		return &loader;
+	}
+};
@@ -25,12 +25,17 @@ freely, subject to the following restrictions:
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include "soloud.h"
+#include "soloud_internal.h"
 #include "dr_flac.h"
 #include "dr_mp3.h"
 #include "dr_wav.h"
 #include "soloud_wavstream.h"
 #include "soloud_file.h"
+#include "soloud_streamfile.h"
+#include "soloud_thread.h"
+#include "soloud_trace.h"
 #include "stb_vorbis.h"
 
 namespace SoLoud
@@ -80,13 +85,291 @@ namespace SoLoud
 		return 1;
 	}
 
-	WavStreamInstance::WavStreamInstance(WavStream *aParent)
+#define DECODE_AHEAD_CHUNK 1024
+// Loop wraps the decoder can be ahead of the reader by; loops shorter than the
+// ring wrap several times per fill
+#define DECODE_AHEAD_WRAPS 16
+
+	// Decode-ahead state of one instance. The decoder thread owns mStream and fills the
+	// ring; the audio thread only reads from it. Once the instance is gone the state is
+	// marked retired and the decoder thread frees it.
+	struct WavStreamAhead
+	{
+		WavStream *mParent;
+		// Instance doing the actual decoding
+		WavStreamInstance *mStream;
+		// Planar ring of mCapacity frames per channel; indices are free-running
+		float *mRing;
+		unsigned int mCapacity;
+		unsigned int mChannels;
+		unsigned int mAheadFrames;
+		std::atomic<unsigned int> mWrite;
+		std::atomic<unsigned int> mRead;
+		// Seek handshake: the audio thread bumps mSeekSerial, the decoder seeks, empties
+		// the ring and acknowledges. Nothing is read from the ring in between.
+		std::atomic<unsigned int> mSeekFrame;
+		std::atomic<unsigned int> mSeekSerial;
+		std::atomic<unsigned int> mAckSerial;
+		// Loop point set by the audio thread: -1 when not looping, -2 until first known
+		std::atomic<int> mLoopFrame;
+		// Loop wraps the reader hasn't stepped over yet, oldest first: the decoder wrapped
+		// to mWrapFrame[i] at ring position mWrapAt[i], and data past it is already from the
+		// loop point. The decoder pushes at mWrapHead, the audio thread pops at mWrapTail;
+		// both are free-running.
+		unsigned int mWrapAt[DECODE_AHEAD_WRAPS];
+		unsigned int mWrapFrame[DECODE_AHEAD_WRAPS];
+		std::atomic<unsigned int> mWrapHead;
+		std::atomic<unsigned int> mWrapTail;
+		// Everything up to the end of the stream is in the ring
+		std::atomic<bool> mEnded;
+		std::atomic<bool> mRetired;
+		// Audio thread statistics
+		unsigned int mUnderruns;
+		unsigned int mUnderrunSamples;
+		WavStreamAhead *mNext;
+
+		// Decode one chunk if there's room. Returns true if anything was done.
+		bool fill(float *aTemp);
+	};
+
+	bool WavStreamAhead::fill(float *aTemp)
+	{
+		unsigned int serial = mSeekSerial.load(std::memory_order_acquire);
+		if (serial != mAckSerial.load(std::memory_order_relaxed))
+		{
+			mStream->seekFrame_internal(mSeekFrame.load(std::memory_order_relaxed));
+			mWrapHead.store(mWrapTail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			mEnded.store(false, std::memory_order_relaxed);
+			mWrite.store(mRead.load(std::memory_order_acquire), std::memory_order_relaxed);
+			mAckSerial.store(serial, std::memory_order_release);
+			return true;
+		}
+		if (mEnded.load(std::memory_order_relaxed))
+			return false;
+
+		unsigned int write = mWrite.load(std::memory_order_relaxed);
+		unsigned int buffered = write - mRead.load(std::memory_order_acquire);
+		if (buffered + DECODE_AHEAD_CHUNK > mAheadFrames)
+			return false;
+
+		bool worked = false;
+		bool wrapped = false;
+		unsigned int done = 0;
+		while (done < DECODE_AHEAD_CHUNK)
+		{
+			unsigned int want = DECODE_AHEAD_CHUNK - done;
+			unsigned int got = 0;
+			if (!mStream->hasEnded())
+				got = mStream->getAudio(aTemp, want, want);
+
+			unsigned int pos = write & (mCapacity - 1);
+			unsigned int first = mCapacity - pos;
+			if (first > got)
+				first = got;
+			unsigned int i;
+			for (i = 0; i < mChannels; i++)
+			{
+				memcpy(mRing + i * mCapacity + pos, aTemp + i * want, sizeof(float) * first);
+				memcpy(mRing + i * mCapacity, aTemp + i * want + first, sizeof(float) * (got - first));
+			}
+			write += got;
+			done += got;
+			mWrite.store(write, std::memory_order_release);
+			if (got)
+				worked = true;
+			if (got == want)
+				break;
+
+			// End of stream. Carry on from the loop point if looping, so the
+			// audio thread doesn't have to wait for the seek when it wraps.
+			int loop = mLoopFrame.load(std::memory_order_relaxed);
+			if (loop == -1)
+			{
+				mEnded.store(true, std::memory_order_release);
+				break;
+			}
+			unsigned int head = mWrapHead.load(std::memory_order_relaxed);
+			// Loop point unknown yet, the reader is all the wraps behind, or the loop is empty
+			if (loop < 0 || head - mWrapTail.load(std::memory_order_acquire) == DECODE_AHEAD_WRAPS || (wrapped && got == 0))
+				break;
+			mWrapAt[head % DECODE_AHEAD_WRAPS] = write;
+			mWrapFrame[head % DECODE_AHEAD_WRAPS] = loop;
+			mWrapHead.store(head + 1, std::memory_order_release);
+			mStream->seekFrame_internal(loop);
+			wrapped = true;
+			worked = true;
+		}
+		return worked;
+	}
+
+	// The shared decoder thread and the states it serves
+	struct DecodeAheadThread
+	{
+		void *mMutex;
+		Thread::ThreadHandle mThread;
+		bool mRunning;
+		WavStreamAhead *mList;
+
+		DecodeAheadThread()
+		{
+			mMutex = Thread::createMutex();
+			mThread = 0;
+			mRunning = false;
+			mList = 0;
+		}
+	};
+
+	static DecodeAheadThread &decodeAheadThread()
+	{
+		static DecodeAheadThread thread;
+		return thread;
+	}
+
+	static void deleteAhead(WavStreamAhead *aAhead)
+	{
+		WavStream *parent = aAhead->mParent;
+		delete aAhead->mStream;
+		delete[] aAhead->mRing;
+		delete aAhead;
+		parent->mAheadInstances.fetch_sub(1, std::memory_order_release);
+	}
+
+	static void decodeAheadThreadFunc(void *aParam)
+	{
+		DecodeAheadThread *t = (DecodeAheadThread *)aParam;
+		float *temp = new float[DECODE_AHEAD_CHUNK * MAX_CHANNELS];
+		int idle = 0;
+		Trace::setThreadName("stream decode-ahead");
+		for (;;)
+		{
+			// Only this thread unlinks states, and new ones go in at the head, so the list
+			// from the head taken here on stays walkable without the lock. Registering and
+			// retiring never wait for decoding.
+			WavStreamAhead *retired = 0;
+			Thread::lockMutex(t->mMutex);
+			WavStreamAhead **link = &t->mList;
+			while (*link)
+			{
+				WavStreamAhead *s = *link;
+				if (s->mRetired.load(std::memory_order_acquire))
+				{
+					*link = s->mNext;
+					s->mNext = retired;
+					retired = s;
+					continue;
+				}
+				link = &s->mNext;
+			}
+			WavStreamAhead *list = t->mList;
+			// Linger for a while before quitting, so short sounds don't restart the thread
+			idle = list ? 0 : idle + 1;
+			if (idle > 500)
+				t->mRunning = false;
+			Thread::unlockMutex(t->mMutex);
+
+			while (retired)
+			{
+				WavStreamAhead *next = retired->mNext;
+				deleteAhead(retired);
+				retired = next;
+			}
+			if (idle > 500)
+				break;
+
+			bool worked = false;
+			WavStreamAhead *s;
+			for (s = list; s; s = s->mNext)
+			{
+				unsigned long long tracestart = Trace::begin();
+				if (s->fill(temp))
+				{
+					worked = true;
+					Trace::end("decode ahead", tracestart);
+				}
+			}
+			if (!worked)
+				Thread::sleep(2);
+		}
+		delete[] temp;
+	}
+
+	static void registerAhead(WavStreamAhead *aAhead)
+	{
+		DecodeAheadThread &t = decodeAheadThread();
+		Thread::lockMutex(t.mMutex);
+		aAhead->mNext = t.mList;
+		t.mList = aAhead;
+		if (!t.mRunning)
+		{
+			if (t.mThread)
+			{
+				Thread::wait(t.mThread);
+				Thread::release(t.mThread);
+			}
+			t.mRunning = true;
+			t.mThread = Thread::createThread(decodeAheadThreadFunc, &t);
+		}
+		Thread::unlockMutex(t.mMutex);
+	}
+
+	WavStreamInstance::WavStreamInstance(WavStream *aParent, bool aAllowDecodeAhead)
 	{
 		mParent = aParent;
 		mOffset = 0;
+		mSeekPending = false;
+		mAhead = 0;
 		mCodec.mOgg = 0;
 		mCodec.mFlac = 0;
 		mFile = 0;
+		mReadAheadFile = false;
+		if (aAllowDecodeAhead && aParent->mDecodeAheadMs)
+		{
+			// Decoding happens in a private instance owned by the decoder thread
+			WavStreamInstance *stream = new WavStreamInstance(aParent, false);
+			if (stream->mFile == NULL)
+			{
+				delete stream;
+				return;
+			}
+			stream->init(*aParent, 0);
+
+			WavStreamAhead *s = new WavStreamAhead;
+			s->mParent = aParent;
+			s->mStream = stream;
+			s->mChannels = aParent->mChannels;
+			s->mAheadFrames = (unsigned int)(aParent->mBaseSamplerate * aParent->mDecodeAheadMs / 1000) + DECODE_AHEAD_CHUNK;
+			s->mCapacity = DECODE_AHEAD_CHUNK;
+			while (s->mCapacity < s->mAheadFrames)
+				s->mCapacity *= 2;
+			s->mRing = new float[s->mCapacity * s->mChannels];
+			s->mWrite.store(0);
+			s->mRead.store(0);
+			s->mSeekFrame.store(0);
+			s->mSeekSerial.store(0);
+			s->mAckSerial.store(0);
+			// Known up front for sources set to loop, so the initial fill already wraps
+			s->mLoopFrame.store((aParent->mFlags & AudioSource::SHOULD_LOOP) ? (int)floor(aParent->mLoopPoint * aParent->mBaseSamplerate) : -2);
+			s->mWrapHead.store(0);
+			s->mWrapTail.store(0);
+			s->mEnded.store(false);
+			s->mRetired.store(false);
+			s->mUnderruns = 0;
+			s->mUnderrunSamples = 0;
+			s->mNext = 0;
+
+			// Fill the ring up front so playback doesn't start with an underrun;
+			// instances are created outside the audio thread.
+			float *temp = new float[DECODE_AHEAD_CHUNK * MAX_CHANNELS];
+			while (s->fill(temp))
+			{
+			}
+			delete[] temp;
+
+			aParent->mAheadInstances.fetch_add(1, std::memory_order_relaxed);
+			mAhead = s;
+			registerAhead(s);
+			return;
+		}
 		if (aParent->mMemFile)
 		{
 			MemoryFile *mf = new MemoryFile();
@@ -96,9 +379,23 @@ namespace SoLoud
 		else
 		if (aParent->mFilename)
 		{
-			DiskFile *df = new DiskFile;
-			mFile = df;
-			df->open(aParent->mFilename);
+			if (aParent->mReadAhead)
+			{
+				StreamFile *sf = new StreamFile;
+				if (sf->open(aParent->mFilename) == SO_NO_ERROR)
+				{
+					mFile = sf;
+					mReadAheadFile = true;
+				}
+				else
+					delete sf;
+			}
+			if (!mFile)
+			{
+				DiskFile *df = new DiskFile;
+				mFile = df;
+				df->open(aParent->mFilename);
+			}
 		}
 		else
 		if (aParent->mStreamFile)
@@ -113,10 +410,18 @@ namespace SoLoud
 		
 		if (mFile)
 		{
+			// In-memory (and mapped) sources are decoded straight from memory
+			// rather than through the File read callbacks.
+			const unsigned char *mem = aParent->mMemFile ? mFile->getMemPtr() : 0;
+			size_t memlen = mem ? mFile->length() : 0;
+
 			if (mParent->mFiletype == WAVSTREAM_WAV)
 			{
 				mCodec.mWav = new drwav;
-				if (!drwav_init(mCodec.mWav, drwav_read_func, drwav_seek_func, (void*)mFile, NULL))
+				drwav_bool32 ok = mem ?
+					drwav_init_memory(mCodec.mWav, mem, memlen, NULL) :
+					drwav_init(mCodec.mWav, drwav_read_func, drwav_seek_func, (void*)mFile, NULL);
+				if (!ok)
 				{
 					delete mCodec.mWav;
 					mCodec.mWav = 0;
@@ -130,7 +435,10 @@ namespace SoLoud
 			{
 				int e;
 
-				mCodec.mOgg = stb_vorbis_open_file((Soloud_Filehack *)mFile, 0, &e, 0);
+				if (mem)
+					mCodec.mOgg = stb_vorbis_open_memory(mem, (int)memlen, &e, 0);
+				else
+					mCodec.mOgg = stb_vorbis_open_file((Soloud_Filehack *)mFile, 0, &e, 0);
 
 				if (!mCodec.mOgg)
 				{
@@ -145,7 +453,9 @@ namespace SoLoud
 			else
 			if (mParent->mFiletype == WAVSTREAM_FLAC)
 			{
-				mCodec.mFlac = drflac_open(drflac_read_func, drflac_seek_func, (void*)mFile, NULL);
+				mCodec.mFlac = mem ?
+					drflac_open_memory(mem, memlen, NULL) :
+					drflac_open(drflac_read_func, drflac_seek_func, (void*)mFile, NULL);
 				if (!mCodec.mFlac)
 				{
 					if (mFile != mParent->mStreamFile)
@@ -157,7 +467,10 @@ namespace SoLoud
 			if (mParent->mFiletype == WAVSTREAM_MP3)
 			{
 				mCodec.mMp3 = new drmp3;
-				if (!drmp3_init(mCodec.mMp3, drmp3_read_func, drmp3_seek_func, (void*)mFile, NULL, NULL))
+				drmp3_bool32 ok = mem ?
+					drmp3_init_memory(mCodec.mMp3, mem, memlen, NULL, NULL) :
+					drmp3_init(mCodec.mMp3, drmp3_read_func, drmp3_seek_func, (void*)mFile, NULL, NULL);
+				if (!ok)
 				{
 					delete mCodec.mMp3;
 					mCodec.mMp3 = 0;
@@ -165,6 +478,11 @@ namespace SoLoud
 						delete mFile;
 					mFile = 0;
 				}
+				else
+				if (mParent->mMp3SeekPoints)
+				{
+					drmp3_bind_seek_table(mCodec.mMp3, mParent->mMp3SeekPointCount, (drmp3_seek_point *)mParent->mMp3SeekPoints);
+				}
 			}
 			else
 			{
@@ -178,6 +496,11 @@ namespace SoLoud
 
 	WavStreamInstance::~WavStreamInstance()
 	{
+		if (mAhead)
+		{
+			// The decoder thread may be in the middle of filling; let it clean up
+			mAhead->mRetired.store(true, std::memory_order_release);
+		}
 		switch (mParent->mFiletype)
 		{
 		case WAVSTREAM_OGG:
@@ -238,28 +561,35 @@ namespace SoLoud
 
 	unsigned int WavStreamInstance::getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
 	{			
+		if (mAhead)
+			return readAhead_internal(aBuffer, aSamplesToRead, aBufferSize);
+
+		unsigned long long tracestart = Trace::begin();
+		unsigned int got = decode_internal(aBuffer, aSamplesToRead, aBufferSize);
+		Trace::end("stream decode", tracestart, mAudioSourceID);
+		return got;
+	}
+
+	unsigned int WavStreamInstance::decode_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
+	{
 		unsigned int offset = 0;
 		if (mFile == NULL)
 			return 0;
+		if (mSeekPending && seekFrame_internal(mOffset) != SO_NO_ERROR)
+			return 0;
 		switch (mParent->mFiletype)
 		{
 		case WAVSTREAM_FLAC:
 			{
-				unsigned int i, j, k;
+				unsigned int i;
 
 				for (i = 0; i < aSamplesToRead; i += 512)
 				{
 					float tmp[512 * MAX_CHANNELS];
 					unsigned int blockSize = (aSamplesToRead - i) > 512 ? 512 : aSamplesToRead - i;
-					offset += (unsigned int)drflac_read_pcm_frames_f32(mCodec.mFlac, blockSize, tmp);
-
-					for (j = 0; j < blockSize; j++)
-					{
-						for (k = 0; k < mChannels; k++)
-						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mFlac->channels + k];
-						}
-					}
+					unsigned int got = (unsigned int)drflac_read_pcm_frames_f32(mCodec.mFlac, blockSize, tmp);
+					deinterlace_frames_float(tmp, aBuffer + i, got, mCodec.mFlac->channels, mChannels, aBufferSize);
+					offset += got;
 				}
 				mOffset += offset;
 				return offset;
@@ -267,21 +597,15 @@ namespace SoLoud
 			break;
 		case WAVSTREAM_MP3:
 			{
-				unsigned int i, j, k;
+				unsigned int i;
 
 				for (i = 0; i < aSamplesToRead; i += 512)
 				{
 					float tmp[512 * MAX_CHANNELS];
 					unsigned int blockSize = (aSamplesToRead - i) > 512 ? 512 : aSamplesToRead - i;
-					offset += (unsigned int)drmp3_read_pcm_frames_f32(mCodec.mMp3, blockSize, tmp);
-
-					for (j = 0; j < blockSize; j++)
-					{
-						for (k = 0; k < mChannels; k++)
-						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mMp3->channels + k];
-						}
-					}
+					unsigned int got = (unsigned int)drmp3_read_pcm_frames_f32(mCodec.mMp3, blockSize, tmp);
+					deinterlace_frames_float(tmp, aBuffer + i, got, mCodec.mMp3->channels, mChannels, aBufferSize);
+					offset += got;
 				}
 				mOffset += offset;
 				return offset;
@@ -316,21 +640,15 @@ namespace SoLoud
 			break;
 		case WAVSTREAM_WAV:
 			{
-				unsigned int i, j, k;
+				unsigned int i;
 
 				for (i = 0; i < aSamplesToRead; i += 512)
 				{
 					float tmp[512 * MAX_CHANNELS];
 					unsigned int blockSize = (aSamplesToRead - i) > 512 ? 512 : aSamplesToRead - i;
-					offset += (unsigned int)drwav_read_pcm_frames_f32(mCodec.mWav, blockSize, tmp);
-
-					for (j = 0; j < blockSize; j++)
-					{
-						for (k = 0; k < mChannels; k++)
-						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mWav->channels + k];
-						}
-					}
+					unsigned int got = (unsigned int)drwav_read_pcm_frames_f32(mCodec.mWav, blockSize, tmp);
+					deinterlace_frames_float(tmp, aBuffer + i, got, mCodec.mWav->channels, mChannels, aBufferSize);
+					offset += got;
 				}
 				mOffset += offset;
 				return offset;
@@ -342,6 +660,12 @@ namespace SoLoud
 
 	result WavStreamInstance::rewind()
 	{
+		if (mAhead)
+		{
+			mStreamPosition = 0.0f;
+			return seekAhead_internal(0);
+		}
+
 		switch (mParent->mFiletype)
 		{
 		case WAVSTREAM_OGG:
@@ -349,6 +673,9 @@ namespace SoLoud
 			{
 				stb_vorbis_seek_start(mCodec.mOgg);
 			}
+			// Drop whatever was left of the current frame
+			mOggFrameSize = 0;
+			mOggFrameOffset = 0;
 			break;
 		case WAVSTREAM_FLAC:
 			if (mCodec.mFlac)
@@ -371,6 +698,220 @@ namespace SoLoud
 		}
 		mOffset = 0;
 		mStreamPosition = 0.0f;
+		mSeekPending = false;
+		return 0;
+	}
+
+	result WavStreamInstance::seek(double aSeconds, float * /*aScratch*/, unsigned int /*aScratchSize*/)
+	{
+		double frame = floor(aSeconds * mBaseSamplerate);
+		if (frame < 0)
+			frame = 0;
+		if (frame > mParent->mSampleCount)
+			frame = mParent->mSampleCount;
+		unsigned int pos = (unsigned int)frame;
+
+		result res = mAhead ? seekAhead_internal(pos) : seekFrame_internal(pos);
+		if (res == SO_NO_ERROR)
+			mStreamPosition = pos / mBaseSamplerate;
+		return res;
+	}
+
+	unsigned int WavStreamInstance::advance(unsigned int aSamples, float * /*aScratch*/, unsigned int /*aScratchSize*/)
+	{
+		if (mAhead)
+			return readAhead_internal(NULL, aSamples, 0);
+
+		if (mFile == NULL || mOffset >= mParent->mSampleCount)
+			return 0;
+
+		unsigned int dataleft = mParent->mSampleCount - mOffset;
+		if (aSamples > dataleft)
+			aSamples = dataleft;
+		if (aSamples)
+		{
+			mOffset += aSamples;
+			mSeekPending = true;
+		}
+		return aSamples;
+	}
+
+	unsigned int WavStreamInstance::tellFrame()
+	{
+		// The decode-ahead ring can't go back; those streams decode while inaudible
+		return mAhead ? NO_FRAME : mOffset;
+	}
+
+	result WavStreamInstance::seekFrame(unsigned int aFrame)
+	{
+		if (mAhead || aFrame > mParent->mSampleCount)
+			return INVALID_PARAMETER;
+		// Like advance(), leave the decoder to catch up on the next read
+		if (aFrame != mOffset)
+		{
+			mOffset = aFrame;
+			mSeekPending = true;
+		}
+		return SO_NO_ERROR;
+	}
+
+	result WavStreamInstance::seekFrame_internal(unsigned int aFrame)
+	{
+		mSeekPending = false;
+		if (mCodec.mOgg == NULL)
+			return UNKNOWN_ERROR;
+
+		unsigned int pos = aFrame;
+		if (pos == 0)
+			return rewind();
+
+		// Let the decoders jump to the frame instead of decoding everything up to it
+		switch (mParent->mFiletype)
+		{
+		case WAVSTREAM_OGG:
+			{
+				// Seek to the vorbis frame holding the sample, decode it and start
+				// reading from the sample within it.
+				if (!stb_vorbis_seek_frame(mCodec.mOgg, pos))
+					return UNKNOWN_ERROR;
+				int framestart = stb_vorbis_get_sample_offset(mCodec.mOgg);
+				mOggFrameSize = stb_vorbis_get_frame_float(mCodec.mOgg, NULL, &mOggOutputs);
+				mOggFrameOffset = 0;
+				if (framestart >= 0 && pos > (unsigned int)framestart)
+					mOggFrameOffset = pos - framestart;
+				if (mOggFrameOffset > mOggFrameSize)
+					mOggFrameOffset = mOggFrameSize;
+			}
+			break;
+		case WAVSTREAM_FLAC:
+			if (!drflac_seek_to_pcm_frame(mCodec.mFlac, pos))
+				return UNKNOWN_ERROR;
+			break;
+		case WAVSTREAM_MP3:
+			if (!drmp3_seek_to_pcm_frame(mCodec.mMp3, pos))
+				return UNKNOWN_ERROR;
+			break;
+		case WAVSTREAM_WAV:
+			if (!drwav_seek_to_pcm_frame(mCodec.mWav, pos))
+				return UNKNOWN_ERROR;
+			break;
+		}
+		mOffset = pos;
+		return SO_NO_ERROR;
+	}
+
+	unsigned int WavStreamInstance::readAhead_internal(float *aBuffer, unsigned int aSamples, unsigned int aBufferSize)
+	{
+		WavStreamAhead *s = mAhead;
+		s->mLoopFrame.store((mFlags & LOOPING) ? (int)floor(mLoopPoint * mBaseSamplerate) : -1, std::memory_order_relaxed);
+
+		unsigned int read = s->mRead.load(std::memory_order_relaxed);
+		unsigned int avail = 0;
+		bool ended = false;
+		bool seam = false;
+		if (s->mAckSerial.load(std::memory_order_acquire) == s->mSeekSerial.load(std::memory_order_relaxed))
+		{
+			// mEnded is set after the last write, so check it first
+			ended = s->mEnded.load(std::memory_order_acquire);
+			avail = s->mWrite.load(std::memory_order_acquire) - read;
+			// Stop at the loop seam; the mixer seeks to the loop point before reading on
+			unsigned int tail = s->mWrapTail.load(std::memory_order_relaxed);
+			if (tail != s->mWrapHead.load(std::memory_order_acquire) && s->mWrapAt[tail % DECODE_AHEAD_WRAPS] - read <= avail)
+			{
+				avail = s->mWrapAt[tail % DECODE_AHEAD_WRAPS] - read;
+				seam = true;
+			}
+		}
+
+		unsigned int samples = aSamples < avail ? aSamples : avail;
+		if (aBuffer)
+		{
+			unsigned int pos = read & (s->mCapacity - 1);
+			unsigned int first = s->mCapacity - pos;
+			if (first > samples)
+				first = samples;
+			unsigned int i;
+			for (i = 0; i < mChannels; i++)
+			{
+				memcpy(aBuffer + i * aBufferSize, s->mRing + i * s->mCapacity + pos, sizeof(float) * first);
+				memcpy(aBuffer + i * aBufferSize + first, s->mRing + i * s->mCapacity, sizeof(float) * (samples - first));
+			}
+		}
+		s->mRead.store(read + samples, std::memory_order_release);
+		mOffset += samples;
+
+		// Short reads only happen at the end of the stream or at the loop seam
+		if (samples == aSamples || seam || ended)
+			return samples;
+		if (s->mEnded.load(std::memory_order_acquire) && s->mWrite.load(std::memory_order_relaxed) == read + samples)
+			return samples;
+
+		unsigned int missing = aSamples - samples;
+		if (aBuffer == NULL)
+		{
+			// Skipping inaudible audio; have the decoder jump past the rest
+			unsigned int target = mOffset + missing;
+			if (target > mParent->mSampleCount)
+				target = mParent->mSampleCount;
+			unsigned int skipped = target - mOffset;
+			seekAhead_internal(target);
+			return samples + skipped;
+		}
+
+		// Underrun: the decoder fell behind. Play silence rather than wait for it.
+		unsigned int i;
+		for (i = 0; i < mChannels; i++)
+			memset(aBuffer + i * aBufferSize + samples, 0, sizeof(float) * missing);
+		s->mUnderruns++;
+		s->mUnderrunSamples += missing;
+		mParent->mUnderruns.fetch_add(1, std::memory_order_relaxed);
+		mParent->mUnderrunSamples.fetch_add(missing, std::memory_order_relaxed);
+		return aSamples;
+	}
+
+	result WavStreamInstance::seekAhead_internal(unsigned int aFrame)
+	{
+		WavStreamAhead *s = mAhead;
+		unsigned int serial = s->mSeekSerial.load(std::memory_order_relaxed);
+		unsigned int tail = s->mWrapTail.load(std::memory_order_relaxed);
+		if (s->mAckSerial.load(std::memory_order_acquire) == serial &&
+			tail != s->mWrapHead.load(std::memory_order_acquire) &&
+			s->mWrapAt[tail % DECODE_AHEAD_WRAPS] == s->mRead.load(std::memory_order_relaxed) &&
+			s->mWrapFrame[tail % DECODE_AHEAD_WRAPS] == aFrame)
+		{
+			// Looping to where the decoder already wrapped to; just step over the seam
+			s->mWrapTail.store(tail + 1, std::memory_order_release);
+		}
+		else
+		{
+			s->mSeekFrame.store(aFrame, std::memory_order_relaxed);
+			s->mSeekSerial.store(serial + 1, std::memory_order_release);
+		}
+		mOffset = aFrame;
+		return SO_NO_ERROR;
+	}
+
+	float WavStreamInstance::getInfo(unsigned int aInfoKey)
+	{
+		if (aInfoKey == INFO_READ_STALLS)
+		{
+			if (mAhead)
+				return mAhead->mStream->getInfo(aInfoKey);
+			return (mReadAheadFile && mFile) ? (float)((StreamFile *)mFile)->getStallCount() : 0;
+		}
+		if (mAhead == NULL)
+			return 0;
+		switch (aInfoKey)
+		{
+		case INFO_UNDERRUNS:
+			return (float)mAhead->mUnderruns;
+		case INFO_UNDERRUN_SAMPLES:
+			return (float)mAhead->mUnderrunSamples;
+		case INFO_BUFFERED_SAMPLES:
+			if (mAhead->mAckSerial.load(std::memory_order_acquire) != mAhead->mSeekSerial.load(std::memory_order_relaxed))
+				return 0;
+			return (float)(mAhead->mWrite.load(std::memory_order_acquire) - mAhead->mRead.load(std::memory_order_relaxed));
+		}
 		return 0;
 	}
 
@@ -390,15 +931,41 @@ namespace SoLoud
 		mFiletype = WAVSTREAM_WAV;
 		mMemFile = 0;
 		mStreamFile = 0;
+		mMp3SeekPoints = 0;
+		mMp3SeekPointCount = 0;
+		mDecodeAheadMs = 0;
+		mReadAhead = false;
+		mAheadInstances.store(0);
+		mUnderruns.store(0);
+		mUnderrunSamples.store(0);
 	}
 	
 	WavStream::~WavStream()
+	{
+		clear_internal();
+	}
+
+	void WavStream::clear_internal()
 	{
 		stop();
+		// Decode-ahead instances still read our file and seek table until the decoder
+		// thread lets go of them
+		while (mAheadInstances.load(std::memory_order_acquire) > 0)
+			Thread::sleep(1);
 		delete[] mFilename;
 		delete mMemFile;
+		delete[] (drmp3_seek_point *)mMp3SeekPoints;
+		mFilename = 0;
+		mMemFile = 0;
+		mStreamFile = 0;
+		mMp3SeekPoints = 0;
+		mMp3SeekPointCount = 0;
+		mSampleCount = 0;
 	}
 	
+// Source frames between mp3 seek points; a seek decodes at most this much
+#define MP3_SEEK_POINT_SPACING 16384
+
 #define MAKEDWORD(a,b,c,d) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a))
 
 	result WavStream::loadwav(File * fp)
@@ -488,6 +1055,19 @@ namespace SoLoud
 		mBaseSamplerate = (float)decoder.sampleRate;
 		mSampleCount = (unsigned int)samples;
 		mFiletype = WAVSTREAM_MP3;
+
+		// Without a seek table dr_mp3 seeks by decoding from the start
+		drmp3_uint32 seekpoints = (drmp3_uint32)(samples / MP3_SEEK_POINT_SPACING) + 1;
+		drmp3_seek_point *table = new drmp3_seek_point[seekpoints];
+		if (drmp3_calculate_seek_points(&decoder, &seekpoints, table))
+		{
+			mMp3SeekPoints = table;
+			mMp3SeekPointCount = seekpoints;
+		}
+		else
+		{
+			delete[] table;
+		}
 		drmp3_uninit(&decoder);
 
 		return SO_NO_ERROR;
@@ -495,11 +1075,7 @@ namespace SoLoud
 
 	result WavStream::load(const char *aFilename)
 	{
-		delete[] mFilename;
-		delete mMemFile;
-		mMemFile = 0;
-		mFilename = 0;
-		mSampleCount = 0;
+		clear_internal();
 		DiskFile fp;
 		int res = fp.open(aFilename);
 		if (res != SO_NO_ERROR)
@@ -524,12 +1100,7 @@ namespace SoLoud
 
 	result WavStream::loadMem(const unsigned char *aData, unsigned int aDataLen, bool aCopy, bool aTakeOwnership)
 	{
-		delete[] mFilename;
-		delete mMemFile;
-		mStreamFile = 0;
-		mMemFile = 0;
-		mFilename = 0;
-		mSampleCount = 0;
+		clear_internal();
 
 		if (aData == NULL || aDataLen == 0)
 			return INVALID_PARAMETER;
@@ -557,8 +1128,28 @@ namespace SoLoud
 
 	result WavStream::loadToMem(const char *aFilename)
 	{
+		// A mapping is already "in memory" as far as the instances are concerned,
+		// and pages in on demand instead of being copied up front.
+		MappedFile *mf = new MappedFile;
+		int res = mf->open(aFilename);
+		if (res == SO_NO_ERROR)
+		{
+			clear_internal();
+			res = parse(mf);
+			if (res != SO_NO_ERROR)
+			{
+				delete mf;
+				return res;
+			}
+			mMemFile = mf;
+			return SO_NO_ERROR;
+		}
+		delete mf;
+		if (res == FILE_NOT_FOUND)
+			return res;
+
 		DiskFile df;
-		int res = df.open(aFilename);
+		res = df.open(aFilename);
 		if (res == SO_NO_ERROR)
 		{
 			res = loadFileToMem(&df);
@@ -568,12 +1159,7 @@ namespace SoLoud
 
 	result WavStream::loadFile(File *aFile)
 	{
-		delete[] mFilename;
-		delete mMemFile;
-		mStreamFile = 0;
-		mMemFile = 0;
-		mFilename = 0;
-		mSampleCount = 0;
+		clear_internal();
 
 		int res = parse(aFile);
 
@@ -589,12 +1175,7 @@ namespace SoLoud
 
 	result WavStream::loadFileToMem(File *aFile)
 	{
-		delete[] mFilename;
-		delete mMemFile;
-		mStreamFile = 0;
-		mMemFile = 0;
-		mFilename = 0;
-		mSampleCount = 0;
+		clear_internal();
 
 		MemoryFile *mf = new MemoryFile();
 		int res = mf->openFileToMem(aFile);
@@ -648,6 +1229,28 @@ namespace SoLoud
 		return res;
 	}
 
+	result WavStream::setDecodeAhead(unsigned int aMilliseconds)
+	{
+		mDecodeAheadMs = aMilliseconds;
+		return SO_NO_ERROR;
+	}
+
+	result WavStream::setReadAhead(bool aEnable)
+	{
+		mReadAhead = aEnable;
+		return SO_NO_ERROR;
+	}
+
+	unsigned int WavStream::getUnderrunCount()
+	{
+		return mUnderruns.load(std::memory_order_relaxed);
+	}
+
+	unsigned int WavStream::getUnderrunSamples()
+	{
+		return mUnderrunSamples.load(std::memory_order_relaxed);
+	}
+
 	AudioSourceInstance *WavStream::createInstance()
 	{
 		return new WavStreamInstance(this);
@@ -29,6 +29,10 @@ freely, subject to the following restrictions:
 #include "soloud_internal.h"
 #include "soloud_thread.h"
 #include "soloud_fft.h"
+#include "soloud_profiler.h"
+#include "soloud_trace.h"
+#include "soloud_audit.h"
+#include "soloud_renderahead.h"
 
 
 #ifdef SOLOUD_SSE_INTRINSICS
@@ -38,6 +42,12 @@ freely, subject to the following restrictions:
 #endif
 #endif
 
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define SOLOUD_MLOCK
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
 //#define FLOATING_POINT_DEBUG
 
 
@@ -53,6 +63,51 @@ freely, subject to the following restrictions:
 
 namespace SoLoud
 {
+	// The instance and parameters the calling thread was last hardened for; see hardenThread_internal
+	static thread_local const Soloud *tRealtimeOwner = 0;
+	static thread_local unsigned int tRealtimeGeneration = 0;
+
+#ifdef SOLOUD_MLOCK
+	// mlockall/munlockall act on the whole process, so the lock is shared between
+	// instances and only dropped when the last one holding it deinits
+	static unsigned int gLockAllCount = 0;
+
+	static void *lockAllMutex()
+	{
+		static void *mutex = Thread::createMutex();
+		return mutex;
+	}
+#endif
+
+	// Lock or unlock an arena's pages; returns false if the platform or limits don't allow it
+	static bool lockArena(AlignedFloatBuffer *aArena, bool aLock)
+	{
+#ifdef SOLOUD_MLOCK
+		if (!aArena || !aArena->mData)
+			return false;
+		size_t bytes = aArena->mFloats * sizeof(float);
+		return (aLock ? mlock(aArena->mData, bytes) : munlock(aArena->mData, bytes)) == 0;
+#else
+		(void)aArena;
+		(void)aLock;
+		return false;
+#endif
+	}
+
+	// Stand-in voice for warmUp_internal; panAndExpand only reads its volumes and channels
+	class WarmUpInstance : public AudioSourceInstance
+	{
+	public:
+		virtual unsigned int getAudio(float * /*aBuffer*/, unsigned int /*aSamplesToRead*/, unsigned int /*aBufferSize*/)
+		{
+			return 0;
+		}
+		virtual bool hasEnded()
+		{
+			return true;
+		}
+	};
+
 	AlignedFloatBuffer::AlignedFloatBuffer()
 	{
 		mBasePtr = 0;
@@ -60,26 +115,37 @@ namespace SoLoud
 		mFloats = 0;
 	}
 
-	result AlignedFloatBuffer::init(unsigned int aFloats)
+	result AlignedFloatBuffer::init(unsigned int aFloats, unsigned int aAlignment)
 	{
 		delete[] mBasePtr;
 		mBasePtr = 0;
 		mData = 0;
 		mFloats = aFloats;
 #ifndef SOLOUD_SSE_INTRINSICS
-		mBasePtr = new unsigned char[aFloats * sizeof(float)];
-		if (mBasePtr == NULL)
-			return OUT_OF_MEMORY;
-		mData = (float*)mBasePtr;
-#else
-		mBasePtr = new unsigned char[aFloats * sizeof(float) + 16];
+		if (aAlignment <= sizeof(float))
+		{
+			mBasePtr = new unsigned char[aFloats * sizeof(float)];
+			if (mBasePtr == NULL)
+				return OUT_OF_MEMORY;
+			mData = (float*)mBasePtr;
+			return SO_NO_ERROR;
+		}
+#endif
+		mBasePtr = new unsigned char[aFloats * sizeof(float) + aAlignment];
 		if (mBasePtr == NULL)
 			return OUT_OF_MEMORY;
-		mData = (float *)(((size_t)mBasePtr + 15)&~15);
-#endif
+		mData = (float *)(((size_t)mBasePtr + aAlignment - 1) & ~(size_t)(aAlignment - 1));
 		return SO_NO_ERROR;
 	}
 
+	void AlignedFloatBuffer::attach(float *aData, unsigned int aFloats)
+	{
+		delete[] mBasePtr;
+		mBasePtr = 0;
+		mData = aData;
+		mFloats = aFloats;
+	}
+
 	void AlignedFloatBuffer::clear()
 	{
 		memset(mData, 0, sizeof(float) * mFloats);
@@ -105,8 +171,9 @@ namespace SoLoud
 		_controlfp(u, _MCW_EM);
 #endif
 		mInsideAudioThreadMutex = false;
+		mArena = NULL;
 		mScratchSize = 0;
-		mScratchNeeded = 0;
+		mBusDepth = 0;
 		mSamplerate = 0;
 		mBufferSize = 0;
 		mFlags = 0;
@@ -123,6 +190,15 @@ namespace SoLoud
 		mBackendString = 0;
 		mBackendID = 0;
 		mActiveVoiceDirty = true;
+		mLoudnessVoiceSelection = false;
+		mProfiler = NULL;
+		mRealtimePriority = 70;
+		mRealtimeCpu = -1;
+		mRealtimeGeneration = 1;
+		mRealtimeStatus = 0;
+		mRenderAheadPeriods = 0;
+		mRenderAheadPeriodSize = 0;
+		mRenderAhead = NULL;
 		mActiveVoiceCount = 0;
 		int i;
 		for (i = 0; i < VOICE_COUNT; i++)
@@ -185,6 +261,11 @@ namespace SoLoud
 		delete[] mVoiceGroup;
 		delete[] mResampleData;
 		delete[] mResampleDataOwner;
+		if (mRealtimeStatus & REALTIME_LOCKED_MEMORY)
+			lockArena(mArena, false);
+		delete mArena;
+		delete mProfiler;
+		delete mRenderAhead;
 	}
 
 	void Soloud::deinit()
@@ -194,6 +275,20 @@ namespace SoLoud
 		if (mBackendCleanupFunc)
 			mBackendCleanupFunc(this);
 		mBackendCleanupFunc = 0;
+		// Nothing reads the ring once the backend is gone
+		if (mRenderAhead)
+			mRenderAhead->stop();
+#ifdef SOLOUD_MLOCK
+		if (mRealtimeStatus & REALTIME_LOCKED_ALL)
+		{
+			Thread::lockMutex(lockAllMutex());
+			if (--gLockAllCount == 0)
+				munlockall();
+			Thread::unlockMutex(lockAllMutex());
+			// The arena was only locked as part of the process
+			mRealtimeStatus &= ~(REALTIME_LOCKED_ALL | REALTIME_LOCKED_MEMORY);
+		}
+#endif
 		if (mAudioThreadMutex)
 			Thread::destroyMutex(mAudioThreadMutex);
 		mAudioThreadMutex = NULL;
@@ -575,17 +670,10 @@ namespace SoLoud
 		mScratchSize = aBufferSize;
 		if (mScratchSize < SAMPLE_GRANULARITY * 2) mScratchSize = SAMPLE_GRANULARITY * 2;
 		if (mScratchSize < 4096) mScratchSize = 4096;
-		mScratchNeeded = mScratchSize;
-		mScratch.init(mScratchSize * MAX_CHANNELS);
-		mOutputScratch.init(mScratchSize * MAX_CHANNELS);
-		mResampleData = new AlignedFloatBuffer[mMaxActiveVoices * 2];
-		mResampleDataOwner = new AudioSourceInstance*[mMaxActiveVoices];
-		unsigned int i;
-		for (i = 0; i < mMaxActiveVoices * 2; i++)
-			mResampleData[i].init(SAMPLE_GRANULARITY * MAX_CHANNELS);
-		for (i = 0; i < mMaxActiveVoices; i++)
-			mResampleDataOwner[i] = NULL;
+		initArena_internal(mMaxActiveVoices);
 		mFlags = aFlags;
+		if ((mFlags & (ENABLE_PROFILING | ENABLE_VOICE_PROFILING)) && !mProfiler)
+			mProfiler = new Profiler;
 		mPostClipScaler = 0.95f;
 		switch (mChannels)
 		{
@@ -678,6 +766,163 @@ namespace SoLoud
 			m3dSpeakerPosition[7 * 3 + 2] = -1;
 			break;
 		}
+
+		if (mFlags & ENABLE_REALTIME)
+		{
+			// Before the backend starts calling back; the thread itself is hardened on its first block
+			lockMemory_internal();
+			warmUp_internal();
+		}
+
+		if (mRenderAheadPeriods)
+		{
+			// Fills the ring before returning, so before the backend's first callback.
+			// Without the thread, mixing stays in the callback.
+			if (!mRenderAhead)
+				mRenderAhead = new RenderAhead;
+			unsigned int period = mRenderAheadPeriodSize ? mRenderAheadPeriodSize : aBufferSize;
+			mRenderAhead->start(this, mRenderAheadPeriods, period, aChannels);
+		}
+	}
+
+	void Soloud::lockMemory_internal()
+	{
+#ifdef SOLOUD_MLOCK
+		// With MCL_FUTURE every later allocation fails once the limit is reached, so
+		// the whole process is only locked when nothing limits it. Reverb rings and
+		// other filter state are then locked as they're allocated; they are already
+		// pre-faulted at construction.
+		struct rlimit limit;
+		if (!(mRealtimeStatus & REALTIME_LOCKED_ALL))
+		{
+			Thread::lockMutex(lockAllMutex());
+			if (gLockAllCount ||
+				(getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY &&
+				mlockall(MCL_CURRENT | MCL_FUTURE) == 0))
+			{
+				gLockAllCount++;
+				mRealtimeStatus |= REALTIME_LOCKED_ALL;
+			}
+			Thread::unlockMutex(lockAllMutex());
+		}
+#endif
+		if ((mRealtimeStatus & (REALTIME_LOCKED_ALL | REALTIME_LOCKED_MEMORY)) || lockArena(mArena, true))
+			mRealtimeStatus |= REALTIME_LOCKED_MEMORY;
+	}
+
+	void Soloud::warmUp_internal()
+	{
+		if (!mArena)
+			return;
+		// Nothing is playing yet, so the arena is free to scribble on; it's cleared again after
+		float *src = mResampleData[0].mData;
+		float *prev = mResampleData[1].mData;
+		unsigned int i;
+		for (i = 0; i < SAMPLE_GRANULARITY; i++)
+		{
+			src[i] = (float)sin(i * 0.01f);
+			prev[i] = src[i];
+		}
+		// Half rate source, so one source block covers the output
+		resample(src, prev, mScratch.mData, 0, SAMPLE_GRANULARITY, mSamplerate * 0.5f, (float)mSamplerate, FIXPOINT_FRAC_MUL / 2);
+
+		WarmUpInstance voice;
+		voice.mOverallVolume = 1;
+		for (i = 1; i <= MAX_CHANNELS; i++)
+		{
+			voice.mChannels = i;
+			if (i == 1 || i == 2 || i == mChannels)
+				panAndExpand(&voice, mOutputScratch.mData, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, mScratch.mData, mChannels);
+		}
+
+		clip_internal(mOutputScratch, mScratch, SAMPLE_GRANULARITY, 1, 1);
+		interlace_samples_float(mScratch.mData, mOutputScratch.mData, SAMPLE_GRANULARITY, mChannels);
+		mArena->clear();
+		mRealtimeStatus |= REALTIME_WARMED_UP;
+	}
+
+	void Soloud::hardenThread_internal()
+	{
+		// Once per thread and parameter change: these are the only system calls the mixer makes
+		tRealtimeOwner = this;
+		tRealtimeGeneration = mRealtimeGeneration.load(std::memory_order_acquire);
+		unsigned int status = 0;
+		if (Thread::setRealtimePriority(mRealtimePriority))
+			status |= REALTIME_SCHEDULING;
+		if (mRealtimeCpu >= 0 && Thread::setAffinity(mRealtimeCpu))
+			status |= REALTIME_PINNED;
+		// Only this thread's bits; the others may be changed by init/deinit meanwhile
+		mRealtimeStatus.fetch_and(~(unsigned int)(REALTIME_SCHEDULING | REALTIME_PINNED));
+		mRealtimeStatus.fetch_or(status);
+	}
+
+	result Soloud::initArena_internal(unsigned int aVoiceCount)
+	{
+		// Everything the mixer touches per block lives in one allocation so that
+		// nothing needs to be allocated on the audio thread, and the buffers stay
+		// close to each other in memory. Every region is a multiple of the cache line.
+		const unsigned int align = ARENA_ALIGNMENT / sizeof(float);
+		unsigned int scratchFloats = ((mScratchSize * MAX_CHANNELS + align - 1) / align) * align;
+		unsigned int resampleFloats = SAMPLE_GRANULARITY * MAX_CHANNELS;
+		unsigned int totalFloats = scratchFloats * (2 + MAX_BUS_DEPTH) + resampleFloats * aVoiceCount * 2;
+
+		AlignedFloatBuffer *arena = new AlignedFloatBuffer;
+		AlignedFloatBuffer *resampleData = new AlignedFloatBuffer[aVoiceCount * 2];
+		AudioSourceInstance **resampleDataOwner = new AudioSourceInstance*[aVoiceCount];
+		if (arena == NULL || resampleData == NULL || resampleDataOwner == NULL || 
+			arena->init(totalFloats, ARENA_ALIGNMENT) != SO_NO_ERROR)
+		{
+			delete arena;
+			delete[] resampleData;
+			delete[] resampleDataOwner;
+			return OUT_OF_MEMORY;
+		}
+		arena->clear();
+
+		float *ptr = arena->mData;
+		unsigned int i;
+		for (i = 0; i < aVoiceCount * 2; i++)
+		{
+			resampleData[i].attach(ptr, resampleFloats);
+			ptr += resampleFloats;
+		}
+		for (i = 0; i < aVoiceCount; i++)
+			resampleDataOwner[i] = NULL;
+
+		// Swap the new buffers in; voices get remapped to the new resample buffers
+		// on the next mix.
+		lockAudioMutex_internal();
+		AlignedFloatBuffer *oldArena = mArena;
+		AlignedFloatBuffer *oldResampleData = mResampleData;
+		AudioSourceInstance **oldResampleDataOwner = mResampleDataOwner;
+		mArena = arena;
+		mResampleData = resampleData;
+		mResampleDataOwner = resampleDataOwner;
+		mMaxActiveVoices = aVoiceCount;
+		mOutputScratch.attach(ptr, scratchFloats);
+		ptr += scratchFloats;
+		mScratch.attach(ptr, scratchFloats);
+		ptr += scratchFloats;
+		for (i = 0; i < MAX_BUS_DEPTH; i++)
+		{
+			mBusScratch[i].attach(ptr, scratchFloats);
+			ptr += scratchFloats;
+		}
+		mActiveVoiceDirty = true;
+		unlockAudioMutex_internal();
+
+		// Keep the lock on the arena across reallocation; a process wide lock covers it already
+		if ((mRealtimeStatus & REALTIME_LOCKED_MEMORY) && !(mRealtimeStatus & REALTIME_LOCKED_ALL))
+		{
+			lockArena(oldArena, false);
+			if (!lockArena(arena, true))
+				mRealtimeStatus &= ~REALTIME_LOCKED_MEMORY;
+		}
+
+		delete oldArena;
+		delete[] oldResampleData;
+		delete[] oldResampleDataOwner;
+		return SO_NO_ERROR;
 	}
 
 	const char * Soloud::getErrorString(result aErrorCode) const
@@ -914,10 +1159,6 @@ namespace SoLoud
 }
 #endif
 
-#define FIXPOINT_FRAC_BITS 20
-#define FIXPOINT_FRAC_MUL (1 << FIXPOINT_FRAC_BITS)
-#define FIXPOINT_FRAC_MASK ((1 << FIXPOINT_FRAC_BITS) - 1)
-
 	void resample(float *aSrc,
 		          float *aSrc1, 
 				  float *aDst, 
@@ -1403,18 +1644,100 @@ namespace SoLoud
 			aVoice->mCurrentChannelVolume[k] = pand[k];
 	}
 
-	void Soloud::mixBus_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize, float *aScratch, unsigned int aBus, float aSamplerate, unsigned int aChannels)
+	// Zero a range of samples in each channel of a planar buffer
+	static void clearChannels(float *aBuffer, unsigned int aOffset, unsigned int aSamples, unsigned int aBufferSize, unsigned int aChannels)
 	{
-		unsigned int i, j;
-		// Clear accumulation buffer
-		for (i = 0; i < aSamplesToRead; i++)
+		unsigned int k;
+		for (k = 0; k < aChannels; k++)
+			memset(aBuffer + k * aBufferSize + aOffset, 0, sizeof(float) * aSamples);
+	}
+
+	// Get aSamples of source data into a planar buffer, looping as needed. Returns
+	// true if the whole range is silent, in which case its contents are undefined.
+	static bool getVoiceBlock(AudioSourceInstance *aVoice, float *aBuffer, unsigned int aSamples, unsigned int aBufferSize, float *aSeekScratch, unsigned int aSeekScratchSize)
+	{
+		float *buffer = aBuffer;
+		unsigned int readcount = 0;
+		bool silent = true;
+		if (!aVoice->hasEnded() || aVoice->mFlags & AudioSourceInstance::LOOPING)
 		{
-			for (j = 0; j < aChannels; j++)
+			aVoice->mFlags &= ~AudioSourceInstance::SILENT;
+			readcount = aVoice->getAudio(buffer, aSamples, aBufferSize);
+			silent = readcount == 0 || (aVoice->mFlags & AudioSourceInstance::SILENT);
+			if (readcount < aSamples)
 			{
-				aBuffer[i + j * aBufferSize] = 0;
+				if (aVoice->mFlags & AudioSourceInstance::LOOPING)
+				{
+					while (readcount < aSamples && aVoice->seek(aVoice->mLoopPoint, aSeekScratch, aSeekScratchSize) == SO_NO_ERROR)
+					{
+						aVoice->mLoopCount++;
+						aVoice->mFlags &= ~AudioSourceInstance::SILENT;
+						unsigned int inc = aVoice->getAudio(buffer + readcount, aSamples - readcount, aBufferSize);
+						if (inc && !(aVoice->mFlags & AudioSourceInstance::SILENT))
+						{
+							// Silent parts read so far may hold garbage
+							if (silent)
+								clearChannels(buffer, 0, readcount, aBufferSize, aVoice->mChannels);
+							silent = false;
+						}
+						else if (inc && !silent)
+						{
+							clearChannels(buffer, readcount, inc, aBufferSize, aVoice->mChannels);
+						}
+						readcount += inc;
+						if (inc == 0) break;
+					}
+				}
 			}
+			aVoice->mFlags &= ~AudioSourceInstance::SILENT;
 		}
 
+		if (silent)
+			return true;
+
+		// Clear the remainder if the source ran out
+		if (readcount < aSamples)
+			clearChannels(buffer, readcount, aSamples - readcount, aBufferSize, aVoice->mChannels);
+		return false;
+	}
+
+	// Decode the blocks an inaudible voice skipped through advance() again, so that the
+	// resampler picks up where it would have had the voice been decoded all along. Loop
+	// count and stream position are left as they are; the read position ends up back
+	// where it was.
+	static void replaySkippedBlocks(AudioSourceInstance *aVoice, float *aSeekScratch, unsigned int aSeekScratchSize)
+	{
+		unsigned int resume = aVoice->tellFrame();
+		unsigned int loopcount = aVoice->mLoopCount;
+		time position = aVoice->mStreamPosition;
+		unsigned int b = aVoice->mSkippedBlocks;
+		while (b-- > 0)
+		{
+			float *data = aVoice->mResampleData[b]->mData;
+			if (aVoice->seekFrame(aVoice->mSkippedFrame[b]) != SO_NO_ERROR ||
+				getVoiceBlock(aVoice, data, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, aSeekScratch, aSeekScratchSize))
+			{
+				clearChannels(data, 0, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, aVoice->mChannels);
+			}
+			aVoice->mResampleDataSilent &= ~(1 << b);
+		}
+		if (aVoice->tellFrame() != resume)
+			aVoice->seekFrame(resume);
+		aVoice->mLoopCount = loopcount;
+		aVoice->mStreamPosition = position;
+		aVoice->mSkippedBlocks = 0;
+	}
+
+	bool Soloud::mixBus_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize, float *aScratch, unsigned int aBus, float aSamplerate, unsigned int aChannels)
+	{
+		unsigned int i, j;
+		// The accumulation buffer is only cleared once something audible gets mixed in
+		bool silent = true;
+		// Voice profiling laps run back to back, so each stage is charged up to where it ends
+		Profiler *vp = (mFlags & ENABLE_VOICE_PROFILING) ? mProfiler : NULL;
+		unsigned long long cpulap = 0;
+		unsigned long long cpubefore[AudioSourceInstance::CPU_STAGE_COUNT];
+
 		// Accumulate sound sources		
 		for (i = 0; i < mActiveVoiceCount; i++)
 		{
@@ -1430,6 +1753,23 @@ namespace SoLoud
 					step = 0;
 				unsigned int step_fixed = (int)floor(step * FIXPOINT_FRAC_MUL);
 				unsigned int outofs = 0;
+				// Everything generated so far is silence; the scratch is only
+				// filled in once the voice turns out to be audible.
+				bool voicesilent = true;
+
+				if (vp)
+				{
+					memcpy(cpubefore, voice->mCpuTime, sizeof(cpubefore));
+					cpulap = Profiler::now();
+				}
+
+				// Back from being ticked through advance(); the resample buffers hold nothing yet
+				if (voice->mSkippedBlocks)
+				{
+					replaySkippedBlocks(voice, mScratch.mData, mScratchSize);
+					if (vp)
+						cpulap = vp->voiceLap(voice, AudioSourceInstance::CPU_DECODE, cpulap);
+				}
 			
 				if (voice->mDelaySamples)
 				{
@@ -1443,53 +1783,86 @@ namespace SoLoud
 						outofs = voice->mDelaySamples;
 						voice->mDelaySamples = 0;
 					}
-					
-					// Clear scratch where we're skipping
-					unsigned int k;
-					for (k = 0; k < voice->mChannels; k++)
-					{
-						memset(aScratch + k * aBufferSize, 0, sizeof(float) * outofs); 
-					}
 				}												
 
-				while (step_fixed != 0 && outofs < aSamplesToRead)
+				// Native rate with the resampler at a block boundary: read straight into
+				// the scratch, skipping the resample buffers. Filters expect the channel
+				// stride to match the sample count, so filtered voices need a full block.
+				if (step_fixed == FIXPOINT_FRAC_MUL &&
+					voice->mLeftoverSamples == 0 &&
+					(voice->mSrcOffset == 0 || voice->mSrcOffset == SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL) &&
+					outofs < aSamplesToRead)
 				{
-					if (voice->mLeftoverSamples == 0)
+					bool filtered = false;
+					for (j = 0; j < FILTERS_PER_STREAM; j++)
 					{
-						// Swap resample buffers (ping-pong)
-						AlignedFloatBuffer * t = voice->mResampleData[0];
-						voice->mResampleData[0] = voice->mResampleData[1];
-						voice->mResampleData[1] = t;
+						if (voice->mFilter[j])
+							filtered = true;
+					}
 
-						// Get a block of source data
+					if (!filtered || (outofs == 0 && aSamplesToRead == aBufferSize))
+					{
+						unsigned int samples = aSamplesToRead - outofs;
+						// The resample buffers are idle here, so one of them serves as seek scratch
+						bool blocksilent = getVoiceBlock(voice, aScratch + outofs, samples, aBufferSize, voice->mResampleData[1]->mData, SAMPLE_GRANULARITY * MAX_CHANNELS);
+						if (vp)
+							cpulap = vp->voiceLap(voice, AudioSourceInstance::CPU_DECODE, cpulap);
 
-						int readcount = 0;
-						if (!voice->hasEnded() || voice->mFlags & AudioSourceInstance::LOOPING)
+						for (j = 0; j < FILTERS_PER_STREAM; j++)
 						{
-							readcount = voice->getAudio(voice->mResampleData[0]->mData, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY);
-							if (readcount < SAMPLE_GRANULARITY)
+							if (voice->mFilter[j])
 							{
-								if (voice->mFlags & AudioSourceInstance::LOOPING)
+								if (!voice->mFilter[j]->needsProcessing_internal(blocksilent, samples, voice->mSamplerate))
+									continue;
+								if (blocksilent)
 								{
-									while (readcount < SAMPLE_GRANULARITY && voice->seek(voice->mLoopPoint, mScratch.mData, mScratchSize) == SO_NO_ERROR)
-									{
-										voice->mLoopCount++;
-										int inc = voice->getAudio(voice->mResampleData[0]->mData + readcount, SAMPLE_GRANULARITY - readcount, SAMPLE_GRANULARITY);
-										readcount += inc;
-										if (inc == 0) break;
-									}
+									clearChannels(aScratch, 0, samples, aBufferSize, voice->mChannels);
+									blocksilent = false;
 								}
+								unsigned long long tracestart = Trace::begin();
+								voice->mFilter[j]->filter(
+									aScratch,
+									samples,
+									voice->mChannels,
+									voice->mSamplerate,
+									mStreamTime);
+								Trace::end("filter", tracestart, voice->mAudioSourceID);
+								if (vp)
+									cpulap = vp->filterLap(voice, voice->mFilter[j], cpulap);
 							}
 						}
 
-                        // Clear remaining of the resample data if the full scratch wasn't used
-						if (readcount < SAMPLE_GRANULARITY)
+						if (!blocksilent)
 						{
-							unsigned int k;
-							for (k = 0; k < voice->mChannels; k++)
-								memset(voice->mResampleData[0]->mData + readcount + SAMPLE_GRANULARITY * k, 0, sizeof(float) * (SAMPLE_GRANULARITY - readcount));
+							clearChannels(aScratch, 0, outofs, aBufferSize, voice->mChannels);
+							voicesilent = false;
 						}
 
+						// Leave the resampler at the next block boundary, holding the last sample
+						// for interpolation in case the voice drops off the native rate.
+						for (j = 0; j < voice->mChannels; j++)
+							voice->mResampleData[0]->mData[SAMPLE_GRANULARITY * j + SAMPLE_GRANULARITY - 1] = blocksilent ? 0 : aScratch[aBufferSize * j + aSamplesToRead - 1];
+						voice->mResampleDataSilent = blocksilent ? 1 : 0;
+						voice->mSrcOffset = SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL;
+						outofs = aSamplesToRead;
+					}
+				}
+
+				while (step_fixed != 0 && outofs < aSamplesToRead)
+				{
+					if (voice->mLeftoverSamples == 0)
+					{
+						// Swap resample buffers (ping-pong)
+						AlignedFloatBuffer * t = voice->mResampleData[0];
+						voice->mResampleData[0] = voice->mResampleData[1];
+						voice->mResampleData[1] = t;
+						voice->mResampleDataSilent = (voice->mResampleDataSilent & 1) << 1;
+
+						// Get a block of source data
+						bool blocksilent = getVoiceBlock(voice, voice->mResampleData[0]->mData, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, mScratch.mData, mScratchSize);
+						if (vp)
+							cpulap = vp->voiceLap(voice, AudioSourceInstance::CPU_DECODE, cpulap);
+
 						// If we go past zero, crop to zero (a bit of a kludge)
 						if (voice->mSrcOffset < SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL)
 						{
@@ -1502,20 +1875,43 @@ namespace SoLoud
 						}
 
 					
-						// Run the per-stream filters to get our source data
+						// Run the per-stream filters to get our source data.
+						// On silent input, filters that have rung out are skipped.
 
 						for (j = 0; j < FILTERS_PER_STREAM; j++)
 						{
 							if (voice->mFilter[j])
 							{
+								if (!voice->mFilter[j]->needsProcessing_internal(blocksilent, SAMPLE_GRANULARITY, voice->mSamplerate))
+									continue;
+								if (blocksilent)
+								{
+									clearChannels(voice->mResampleData[0]->mData, 0, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, voice->mChannels);
+									blocksilent = false;
+								}
+								unsigned long long tracestart = Trace::begin();
 								voice->mFilter[j]->filter(
 									voice->mResampleData[0]->mData,
 									SAMPLE_GRANULARITY, 
 									voice->mChannels,
 									voice->mSamplerate,
 									mStreamTime);
+								Trace::end("filter", tracestart, voice->mAudioSourceID);
+								if (vp)
+									cpulap = vp->filterLap(voice, voice->mFilter[j], cpulap);
 							}
 						}
+
+						if (blocksilent)
+						{
+							// The resampler reads the previous block's last sample, and the whole
+							// block when the previous one was audible; only define what gets read.
+							if (voice->mResampleDataSilent & 2)
+								clearChannels(voice->mResampleData[0]->mData, SAMPLE_GRANULARITY - 1, 1, SAMPLE_GRANULARITY, voice->mChannels);
+							else
+								clearChannels(voice->mResampleData[0]->mData, 0, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, voice->mChannels);
+							voice->mResampleDataSilent |= 1;
+						}
 					}
 					else
 					{
@@ -1547,16 +1943,33 @@ namespace SoLoud
 					// Call resampler to generate the samples, once per channel
 					if (writesamples)
 					{
-						for (j = 0; j < voice->mChannels; j++)
+						if ((voice->mResampleDataSilent & 3) == 3)
 						{
-							resample(voice->mResampleData[0]->mData + SAMPLE_GRANULARITY * j,
-								voice->mResampleData[1]->mData + SAMPLE_GRANULARITY * j,
-									 aScratch + aBufferSize * j + outofs, 
-									 voice->mSrcOffset,
-									 writesamples,
-									 voice->mSamplerate,
-									 aSamplerate,
-									 step_fixed);
+							// Silence in, silence out
+							if (!voicesilent)
+								clearChannels(aScratch, outofs, writesamples, aBufferSize, voice->mChannels);
+						}
+						else
+						{
+							if (voicesilent)
+							{
+								// Fill in the silence skipped so far (including delay)
+								clearChannels(aScratch, 0, outofs, aBufferSize, voice->mChannels);
+								voicesilent = false;
+							}
+							for (j = 0; j < voice->mChannels; j++)
+							{
+								resample(voice->mResampleData[0]->mData + SAMPLE_GRANULARITY * j,
+									voice->mResampleData[1]->mData + SAMPLE_GRANULARITY * j,
+										 aScratch + aBufferSize * j + outofs, 
+										 voice->mSrcOffset,
+										 writesamples,
+										 voice->mSamplerate,
+										 aSamplerate,
+										 step_fixed);
+							}
+							if (vp)
+								cpulap = vp->voiceLap(voice, AudioSourceInstance::CPU_RESAMPLE, cpulap);
 						}
 					}
 
@@ -1567,8 +1980,30 @@ namespace SoLoud
 					voice->mSrcOffset += writesamples * step_fixed;
 				}
 				
-				// Handle panning and channel expansion (and/or shrinking)
-				panAndExpand(voice, aBuffer, aSamplesToRead, aBufferSize, aScratch, aChannels);
+				if (voicesilent)
+				{
+					// Nothing to mix; just keep the volume ramp where panAndExpand would have left it
+					unsigned int k;
+					for (k = 0; k < aChannels; k++)
+						voice->mCurrentChannelVolume[k] = voice->mChannelVolume[k] * voice->mOverallVolume;
+				}
+				else
+				{
+					if (silent)
+					{
+						// Clear accumulation buffer
+						clearChannels(aBuffer, 0, aSamplesToRead, aBufferSize, aChannels);
+						silent = false;
+					}
+
+					// Handle panning and channel expansion (and/or shrinking)
+					panAndExpand(voice, aBuffer, aSamplesToRead, aBufferSize, aScratch, aChannels);
+					if (vp)
+						vp->voiceLap(voice, AudioSourceInstance::CPU_PAN, cpulap);
+				}
+
+				if (vp)
+					vp->voiceDone(voice, cpubefore);
 
 				// clear voice if the sound is over
 				if (!(voice->mFlags & AudioSourceInstance::LOOPING) && voice->hasEnded())
@@ -1583,11 +2018,20 @@ namespace SoLoud
 					(voice->mFlags & AudioSourceInstance::INAUDIBLE) &&
 					(voice->mFlags & AudioSourceInstance::INAUDIBLE_TICK))
 			{
-				// Inaudible but needs ticking. Do minimal work (keep counters up to date and ask audiosource for data)
+				// Inaudible but needs ticking. Do minimal work: keep counters up to date and advance the
+				// audiosource the same amount it would be read. Sources that can seek back to a frame
+				// skip the data and decode it again only if the voice turns audible; the rest decode
+				// into the resample buffers as when audible, unfiltered.
 				float step = voice->mSamplerate / aSamplerate;
 				int step_fixed = (int)floor(step * FIXPOINT_FRAC_MUL);
 				unsigned int outofs = 0;
 
+				if (vp)
+				{
+					memcpy(cpubefore, voice->mCpuTime, sizeof(cpubefore));
+					cpulap = Profiler::now();
+				}
+
 				if (voice->mDelaySamples)
 				{
 					if (voice->mDelaySamples > aSamplesToRead)
@@ -1610,25 +2054,47 @@ namespace SoLoud
 						AlignedFloatBuffer * t = voice->mResampleData[0];
 						voice->mResampleData[0] = voice->mResampleData[1];
 						voice->mResampleData[1] = t;
+						voice->mResampleDataSilent = (voice->mResampleDataSilent & 1) << 1;
 
-						// Get a block of source data
-
-						int readcount = 0;
-						if (!voice->hasEnded() || voice->mFlags & AudioSourceInstance::LOOPING)
+						unsigned int frame = voice->tellFrame();
+						if (frame != AudioSourceInstance::NO_FRAME)
 						{
-							readcount = voice->getAudio(voice->mResampleData[0]->mData, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY);
-							if (readcount < SAMPLE_GRANULARITY)
+							// Skip a block of source data, remembering where it started. The buffer is
+							// marked silent until replaySkippedBlocks fills it in.
+							voice->mSkippedFrame[1] = voice->mSkippedFrame[0];
+							voice->mSkippedFrame[0] = frame;
+							if (voice->mSkippedBlocks < 2)
+								voice->mSkippedBlocks++;
+							clearChannels(voice->mResampleData[0]->mData, SAMPLE_GRANULARITY - 1, 1, SAMPLE_GRANULARITY, voice->mChannels);
+							voice->mResampleDataSilent |= 1;
+
+							// The resample buffer doubles as scratch for sources that decode to advance
+							float *scratch = voice->mResampleData[0]->mData;
+							unsigned int readcount = 0;
+							if (!voice->hasEnded() || voice->mFlags & AudioSourceInstance::LOOPING)
 							{
-								if (voice->mFlags & AudioSourceInstance::LOOPING)
+								readcount = voice->advance(SAMPLE_GRANULARITY, scratch, SAMPLE_GRANULARITY * MAX_CHANNELS);
+								if (readcount < SAMPLE_GRANULARITY)
 								{
-									while (readcount < SAMPLE_GRANULARITY && voice->seek(voice->mLoopPoint, mScratch.mData, mScratchSize) == SO_NO_ERROR)
+									if (voice->mFlags & AudioSourceInstance::LOOPING)
 									{
-										voice->mLoopCount++;
-										readcount += voice->getAudio(voice->mResampleData[0]->mData + readcount, SAMPLE_GRANULARITY - readcount, SAMPLE_GRANULARITY);
+										while (readcount < SAMPLE_GRANULARITY && voice->seek(voice->mLoopPoint, mScratch.mData, mScratchSize) == SO_NO_ERROR)
+										{
+											voice->mLoopCount++;
+											unsigned int inc = voice->advance(SAMPLE_GRANULARITY - readcount, scratch, SAMPLE_GRANULARITY * MAX_CHANNELS);
+											readcount += inc;
+											if (inc == 0) break;
+										}
 									}
 								}
 							}
 						}
+						else
+						{
+							if (getVoiceBlock(voice, voice->mResampleData[0]->mData, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, mScratch.mData, mScratchSize))
+								clearChannels(voice->mResampleData[0]->mData, 0, SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, voice->mChannels);
+							voice->mSkippedBlocks = 0;
+						}
 
 						// If we go past zero, crop to zero (a bit of a kludge)
 						if (voice->mSrcOffset < SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL)
@@ -1679,6 +2145,12 @@ namespace SoLoud
 					voice->mSrcOffset += writesamples * step_fixed;
 				}
 
+				if (vp)
+				{
+					vp->voiceLap(voice, AudioSourceInstance::CPU_DECODE, cpulap);
+					vp->voiceDone(voice, cpubefore);
+				}
+
 				// clear voice if the sound is over
 				if (!(voice->mFlags & AudioSourceInstance::LOOPING) && voice->hasEnded())
 				{
@@ -1686,6 +2158,7 @@ namespace SoLoud
 				}
 			}
 		}
+		return silent;
 	}
 
 	void Soloud::mapResampleBuffers_internal()
@@ -1735,6 +2208,8 @@ namespace SoLoud
 				mResampleDataOwner[found]->mResampleData[1] = &mResampleData[found * 2 + 1];
 				mResampleDataOwner[found]->mResampleData[0]->clear();
 				mResampleDataOwner[found]->mResampleData[1]->clear();
+				mResampleDataOwner[found]->mResampleDataSilent = 3;
+				mResampleDataOwner[found]->mSkippedBlocks = 0;
 				latestfree = found + 1;
 			}
 		}
@@ -1788,6 +2263,11 @@ namespace SoLoud
 		}
 
 		// If we get this far, there's nothing to it: we'll have to sort the voices to find the most audible.
+		for (i = mustlive; i < candidates; i++)
+		{
+			AudioSourceInstance *v = mVoice[mActiveVoice[i]];
+			mVoiceRank[mActiveVoice[i]] = mLoudnessVoiceSelection ? v->mOverallVolume * v->getContentLevel() : v->mOverallVolume;
+		}
 
 		// Iterative partial quicksort:
 		int left = 0, stack[24], pos = 0, right;
@@ -1800,7 +2280,7 @@ namespace SoLoud
 			{                
 				if (pos == 24) len = stack[pos = 0]; 
 				int pivot = data[left];
-				float pivotvol = mVoice[pivot]->mOverallVolume;
+				float pivotvol = mVoiceRank[pivot];
 				stack[pos++] = len;      
 				for (right = left - 1;;) 
 				{
@@ -1808,12 +2288,12 @@ namespace SoLoud
 					{
 						right++;
 					} 
-					while (mVoice[data[right]]->mOverallVolume > pivotvol);
+					while (mVoiceRank[data[right]] > pivotvol);
 					do
 					{
 						len--;
 					}
-					while (pivotvol > mVoice[data[len]]->mOverallVolume);
+					while (pivotvol > mVoiceRank[data[len]]);
 					if (right >= len) break;       
 					int temp = data[right];
 					data[right] = data[len];
@@ -1829,8 +2309,19 @@ namespace SoLoud
 		mapResampleBuffers_internal();
 	}
 
-	void Soloud::mix_internal(unsigned int aSamples)
+	// Close a mix_internal stage for the profiler and the trace, whichever are on; returns now
+	static unsigned long long mixLap(Profiler *aProfiler, bool aTracing, unsigned int aStage, unsigned long long aStart)
 	{
+		unsigned long long t = aProfiler ? aProfiler->lap(aStage, aStart) : Profiler::now();
+		if (aTracing)
+			Trace::event(Profiler::getStageName(aStage), aStart, t);
+		return t;
+	}
+
+	bool Soloud::mix_internal(unsigned int aSamples)
+	{
+		SOLOUD_AUDIT_ENTER();
+
 #ifdef FLOATING_POINT_DEBUG
 		// This needs to be done in the audio thread as well..
 		static int done = 0;
@@ -1844,38 +2335,40 @@ namespace SoLoud
 		}
 #endif
 
+		// The FPU modes are per thread, and the mixing thread isn't always the same one
+		// (backend restarts, mix() called from the game), so they're checked every block
+		// rather than set once per process. Reading the register is cheap; writing it
+		// only happens when a thread mixes for the first time.
 #ifdef _MCW_DN
+		if (!(mFlags & NO_FPU_REGISTER_CHANGE) && (_controlfp(0, 0) & _MCW_DN) != _DN_FLUSH)
 		{
-			static bool once = false;
-			if (!once)
-			{
-				once = true;
-				if (!(mFlags & NO_FPU_REGISTER_CHANGE))
-				{
-					_controlfp(_DN_FLUSH, _MCW_DN);
-				}
-			}
+			_controlfp(_DN_FLUSH, _MCW_DN);
 		}
 #endif
 
 #ifdef SOLOUD_SSE_INTRINSICS
+		// Set denorm clear to zero (CTZ) and denorms are zero (DAZ) flags on.
+		// This causes all math to consider really tiny values as zero, which
+		// helps performance. I'd rather use constants from the sse headers,
+		// but for some reason the DAZ value is not defined there(!)
+		if (!(mFlags & NO_FPU_REGISTER_CHANGE) && (_mm_getcsr() & 0x8040) != 0x8040)
 		{
-			static bool once = false;
-			if (!once)
-			{
-				once = true;
-				// Set denorm clear to zero (CTZ) and denorms are zero (DAZ) flags on.
-				// This causes all math to consider really tiny values as zero, which
-				// helps performance. I'd rather use constants from the sse headers,
-				// but for some reason the DAZ value is not defined there(!)
-				if (!(mFlags & NO_FPU_REGISTER_CHANGE))
-				{
-					_mm_setcsr(_mm_getcsr() | 0x8040);
-				}
-			}
+			_mm_setcsr(_mm_getcsr() | 0x8040);
 		}
 #endif
 
+		if ((mFlags & ENABLE_REALTIME) && (tRealtimeOwner != this || tRealtimeGeneration != mRealtimeGeneration.load(std::memory_order_relaxed)))
+			hardenThread_internal();
+
+		// One flag test per stage when profiling and tracing are off
+		Profiler *profiler = (mFlags & ENABLE_PROFILING) ? mProfiler : NULL;
+		bool tracing = Trace::isEnabled();
+		bool timed = profiler || tracing;
+		unsigned long long blockstart = timed ? Profiler::now() : 0;
+		unsigned long long stagestart = blockstart;
+		if (tracing)
+			Trace::setThreadName("audio");
+
 		float buffertime = aSamples / (float)mSamplerate;
 		float globalVolume[2];
 		mStreamTime += buffertime;
@@ -1888,9 +2381,7 @@ namespace SoLoud
 		}
 		globalVolume[1] = mGlobalVolume;
 
-		lockAudioMutex_internal();
-
-		// Process faders. May change scratch size.
+		// Process faders.
 		int i;
 		for (i = 0; i < (signed)mHighestVoice; i++)
 		{
@@ -1955,29 +2446,45 @@ namespace SoLoud
 			}
 		}
 
+		if (timed)
+			stagestart = mixLap(profiler, tracing, PROFILE_FADERS, stagestart);
+
 		if (mActiveVoiceDirty)
 			calcActiveVoices_internal();
 
-		// Resize scratch if needed.
-		if (mScratchSize < mScratchNeeded)
-		{
-			mScratchSize = mScratchNeeded;
-			mScratch.init(mScratchSize * MAX_CHANNELS);
-		}
-		
-		mixBus_internal(mOutputScratch.mData, aSamples, aSamples, mScratch.mData, 0, (float)mSamplerate, mChannels);
+		if (timed)
+			stagestart = mixLap(profiler, tracing, PROFILE_ACTIVE_VOICES, stagestart);
+
+		mBusDepth = 0;
+		bool silent = mixBus_internal(mOutputScratch.mData, aSamples, aSamples, mScratch.mData, 0, (float)mSamplerate, mChannels);
+
+		if (timed)
+			stagestart = mixLap(profiler, tracing, PROFILE_MIX_BUSES, stagestart);
 
 		for (i = 0; i < FILTERS_PER_STREAM; i++)
 		{
-			if (mFilterInstance[i])
+			if (mFilterInstance[i] && mFilterInstance[i]->needsProcessing_internal(silent, aSamples, (float)mSamplerate))
 			{
+				if (silent)
+				{
+					memset(mOutputScratch.mData, 0, sizeof(float) * aSamples * mChannels);
+					silent = false;
+				}
+				unsigned long long filterstart = (mFlags & ENABLE_VOICE_PROFILING) ? Profiler::now() : 0;
 				mFilterInstance[i]->filter(mOutputScratch.mData, aSamples, mChannels, (float)mSamplerate, mStreamTime);
+				if (filterstart)
+					mProfiler->filterLap(NULL, mFilterInstance[i], filterstart);
 			}
 		}
 
-		unlockAudioMutex_internal();
+		if (timed)
+			stagestart = mixLap(profiler, tracing, PROFILE_GLOBAL_FILTERS, stagestart);
+
+		if (!silent)
+			clip_internal(mOutputScratch, mScratch, aSamples, globalVolume[0], globalVolume[1]);
 
-		clip_internal(mOutputScratch, mScratch, aSamples, globalVolume[0], globalVolume[1]);
+		if (timed)
+			stagestart = mixLap(profiler, tracing, PROFILE_CLIP, stagestart);
 
 		if (mFlags & ENABLE_VISUALIZATION)
 		{
@@ -1985,7 +2492,12 @@ namespace SoLoud
 			{
 				mVisualizationChannelVolume[i] = 0;
 			}
-			if (aSamples > 255)
+			if (silent)
+			{
+				for (i = 0; i < 256; i++)
+					mVisualizationWaveData[i] = 0;
+			}
+			else if (aSamples > 255)
 			{
 				for (i = 0; i < 256; i++)
 				{
@@ -2019,18 +2531,77 @@ namespace SoLoud
 				}
 			}
 		}
+
+		if (timed)
+		{
+			stagestart = mixLap(profiler, tracing, PROFILE_VISUALIZATION, stagestart);
+			if (profiler)
+				profiler->block(blockstart, aSamples, mSamplerate);
+			if (tracing)
+				Trace::event("mix", blockstart, stagestart, aSamples);
+		}
+
+		SOLOUD_AUDIT_LEAVE();
+		return silent;
 	}
 
 	void Soloud::mix(float *aBuffer, unsigned int aSamples)
 	{
-		mix_internal(aSamples);
-		interlace_samples_float(mScratch.mData, aBuffer, aSamples, mChannels);
+		// Mixed ahead on the render thread; the callback takes no locks
+		if (mRenderAhead && mRenderAhead->isRunning())
+		{
+			mRenderAhead->read(aBuffer, aSamples);
+			return;
+		}
+		// The mutex is held for the whole block, as the mixer works in arena
+		// memory that setMaxActiveVoiceCount() may reallocate.
+		lockAudioMutex_internal();
+		mixInterleaved_internal(aBuffer, aSamples);
+		unlockAudioMutex_internal();
+	}
+
+	void Soloud::renderAhead_internal(float *aBuffer, unsigned int aSamples)
+	{
+		lockAudioMutex_internal();
+		mixInterleaved_internal(aBuffer, aSamples);
+		// Under the same lock as play(), so getCommandDelay sees the period whole
+		mRenderAhead->mRendered += aSamples;
+		unlockAudioMutex_internal();
+	}
+
+	void Soloud::mixInterleaved_internal(float *aBuffer, unsigned int aSamples)
+	{
+		while (aSamples)
+		{
+			unsigned int samples = aSamples < mScratchSize ? aSamples : mScratchSize;
+			if (mix_internal(samples))
+				memset(aBuffer, 0, sizeof(float) * samples * mChannels);
+			else
+				interlace_samples_float(mScratch.mData, aBuffer, samples, mChannels);
+			aBuffer += samples * mChannels;
+			aSamples -= samples;
+		}
 	}
 
 	void Soloud::mixSigned16(short *aBuffer, unsigned int aSamples)
 	{
-		mix_internal(aSamples);
-		interlace_samples_s16(mScratch.mData, aBuffer, aSamples, mChannels);
+		if (mRenderAhead && mRenderAhead->isRunning())
+		{
+			mRenderAhead->readSigned16(aBuffer, aSamples);
+			return;
+		}
+		lockAudioMutex_internal();
+		while (aSamples)
+		{
+			unsigned int samples = aSamples < mScratchSize ? aSamples : mScratchSize;
+			if (mix_internal(samples))
+				memset(aBuffer, 0, sizeof(short) * samples * mChannels);
+			else
+				interlace_samples_s16(mScratch.mData, aBuffer, samples, mChannels);
+			aBuffer += samples * mChannels;
+			aSamples -= samples;
+		}
+		unlockAudioMutex_internal();
 	}
 
 	void deinterlace_samples_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aSamples, unsigned int aChannels)
@@ -2048,6 +2619,105 @@ namespace SoLoud
 		}
 	}
 
+	static void deinterlace_frames_float_generic(const float *aSourceBuffer, float *aDestBuffer, unsigned int aFrames, unsigned int aSourceChannels, unsigned int aDestChannels, unsigned int aDestStride)
+	{
+		unsigned int i, k;
+		for (k = 0; k < aDestChannels; k++)
+		{
+			float *dst = aDestBuffer + k * aDestStride;
+			const float *src = aSourceBuffer + k;
+			for (i = 0; i < aFrames; i++)
+				dst[i] = src[i * aSourceChannels];
+		}
+	}
+
+	void deinterlace_frames_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aFrames, unsigned int aSourceChannels, unsigned int aDestChannels, unsigned int aDestStride)
+	{
+		if (aDestChannels > aSourceChannels)
+			aDestChannels = aSourceChannels;
+		if (aSourceChannels == 1)
+		{
+			memcpy(aDestBuffer, aSourceBuffer, sizeof(float) * aFrames);
+			return;
+		}
+#if defined(SOLOUD_SSE_INTRINSICS)
+		// Four frames per iteration; the leftovers go through the generic loop.
+		// Buffers are only guaranteed float aligned, so loads and stores are unaligned.
+		unsigned int i = 0;
+		float *d = aDestBuffer;
+		const unsigned int s = aDestStride;
+		if (aSourceChannels == 2 && aDestChannels == 2)
+		{
+			for (; i + 4 <= aFrames; i += 4)
+			{
+				const float *f = aSourceBuffer + i * 2;
+				__m128 a = _mm_loadu_ps(f);		// L0 R0 L1 R1
+				__m128 b = _mm_loadu_ps(f + 4);	// L2 R2 L3 R3
+				_mm_storeu_ps(d + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(d + s + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+		}
+		else
+		if (aSourceChannels == 6 && aDestChannels == 6)
+		{
+			for (; i + 4 <= aFrames; i += 4)
+			{
+				const float *f = aSourceBuffer + i * 6;
+				__m128 v0 = _mm_loadu_ps(f);
+				__m128 v1 = _mm_loadu_ps(f + 4);
+				__m128 v2 = _mm_loadu_ps(f + 8);
+				__m128 v3 = _mm_loadu_ps(f + 12);
+				__m128 v4 = _mm_loadu_ps(f + 16);
+				__m128 v5 = _mm_loadu_ps(f + 20);
+				// Split each frame pair into channels 0-3 of both frames and channels 4-5
+				__m128 r0 = v0;											// f0 c0-3
+				__m128 r1 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 0, 3, 2));	// f1 c0-3
+				__m128 r2 = v3;											// f2 c0-3
+				__m128 r3 = _mm_shuffle_ps(v4, v5, _MM_SHUFFLE(1, 0, 3, 2));	// f3 c0-3
+				__m128 y0 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(3, 2, 1, 0));	// f0 c4 c5, f1 c4 c5
+				__m128 y1 = _mm_shuffle_ps(v4, v5, _MM_SHUFFLE(3, 2, 1, 0));	// f2 c4 c5, f3 c4 c5
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				_mm_storeu_ps(d + i, r0);
+				_mm_storeu_ps(d + s + i, r1);
+				_mm_storeu_ps(d + s * 2 + i, r2);
+				_mm_storeu_ps(d + s * 3 + i, r3);
+				_mm_storeu_ps(d + s * 4 + i, _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(d + s * 5 + i, _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+		}
+		else
+		if (aSourceChannels == 8 && aDestChannels == 8)
+		{
+			for (; i + 4 <= aFrames; i += 4)
+			{
+				const float *f = aSourceBuffer + i * 8;
+				__m128 a0 = _mm_loadu_ps(f);
+				__m128 b0 = _mm_loadu_ps(f + 4);
+				__m128 a1 = _mm_loadu_ps(f + 8);
+				__m128 b1 = _mm_loadu_ps(f + 12);
+				__m128 a2 = _mm_loadu_ps(f + 16);
+				__m128 b2 = _mm_loadu_ps(f + 20);
+				__m128 a3 = _mm_loadu_ps(f + 24);
+				__m128 b3 = _mm_loadu_ps(f + 28);
+				_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+				_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+				_mm_storeu_ps(d + i, a0);
+				_mm_storeu_ps(d + s + i, a1);
+				_mm_storeu_ps(d + s * 2 + i, a2);
+				_mm_storeu_ps(d + s * 3 + i, a3);
+				_mm_storeu_ps(d + s * 4 + i, b0);
+				_mm_storeu_ps(d + s * 5 + i, b1);
+				_mm_storeu_ps(d + s * 6 + i, b2);
+				_mm_storeu_ps(d + s * 7 + i, b3);
+			}
+		}
+		if (i < aFrames)
+			deinterlace_frames_float_generic(aSourceBuffer + i * aSourceChannels, aDestBuffer + i, aFrames - i, aSourceChannels, aDestChannels, aDestStride);
+#else
+		deinterlace_frames_float_generic(aSourceBuffer, aDestBuffer, aFrames, aSourceChannels, aDestChannels, aDestStride);
+#endif
+	}
+
 	void interlace_samples_float(const float *aSourceBuffer, float *aDestBuffer, unsigned int aSamples, unsigned int aChannels)
 	{
 		// 111222 -> 121212
@@ -2185,7 +2855,9 @@ namespace SoLoud
 	{
 		if (mAudioThreadMutex)
 		{
+			unsigned long long waitstart = Trace::begin();
 			Thread::lockMutex(mAudioThreadMutex);
+			Trace::end("audio mutex wait", waitstart);
 		}
 		SOLOUD_ASSERT(!mInsideAudioThreadMutex);
 		mInsideAudioThreadMutex = true;
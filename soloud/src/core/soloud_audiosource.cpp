@@ -65,6 +65,33 @@ namespace SoLoud
 		mDopplerValue = 1.0f;
 	}
 
+	AudioSourceInstance3dArrays::AudioSourceInstance3dArrays()
+	{
+		for (int i = 0; i < VOICE_COUNT; i++)
+		{
+			mPositionX[i] = 0;
+			mPositionY[i] = 0;
+			mPositionZ[i] = 0;
+			mVelocityX[i] = 0;
+			mVelocityY[i] = 0;
+			mVelocityZ[i] = 0;
+			mMinDistance[i] = 0.0f;
+			mMaxDistance[i] = 1000000.0f;
+			mAttenuationRolloff[i] = 1;
+			mDopplerFactor[i] = 1.0f;
+			mAttenuationModel[i] = 0;
+		}
+	}
+
+	void AudioSourceInstance3dArrays::init(unsigned int aVoice, AudioSource &aSource)
+	{
+		mAttenuationModel[aVoice] = aSource.m3dAttenuationModel;
+		mAttenuationRolloff[aVoice] = aSource.m3dAttenuationRolloff;
+		mDopplerFactor[aVoice] = aSource.m3dDopplerFactor;
+		mMaxDistance[aVoice] = aSource.m3dMaxDistance;
+		mMinDistance[aVoice] = aSource.m3dMinDistance;
+	}
+
 	AudioSourceInstance::AudioSourceInstance()
 	{
 		mPlayIndex = 0;
@@ -74,6 +101,8 @@ namespace SoLoud
 		int i;
 		for (i = 0; i < MAX_CHANNELS; i++)
 			mChannelVolume[i] = 1.0f;		
+		for (i = 0; i < CPU_STAGE_COUNT; i++)
+			mCpuTime[i] = 0;
 		mSetVolume = 1.0f;
 		mBaseSamplerate = 44100.0f;
 		mSamplerate = 44100.0f;
@@ -97,9 +126,13 @@ namespace SoLoud
 		// behind pointers because we swap between the two buffers
 		mResampleData[0] = 0;
 		mResampleData[1] = 0;
+		mResampleDataSilent = 0;
 		mSrcOffset = 0;
 		mLeftoverSamples = 0;
 		mDelaySamples = 0;
+		mSkippedFrame[0] = 0;
+		mSkippedFrame[1] = 0;
+		mSkippedBlocks = 0;
 		mOverallVolume = 0;
 		mOverallRelativePlaySpeed = 1;
 	}
@@ -150,6 +183,35 @@ namespace SoLoud
 		return NOT_IMPLEMENTED;
 	}
 
+	unsigned int AudioSourceInstance::tellFrame()
+	{
+		return NO_FRAME;
+	}
+
+	result AudioSourceInstance::seekFrame(unsigned int /*aFrame*/)
+	{
+		return NOT_IMPLEMENTED;
+	}
+
+	unsigned int AudioSourceInstance::advance(unsigned int aSamples, float *aScratch, unsigned int aScratchSize)
+	{
+		unsigned int chunk = aScratchSize / mChannels;
+		unsigned int done = 0;
+		while (done < aSamples)
+		{
+			unsigned int samples = aSamples - done;
+			if (samples > chunk)
+				samples = chunk;
+			unsigned int read = getAudio(aScratch, samples, samples);
+			done += read;
+			if (read < samples)
+				break;
+		}
+		// Nobody looks at what was produced
+		mFlags &= ~SILENT;
+		return done;
+	}
+
 	result AudioSourceInstance::seek(double aSeconds, float *mScratch, unsigned int mScratchSize)
 	{
 		double offset = aSeconds - mStreamPosition;
@@ -332,6 +394,11 @@ namespace SoLoud
 	    return 0;
 	}
 
+	float AudioSourceInstance::getContentLevel()
+	{
+		return 1;
+	}
+
 
 };
 
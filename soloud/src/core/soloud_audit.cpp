@@ -0,0 +1,431 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#if defined(_WIN32)||defined(_WIN64)
+#include <windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#define AUDIT_BACKTRACE
+#endif
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+#include "soloud.h"
+#include "soloud_audit.h"
+
+#ifdef SOLOUD_AUDIT
+
+// The heap hooks can run before TLS has been set up for a shared library; the
+// initial-exec model needs no allocation to get at it
+#if defined(__GNUC__)
+#define AUDIT_THREAD_LOCAL __attribute__((tls_model("initial-exec"))) thread_local
+#else
+#define AUDIT_THREAD_LOCAL thread_local
+#endif
+
+namespace SoLoud
+{
+	// One call stack; claimed by a compare-exchange on mKey, readable once mReady is set
+	struct AuditSite
+	{
+		std::atomic<unsigned long long> mKey;
+		std::atomic<int> mReady;
+		int mKind;
+		int mFrames;
+		void *mFrame[AUDIT_MAX_FRAMES];
+		std::atomic<unsigned int> mCount;
+		std::atomic<unsigned long long> mBytes;
+	};
+
+	// Zero initialized before any constructor runs, as the heap hooks may be called first
+	static std::atomic<int> gMode(Audit::OFF);
+	static std::atomic<unsigned int> gCount[Audit::KIND_COUNT];
+	static std::atomic<unsigned int> gDropped(0);
+	static AuditSite gSite[AUDIT_MAX_SITES];
+
+	// enter() depth, and set while the audit does its own work so that isn't audited
+	static AUDIT_THREAD_LOCAL int tDepth = 0;
+	static AUDIT_THREAD_LOCAL int tBusy = 0;
+	// Stack frames below the function that called the outermost enter(); left out of
+	// the recorded stacks, so the same mixer call site from different callers is one site
+	static AUDIT_THREAD_LOCAL int tOuterFrames = 0;
+
+	void Audit::setMode(MODE aMode)
+	{
+#if defined(AUDIT_BACKTRACE)
+		// The first backtrace() loads the unwinder, which allocates; get that over with
+		void *frame[2];
+		tBusy++;
+		backtrace(frame, 2);
+		tBusy--;
+#endif
+		gMode.store(aMode);
+	}
+
+	Audit::MODE Audit::getMode()
+	{
+		return (MODE)gMode.load();
+	}
+
+	void Audit::enter()
+	{
+		if (tDepth++ == 0)
+		{
+			tOuterFrames = 0;
+#if defined(AUDIT_BACKTRACE)
+			if (gMode.load(std::memory_order_relaxed) != OFF)
+			{
+				// This frame and the one of the function that called in stay
+				void *frame[256];
+				tBusy++;
+				tOuterFrames = backtrace(frame, 256) - 2;
+				tBusy--;
+			}
+#endif
+		}
+	}
+
+	void Audit::leave()
+	{
+		tDepth--;
+	}
+
+	bool Audit::isAuditing()
+	{
+		return gMode.load(std::memory_order_relaxed) != OFF && tDepth > 0 && !tBusy;
+	}
+
+	void Audit::check(KIND aKind, size_t aBytes)
+	{
+		int mode = gMode.load(std::memory_order_relaxed);
+		if (mode == OFF || tDepth <= 0 || tBusy)
+			return;
+		tBusy++;
+
+		gCount[aKind].fetch_add(1, std::memory_order_relaxed);
+
+		// The stack from the hook that called in (or its caller, once inlined) up
+		void *stack[256];
+		int frames = 0;
+#if defined(AUDIT_BACKTRACE)
+		frames = backtrace(stack, 256) - 1 - tOuterFrames;
+#elif defined(_WIN32)||defined(_WIN64)
+		frames = CaptureStackBackTrace(0, AUDIT_MAX_FRAMES + 1, stack, NULL) - 1;
+#endif
+		if (frames < 0)
+			frames = 0;
+		if (frames > AUDIT_MAX_FRAMES)
+			frames = AUDIT_MAX_FRAMES;
+		void **frame = stack + 1;
+
+		if (mode == ABORT)
+		{
+			if (aBytes)
+				fprintf(stderr, "SoLoud audit: %s of %lu bytes in the mixer\n", getKindName(aKind), (unsigned long)aBytes);
+			else
+				fprintf(stderr, "SoLoud audit: %s in the mixer\n", getKindName(aKind));
+#if defined(AUDIT_BACKTRACE)
+			backtrace_symbols_fd(frame, frames, 2);
+#endif
+			abort();
+		}
+
+		// FNV-1a over the kind and the return addresses
+		unsigned long long key = 14695981039346656037ULL ^ (unsigned long long)aKind;
+		int i;
+		for (i = 0; i < frames; i++)
+			key = (key ^ (unsigned long long)(size_t)frame[i]) * 1099511628211ULL;
+		if (key == 0)
+			key = 1;
+
+		AuditSite *site = 0;
+		for (i = 0; i < AUDIT_MAX_SITES && !site; i++)
+		{
+			AuditSite &s = gSite[(key + i) % AUDIT_MAX_SITES];
+			unsigned long long k = s.mKey.load(std::memory_order_acquire);
+			if (k == 0)
+			{
+				if (s.mKey.compare_exchange_strong(k, key))
+				{
+					s.mKind = aKind;
+					s.mFrames = frames;
+					memcpy(s.mFrame, frame, frames * sizeof(void *));
+					s.mReady.store(1, std::memory_order_release);
+					site = &s;
+					break;
+				}
+			}
+			if (k == key)
+				site = &s;
+		}
+		if (site)
+		{
+			site->mCount.fetch_add(1, std::memory_order_relaxed);
+			site->mBytes.fetch_add(aBytes, std::memory_order_relaxed);
+		}
+		else
+		{
+			gDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		tBusy--;
+	}
+
+	unsigned int Audit::getCount(KIND aKind)
+	{
+		if (aKind >= KIND_COUNT)
+			return 0;
+		return gCount[aKind].load();
+	}
+
+	void Audit::clear()
+	{
+		int i;
+		for (i = 0; i < KIND_COUNT; i++)
+			gCount[i].store(0);
+		gDropped.store(0);
+		for (i = 0; i < AUDIT_MAX_SITES; i++)
+		{
+			gSite[i].mReady.store(0);
+			gSite[i].mCount.store(0);
+			gSite[i].mBytes.store(0);
+			gSite[i].mKey.store(0);
+		}
+	}
+
+	static void printFrame(FILE *aFile, int aIndex, void *aAddress)
+	{
+#if defined(AUDIT_BACKTRACE)
+		Dl_info info;
+		if (dladdr(aAddress, &info) && info.dli_fname)
+		{
+			if (info.dli_sname)
+			{
+				const char *name = info.dli_sname;
+				char *demangled = 0;
+#if defined(__GNUC__)
+				int status = 0;
+				demangled = abi::__cxa_demangle(name, 0, 0, &status);
+				if (status == 0 && demangled)
+					name = demangled;
+#endif
+				fprintf(aFile, "    #%-2d %s+0x%lx\n", aIndex, name, (unsigned long)((char *)aAddress - (char *)info.dli_saddr));
+				free(demangled);
+				return;
+			}
+			// Not exported; module relative, for addr2line -e <module>
+			fprintf(aFile, "    #%-2d %s+0x%lx\n", aIndex, info.dli_fname, (unsigned long)((char *)aAddress - (char *)info.dli_fbase));
+			return;
+		}
+#endif
+		fprintf(aFile, "    #%-2d %p\n", aIndex, aAddress);
+	}
+
+	result Audit::report(const char *aFilename)
+	{
+		FILE *f = aFilename ? fopen(aFilename, "w") : stdout;
+		if (!f)
+			return FILE_NOT_FOUND;
+		tBusy++;
+
+		int i;
+		fprintf(f, "SoLoud mixer audit:");
+		for (i = 0; i < KIND_COUNT; i++)
+			fprintf(f, "%s %s %u", i ? "," : "", getKindName((KIND)i), gCount[i].load());
+		fprintf(f, "\n");
+
+		// Sites by count, highest first
+		int order[AUDIT_MAX_SITES];
+		int sites = 0;
+		for (i = 0; i < AUDIT_MAX_SITES; i++)
+		{
+			if (gSite[i].mReady.load(std::memory_order_acquire) && gSite[i].mCount.load())
+			{
+				int j = sites++;
+				while (j > 0 && gSite[order[j - 1]].mCount.load() < gSite[i].mCount.load())
+				{
+					order[j] = order[j - 1];
+					j--;
+				}
+				order[j] = i;
+			}
+		}
+
+		for (i = 0; i < sites; i++)
+		{
+			AuditSite &s = gSite[order[i]];
+			fprintf(f, "\n%s: %u times", getKindName((KIND)s.mKind), s.mCount.load());
+			if (s.mBytes.load())
+				fprintf(f, ", %llu bytes", s.mBytes.load());
+			fprintf(f, "\n");
+			int j;
+			for (j = 0; j < s.mFrames; j++)
+				printFrame(f, j, s.mFrame[j]);
+			if (!s.mFrames)
+				fprintf(f, "    (no stack)\n");
+		}
+		if (gDropped.load())
+			fprintf(f, "\n%u more at call sites past the first %d\n", gDropped.load(), AUDIT_MAX_SITES);
+
+		tBusy--;
+		if (f != stdout)
+			fclose(f);
+		return SO_NO_ERROR;
+	}
+}
+
+// Heap hooks. They forward to the real allocator, so memory may be freed on either side.
+#if defined(__GLIBC__)
+extern "C"
+{
+	extern void *__libc_malloc(size_t aSize);
+	extern void *__libc_calloc(size_t aCount, size_t aSize);
+	extern void *__libc_realloc(void *aPtr, size_t aSize);
+	extern void __libc_free(void *aPtr);
+
+	void *malloc(size_t aSize) noexcept
+	{
+		SoLoud::Audit::check(SoLoud::Audit::ALLOC, aSize);
+		return __libc_malloc(aSize);
+	}
+
+	void *calloc(size_t aCount, size_t aSize) noexcept
+	{
+		SoLoud::Audit::check(SoLoud::Audit::ALLOC, aCount * aSize);
+		return __libc_calloc(aCount, aSize);
+	}
+
+	void *realloc(void *aPtr, size_t aSize) noexcept
+	{
+		SoLoud::Audit::check(SoLoud::Audit::ALLOC, aSize);
+		return __libc_realloc(aPtr, aSize);
+	}
+
+	void free(void *aPtr) noexcept
+	{
+		if (aPtr)
+			SoLoud::Audit::check(SoLoud::Audit::FREE, 0);
+		__libc_free(aPtr);
+	}
+}
+#else
+void *operator new(size_t aSize)
+{
+	SoLoud::Audit::check(SoLoud::Audit::ALLOC, aSize);
+	void *p = malloc(aSize ? aSize : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t aSize)
+{
+	return operator new(aSize);
+}
+
+void *operator new(size_t aSize, const std::nothrow_t &) noexcept
+{
+	SoLoud::Audit::check(SoLoud::Audit::ALLOC, aSize);
+	return malloc(aSize ? aSize : 1);
+}
+
+void *operator new[](size_t aSize, const std::nothrow_t &aTag) noexcept
+{
+	return operator new(aSize, aTag);
+}
+
+void operator delete(void *aPtr) noexcept
+{
+	if (aPtr)
+		SoLoud::Audit::check(SoLoud::Audit::FREE, 0);
+	free(aPtr);
+}
+
+void operator delete[](void *aPtr) noexcept
+{
+	operator delete(aPtr);
+}
+
+void operator delete(void *aPtr, size_t) noexcept
+{
+	operator delete(aPtr);
+}
+
+void operator delete[](void *aPtr, size_t) noexcept
+{
+	operator delete(aPtr);
+}
+#endif
+
+#else // !SOLOUD_AUDIT
+
+namespace SoLoud
+{
+	void Audit::setMode(MODE /*aMode*/) {}
+	Audit::MODE Audit::getMode() { return OFF; }
+	void Audit::enter() {}
+	void Audit::leave() {}
+	bool Audit::isAuditing() { return false; }
+	void Audit::check(KIND /*aKind*/, size_t /*aBytes*/) {}
+	unsigned int Audit::getCount(KIND /*aKind*/) { return 0; }
+	void Audit::clear() {}
+
+	result Audit::report(const char *aFilename)
+	{
+		FILE *f = aFilename ? fopen(aFilename, "w") : stdout;
+		if (!f)
+			return FILE_NOT_FOUND;
+		fprintf(f, "SoLoud mixer audit: not compiled in, build with SOLOUD_AUDIT defined\n");
+		if (f != stdout)
+			fclose(f);
+		return NOT_IMPLEMENTED;
+	}
+}
+
+#endif
+
+namespace SoLoud
+{
+	const char *Audit::getKindName(KIND aKind)
+	{
+		switch (aKind)
+		{
+		case ALLOC: return "alloc";
+		case FREE: return "free";
+		case LOCK: return "lock";
+		case LOCK_WAIT: return "lock wait";
+		case FILE_IO: return "file io";
+		default: return "?";
+		}
+	}
+}
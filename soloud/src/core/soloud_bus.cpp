@@ -31,7 +31,6 @@ namespace SoLoud
 	BusInstance::BusInstance(Bus *aParent)
 	{
 		mParent = aParent;
-		mScratchSize = 0;
 		mFlags |= PROTECTED | INAUDIBLE_TICK;		
 		for (int i = 0; i < MAX_CHANNELS; i++)
 			mVisualizationChannelVolume[i] = 0;
@@ -42,23 +41,21 @@ namespace SoLoud
 	unsigned int BusInstance::getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
 	{
 		int handle = mParent->mChannelHandle;
-		if (handle == 0) 
-		{
-			// Avoid reuse of scratch data if this bus hasn't played anything yet
-			unsigned int i;
-			for (i = 0; i < aBufferSize * mChannels; i++)
-				aBuffer[i] = 0;
-			return aSamplesToRead;
-		}
-		
 		Soloud *s = mParent->mSoloud;
-		if (s->mScratchNeeded != mScratchSize)
+		bool silent = true;
+
+		// A bus that hasn't played anything yet, or is nested too deep to have a
+		// scratch of its own, is silent.
+		if (handle != 0 && s->mBusDepth < MAX_BUS_DEPTH)
 		{
-			mScratchSize = s->mScratchNeeded;
-			mScratch.init(mScratchSize * MAX_CHANNELS);
+			// Each nesting level mixes in its own slice of the mixer arena
+			s->mBusDepth++;
+			silent = s->mixBus_internal(aBuffer, aSamplesToRead, aBufferSize, s->mBusScratch[s->mBusDepth - 1].mData, handle, mSamplerate, mChannels);
+			s->mBusDepth--;
 		}
-		
-		s->mixBus_internal(aBuffer, aSamplesToRead, aBufferSize, mScratch.mData, handle, mSamplerate, mChannels);
+
+		if (silent)
+			mFlags |= SILENT;
 
 		int i;
 		if (mParent->mFlags & AudioSource::VISUALIZATION_DATA)
@@ -66,7 +63,12 @@ namespace SoLoud
 			for (i = 0; i < MAX_CHANNELS; i++)
 				mVisualizationChannelVolume[i] = 0;
 
-			if (aSamplesToRead > 255)
+			if (silent)
+			{
+				for (i = 0; i < 256; i++)
+					mVisualizationWaveData[i] = 0;
+			}
+			else if (aSamplesToRead > 255)
 			{
 				for (i = 0; i < 256; i++)
 				{
@@ -252,6 +254,8 @@ namespace SoLoud
 			if (aFilter)
 			{
 				mInstance->mFilter[aFilterId] = mFilter[aFilterId]->createInstance();
+				if (mInstance->mFilter[aFilterId])
+					mInstance->mFilter[aFilterId]->mSourceFilter = mFilter[aFilterId];
 			}
 			mSoloud->unlockAudioMutex_internal();
 		}
@@ -25,6 +25,12 @@ freely, subject to the following restrictions:
 #include <math.h>
 #include "soloud_internal.h"
 
+#if defined(SOLOUD_AVX_INTRINSICS)
+#include <immintrin.h>
+#elif defined(SOLOUD_SSE_INTRINSICS)
+#include <xmmintrin.h>
+#endif
+
 // 3d audio operations
 
 namespace SoLoud
@@ -174,6 +180,70 @@ namespace SoLoud
 		return (float)pow(distance / aMinDistance, -aRolloffFactor);
 	}
 
+	// Lanes of voices processed together by update3dVoices_internal
+
+#if defined(SOLOUD_AVX_INTRINSICS)
+#define SOLOUD_3D_LANES 8
+	typedef __m256 lanes;
+	static inline lanes lanesLoad(const float *a) { return _mm256_loadu_ps(a); }
+	static inline void lanesStore(float *a, lanes b) { _mm256_storeu_ps(a, b); }
+	static inline lanes lanesSet(float a) { return _mm256_set1_ps(a); }
+	static inline lanes lanesAdd(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+	static inline lanes lanesSub(lanes a, lanes b) { return _mm256_sub_ps(a, b); }
+	static inline lanes lanesMul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+	static inline lanes lanesDiv(lanes a, lanes b) { return _mm256_div_ps(a, b); }
+	// Same as MIN(a, b) and MAX(a, b), including which operand wins on NaN
+	static inline lanes lanesMin(lanes a, lanes b) { return _mm256_min_ps(a, b); }
+	static inline lanes lanesMax(lanes a, lanes b) { return _mm256_max_ps(a, b); }
+	static inline lanes lanesSqrt(lanes a) { return _mm256_sqrt_ps(a); }
+	// a == b ? c : d per lane
+	static inline lanes lanesSelectEqual(lanes a, lanes b, lanes c, lanes d) { return _mm256_blendv_ps(d, c, _mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+#elif defined(SOLOUD_SSE_INTRINSICS)
+#define SOLOUD_3D_LANES 4
+	typedef __m128 lanes;
+	static inline lanes lanesLoad(const float *a) { return _mm_loadu_ps(a); }
+	static inline void lanesStore(float *a, lanes b) { _mm_storeu_ps(a, b); }
+	static inline lanes lanesSet(float a) { return _mm_set1_ps(a); }
+	static inline lanes lanesAdd(lanes a, lanes b) { return _mm_add_ps(a, b); }
+	static inline lanes lanesSub(lanes a, lanes b) { return _mm_sub_ps(a, b); }
+	static inline lanes lanesMul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+	static inline lanes lanesDiv(lanes a, lanes b) { return _mm_div_ps(a, b); }
+	static inline lanes lanesMin(lanes a, lanes b) { return _mm_min_ps(a, b); }
+	static inline lanes lanesMax(lanes a, lanes b) { return _mm_max_ps(a, b); }
+	static inline lanes lanesSqrt(lanes a) { return _mm_sqrt_ps(a); }
+	static inline lanes lanesSelectEqual(lanes a, lanes b, lanes c, lanes d)
+	{
+		__m128 m = _mm_cmpeq_ps(a, b);
+		return _mm_or_ps(_mm_and_ps(m, c), _mm_andnot_ps(m, d));
+	}
+#else
+#define SOLOUD_3D_LANES 1
+	typedef float lanes;
+	static inline lanes lanesLoad(const float *a) { return *a; }
+	static inline void lanesStore(float *a, lanes b) { *a = b; }
+	static inline lanes lanesSet(float a) { return a; }
+	static inline lanes lanesAdd(lanes a, lanes b) { return a + b; }
+	static inline lanes lanesSub(lanes a, lanes b) { return a - b; }
+	static inline lanes lanesMul(lanes a, lanes b) { return a * b; }
+	static inline lanes lanesDiv(lanes a, lanes b) { return a / b; }
+	static inline lanes lanesMin(lanes a, lanes b) { return MIN(a, b); }
+	static inline lanes lanesMax(lanes a, lanes b) { return MAX(a, b); }
+	static inline lanes lanesSqrt(lanes a) { return (float)sqrt(a); }
+	static inline lanes lanesSelectEqual(lanes a, lanes b, lanes c, lanes d) { return a == b ? c : d; }
+#endif
+
+	// aArray[aVoice[0..SOLOUD_3D_LANES-1]]
+	static inline lanes lanesGather(const float *aArray, const unsigned int *aVoice, bool aContiguous)
+	{
+		if (aContiguous)
+			return lanesLoad(aArray + aVoice[0]);
+		float t[SOLOUD_3D_LANES];
+		int i;
+		for (i = 0; i < SOLOUD_3D_LANES; i++)
+			t[i] = aArray[aVoice[i]];
+		return lanesLoad(t);
+	}
+
 	void Soloud::update3dVoices_internal(unsigned int *aVoiceArray, unsigned int aVoiceCount)
 	{
 		vec3 speaker[MAX_CHANNELS];
@@ -193,19 +263,13 @@ namespace SoLoud
 			speaker[i].mZ = 0;
 		}
 
-		vec3 lpos, lvel, at, up;
+		vec3 at, up;
 		at.mX = m3dAt[0];
 		at.mY = m3dAt[1];
 		at.mZ = m3dAt[2];
 		up.mX = m3dUp[0];
 		up.mY = m3dUp[1];
 		up.mZ = m3dUp[2];
-		lpos.mX = m3dPosition[0];
-		lpos.mY = m3dPosition[1];
-		lpos.mZ = m3dPosition[2];
-		lvel.mX = m3dVelocity[0];
-		lvel.mY = m3dVelocity[1];
-		lvel.mZ = m3dVelocity[2];
 		mat3 m;
 		if (mFlags & LEFT_HANDED_3D)
 		{
@@ -216,88 +280,161 @@ namespace SoLoud
 			m.lookatRH(at, up);
 		}
 
-		for (i = 0; i < (signed)aVoiceCount; i++)
+		const AudioSourceInstance3dArrays &a = m3dArrays;
+		const lanes zero = lanesSet(0);
+		const lanes one = lanesSet(1);
+		const lanes half = lanesSet(0.5f);
+		const lanes soundspeed = lanesSet(m3dSoundSpeed);
+		const lanes lvelx = lanesSet(m3dVelocity[0]);
+		const lanes lvely = lanesSet(m3dVelocity[1]);
+		const lanes lvelz = lanesSet(m3dVelocity[2]);
+		const lanes lposx = lanesSet(m3dPosition[0]);
+		const lanes lposy = lanesSet(m3dPosition[1]);
+		const lanes lposz = lanesSet(m3dPosition[2]);
+
+		// Voices go SOLOUD_3D_LANES at a time, loaded straight from m3dArrays when they
+		// are consecutive. A short last batch repeats its last voice; only the real ones
+		// are written back
+		unsigned int base;
+		for (base = 0; base < aVoiceCount; base += SOLOUD_3D_LANES)
 		{
-			AudioSourceInstance3dData * v = &m3dData[aVoiceArray[i]];
-
-			float vol = 1;
-
-			// custom collider
-			if (v->mCollider)
-			{
-				vol *= v->mCollider->collide(this, v, v->mColliderData);
-			}
-
-			vec3 pos, vel;
-			pos.mX = v->m3dPosition[0];
-			pos.mY = v->m3dPosition[1];
-			pos.mZ = v->m3dPosition[2];
-
-			vel.mX = v->m3dVelocity[0];
-			vel.mY = v->m3dVelocity[1];
-			vel.mZ = v->m3dVelocity[2];
-
-			if (!(v->mFlags & AudioSourceInstance::LISTENER_RELATIVE))
+			unsigned int voice[SOLOUD_3D_LANES];
+			float relative[SOLOUD_3D_LANES], model[SOLOUD_3D_LANES], collider[SOLOUD_3D_LANES];
+			float dist[SOLOUD_3D_LANES], att[SOLOUD_3D_LANES], vol[SOLOUD_3D_LANES], dopplerv[SOLOUD_3D_LANES];
+			float chvol[MAX_CHANNELS][SOLOUD_3D_LANES];
+
+			unsigned int count = aVoiceCount - base;
+			if (count > SOLOUD_3D_LANES)
+				count = SOLOUD_3D_LANES;
+
+			// Colliders and anything else that needs the per voice struct
+			bool contiguous = count == SOLOUD_3D_LANES;
+			bool scalar = false, inverse = false, linear = false;
+			unsigned int l;
+			for (l = 0; l < SOLOUD_3D_LANES; l++)
 			{
-				pos = pos.sub(lpos);
+				unsigned int v = aVoiceArray[base + (l < count ? l : count - 1)];
+				AudioSourceInstance3dData *d = &m3dData[v];
+				voice[l] = v;
+				if (v != voice[0] + l)
+					contiguous = false;
+				relative[l] = (d->mFlags & AudioSourceInstance::LISTENER_RELATIVE) ? 1.0f : 0.0f;
+				model[l] = (float)a.mAttenuationModel[v];
+				collider[l] = 1;
+				if (l < count && d->mCollider)
+				{
+					collider[l] = d->mCollider->collide(this, d, d->mColliderData);
+				}
+				if (d->mAttenuator || a.mAttenuationModel[v] == AudioSource::EXPONENTIAL_DISTANCE)
+					scalar = true;
+				else if (a.mAttenuationModel[v] == AudioSource::INVERSE_DISTANCE)
+					inverse = true;
+				else if (a.mAttenuationModel[v] == AudioSource::LINEAR_DISTANCE)
+					linear = true;
 			}
 
-			float dist = pos.mag();
+			// Relative voices are already around the listener
+			lanes rel = lanesLoad(relative);
+			lanes x = lanesSub(lanesGather(a.mPositionX, voice, contiguous), lanesSelectEqual(rel, one, zero, lposx));
+			lanes y = lanesSub(lanesGather(a.mPositionY, voice, contiguous), lanesSelectEqual(rel, one, zero, lposy));
+			lanes z = lanesSub(lanesGather(a.mPositionZ, voice, contiguous), lanesSelectEqual(rel, one, zero, lposz));
+			lanes distance = lanesSqrt(lanesAdd(lanesAdd(lanesMul(x, x), lanesMul(y, y)), lanesMul(z, z)));
 
-			// attenuation
+			// attenuation; only the models some voice in the batch uses. Exponential and
+			// custom attenuators go per voice below
 
-			if (v->mAttenuator)
+			lanes attenuation = one;
+			if (inverse || linear)
 			{
-				vol *= v->mAttenuator->attenuate(dist, v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
+				lanes mn = lanesGather(a.mMinDistance, voice, contiguous);
+				lanes mx = lanesGather(a.mMaxDistance, voice, contiguous);
+				lanes roll = lanesGather(a.mAttenuationRolloff, voice, contiguous);
+				lanes md = lanesLoad(model);
+				lanes clamped = lanesMin(lanesMax(distance, mn), mx);
+				if (linear)
+				{
+					lanes lin = lanesSub(one, lanesDiv(lanesMul(roll, lanesSub(clamped, mn)), lanesSub(mx, mn)));
+					attenuation = lanesSelectEqual(md, lanesSet((float)AudioSource::LINEAR_DISTANCE), lin, attenuation);
+				}
+				if (inverse)
+				{
+					lanes inv = lanesDiv(mn, lanesAdd(mn, lanesMul(roll, lanesSub(clamped, mn))));
+					attenuation = lanesSelectEqual(md, lanesSet((float)AudioSource::INVERSE_DISTANCE), inv, attenuation);
+				}
 			}
-			else
+			if (scalar)
 			{
-				switch (v->m3dAttenuationModel)
+				lanesStore(dist, distance);
+				lanesStore(att, attenuation);
+				for (l = 0; l < count; l++)
 				{
-				case AudioSource::INVERSE_DISTANCE:
-					vol *= attenuateInvDistance(dist, v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
-					break;
-				case AudioSource::LINEAR_DISTANCE:
-					vol *= attenuateLinearDistance(dist, v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
-					break;
-				case AudioSource::EXPONENTIAL_DISTANCE:
-					vol *= attenuateExponentialDistance(dist, v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
-					break;
-				default:
-					//case AudioSource::NO_ATTENUATION:
-					break;
+					unsigned int v = voice[l];
+					if (m3dData[v].mAttenuator)
+						att[l] = m3dData[v].mAttenuator->attenuate(dist[l], a.mMinDistance[v], a.mMaxDistance[v], a.mAttenuationRolloff[v]);
+					else if (a.mAttenuationModel[v] == AudioSource::EXPONENTIAL_DISTANCE)
+						att[l] = attenuateExponentialDistance(dist[l], a.mMinDistance[v], a.mMaxDistance[v], a.mAttenuationRolloff[v]);
 				}
+				attenuation = lanesLoad(att);
 			}
+			lanes volume = lanesMul(lanesLoad(collider), attenuation);
 
 			// cone
 
 			// (todo) vol *= conev;
 
-			// doppler
-			v->mDopplerValue = doppler(pos, vel, lvel, v->m3dDopplerFactor, m3dSoundSpeed);
+			// doppler, as in doppler(); a voice on top of the listener gets 1
+			lanes f = lanesGather(a.mDopplerFactor, voice, contiguous);
+			lanes vx = lanesGather(a.mVelocityX, voice, contiguous);
+			lanes vy = lanesGather(a.mVelocityY, voice, contiguous);
+			lanes vz = lanesGather(a.mVelocityZ, voice, contiguous);
+			lanes vls = lanesDiv(lanesAdd(lanesAdd(lanesMul(x, lvelx), lanesMul(y, lvely)), lanesMul(z, lvelz)), distance);
+			lanes vss = lanesDiv(lanesAdd(lanesAdd(lanesMul(x, vx), lanesMul(y, vy)), lanesMul(z, vz)), distance);
+			lanes maxspeed = lanesDiv(soundspeed, f);
+			vss = lanesMin(vss, maxspeed);
+			vls = lanesMin(vls, maxspeed);
+			lanes dop = lanesDiv(lanesSub(soundspeed, lanesMul(f, vls)), lanesSub(soundspeed, lanesMul(f, vss)));
+			dop = lanesSelectEqual(distance, zero, one, dop);
 
 			// panning
-			pos = m.mul(pos);
-			pos.normalize();
+			lanes rx = lanesAdd(lanesAdd(lanesMul(lanesSet(m.m[0].mX), x), lanesMul(lanesSet(m.m[0].mY), y)), lanesMul(lanesSet(m.m[0].mZ), z));
+			lanes ry = lanesAdd(lanesAdd(lanesMul(lanesSet(m.m[1].mX), x), lanesMul(lanesSet(m.m[1].mY), y)), lanesMul(lanesSet(m.m[1].mZ), z));
+			lanes rz = lanesAdd(lanesAdd(lanesMul(lanesSet(m.m[2].mX), x), lanesMul(lanesSet(m.m[2].mY), y)), lanesMul(lanesSet(m.m[2].mZ), z));
+			lanes rmag = lanesSqrt(lanesAdd(lanesAdd(lanesMul(rx, rx), lanesMul(ry, ry)), lanesMul(rz, rz)));
+			rx = lanesSelectEqual(rmag, zero, zero, lanesDiv(rx, rmag));
+			ry = lanesSelectEqual(rmag, zero, zero, lanesDiv(ry, rmag));
+			rz = lanesSelectEqual(rmag, zero, zero, lanesDiv(rz, rmag));
 
 			// Apply volume to channels based on speaker vectors
 			int j;
 			for (j = 0; j < (signed)mChannels; j++)
 			{
-				float speakervol = (speaker[j].dot(pos) + 1) / 2;
 				if (speaker[j].null())
-					speakervol = 1;
-				// Different speaker "focus" calculations to try, if the default "bleeds" too much..
-				//speakervol = (speakervol * speakervol + speakervol) / 2;
-				//speakervol = speakervol * speakervol;
-				v->mChannelVolume[j] = vol * speakervol;
+				{
+					lanesStore(chvol[j], volume);
+					continue;
+				}
+				lanes dot = lanesAdd(lanesAdd(lanesMul(lanesSet(speaker[j].mX), rx), lanesMul(lanesSet(speaker[j].mY), ry)), lanesMul(lanesSet(speaker[j].mZ), rz));
+				// Dividing by 2 and multiplying by 0.5 round the same
+				lanes speakervol = lanesMul(lanesAdd(dot, one), half);
+				lanesStore(chvol[j], lanesMul(volume, speakervol));
 			}
-			for (; j < MAX_CHANNELS; j++)
+
+			lanesStore(vol, volume);
+			lanesStore(dopplerv, dop);
+			for (l = 0; l < count; l++)
 			{
-				v->mChannelVolume[j] = 0;
+				AudioSourceInstance3dData *v = &m3dData[voice[l]];
+				v->mDopplerValue = dopplerv[l];
+				for (j = 0; j < (signed)mChannels; j++)
+				{
+					v->mChannelVolume[j] = chvol[j][l];
+				}
+				for (; j < MAX_CHANNELS; j++)
+				{
+					v->mChannelVolume[j] = 0;
+				}
+				v->m3dVolume = vol[l];
 			}
-
-			v->m3dVolume = vol;
 		}
 	}
 
@@ -577,12 +714,12 @@ namespace SoLoud
 	void Soloud::set3dSourceParameters(handle aVoiceHandle, float aPosX, float aPosY, float aPosZ, float aVelocityX, float aVelocityY, float aVelocityZ)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dPosition[0] = aPosX;
-			m3dData[ch].m3dPosition[1] = aPosY;
-			m3dData[ch].m3dPosition[2] = aPosZ;
-			m3dData[ch].m3dVelocity[0] = aVelocityX;
-			m3dData[ch].m3dVelocity[1] = aVelocityY;
-			m3dData[ch].m3dVelocity[2] = aVelocityZ;
+			m3dArrays.mPositionX[ch] = m3dData[ch].m3dPosition[0] = aPosX;
+			m3dArrays.mPositionY[ch] = m3dData[ch].m3dPosition[1] = aPosY;
+			m3dArrays.mPositionZ[ch] = m3dData[ch].m3dPosition[2] = aPosZ;
+			m3dArrays.mVelocityX[ch] = m3dData[ch].m3dVelocity[0] = aVelocityX;
+			m3dArrays.mVelocityY[ch] = m3dData[ch].m3dVelocity[1] = aVelocityY;
+			m3dArrays.mVelocityZ[ch] = m3dData[ch].m3dVelocity[2] = aVelocityZ;
 		FOR_ALL_VOICES_POST_3D
 	}
 
@@ -590,9 +727,9 @@ namespace SoLoud
 	void Soloud::set3dSourcePosition(handle aVoiceHandle, float aPosX, float aPosY, float aPosZ)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dPosition[0] = aPosX;
-			m3dData[ch].m3dPosition[1] = aPosY;
-			m3dData[ch].m3dPosition[2] = aPosZ;
+			m3dArrays.mPositionX[ch] = m3dData[ch].m3dPosition[0] = aPosX;
+			m3dArrays.mPositionY[ch] = m3dData[ch].m3dPosition[1] = aPosY;
+			m3dArrays.mPositionZ[ch] = m3dData[ch].m3dPosition[2] = aPosZ;
 		FOR_ALL_VOICES_POST_3D
 	}
 
@@ -600,9 +737,9 @@ namespace SoLoud
 	void Soloud::set3dSourceVelocity(handle aVoiceHandle, float aVelocityX, float aVelocityY, float aVelocityZ)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dVelocity[0] = aVelocityX;
-			m3dData[ch].m3dVelocity[1] = aVelocityY;
-			m3dData[ch].m3dVelocity[2] = aVelocityZ;
+			m3dArrays.mVelocityX[ch] = m3dData[ch].m3dVelocity[0] = aVelocityX;
+			m3dArrays.mVelocityY[ch] = m3dData[ch].m3dVelocity[1] = aVelocityY;
+			m3dArrays.mVelocityZ[ch] = m3dData[ch].m3dVelocity[2] = aVelocityZ;
 		FOR_ALL_VOICES_POST_3D
 	}
 
@@ -610,8 +747,8 @@ namespace SoLoud
 	void Soloud::set3dSourceMinMaxDistance(handle aVoiceHandle, float aMinDistance, float aMaxDistance)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dMinDistance = aMinDistance;
-			m3dData[ch].m3dMaxDistance = aMaxDistance;
+			m3dArrays.mMinDistance[ch] = m3dData[ch].m3dMinDistance = aMinDistance;
+			m3dArrays.mMaxDistance[ch] = m3dData[ch].m3dMaxDistance = aMaxDistance;
 		FOR_ALL_VOICES_POST_3D
 	}
 
@@ -619,8 +756,8 @@ namespace SoLoud
 	void Soloud::set3dSourceAttenuation(handle aVoiceHandle, unsigned int aAttenuationModel, float aAttenuationRolloffFactor)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dAttenuationModel = aAttenuationModel;
-			m3dData[ch].m3dAttenuationRolloff = aAttenuationRolloffFactor;
+			m3dArrays.mAttenuationModel[ch] = m3dData[ch].m3dAttenuationModel = aAttenuationModel;
+			m3dArrays.mAttenuationRolloff[ch] = m3dData[ch].m3dAttenuationRolloff = aAttenuationRolloffFactor;
 		FOR_ALL_VOICES_POST_3D
 	}
 
@@ -628,7 +765,7 @@ namespace SoLoud
 	void Soloud::set3dSourceDopplerFactor(handle aVoiceHandle, float aDopplerFactor)
 	{
 		FOR_ALL_VOICES_PRE_3D
-			m3dData[ch].m3dDopplerFactor = aDopplerFactor;
+			m3dArrays.mDopplerFactor[ch] = m3dData[ch].m3dDopplerFactor = aDopplerFactor;
 		FOR_ALL_VOICES_POST_3D
 	}
 };
@@ -24,6 +24,7 @@ freely, subject to the following restrictions:
 
 #include <string.h>
 #include "soloud_internal.h"
+#include "soloud_renderahead.h"
 
 // Core "basic" operations - play, stop, etc
 
@@ -60,6 +61,7 @@ namespace SoLoud
 		mVoice[ch]->mBusHandle = aBus;
 		mVoice[ch]->init(aSound, mPlayIndex);
 		m3dData[ch].init(aSound);
+		m3dArrays.init(ch, aSound);
 
 		mPlayIndex++;
 
@@ -98,9 +100,16 @@ namespace SoLoud
 			if (aSound.mFilter[i])
 			{
 				mVoice[ch]->mFilter[i] = aSound.mFilter[i]->createInstance();
+				if (mVoice[ch]->mFilter[i])
+					mVoice[ch]->mFilter[i]->mSourceFilter = aSound.mFilter[i];
 			}
 		}
 
+		// The render-ahead thread is anywhere up to a ring ahead of the device; delay the
+		// start so the sound is heard a fixed lookahead after this call instead
+		if (mRenderAhead && mRenderAhead->isRunning())
+			mVoice[ch]->mDelaySamples = mRenderAhead->getCommandDelay(mSamplerate);
+
 		mActiveVoiceDirty = true;
 
 		unlockAudioMutex_internal();
@@ -125,7 +134,12 @@ namespace SoLoud
 		// Make sure we don't delay too much (or overflow)
 		if (samples < 0 || samples > 2048)		
 			samples = 0;
-		setDelaySamples(h, samples);
+		// On top of the render-ahead delay play() may have set
+		lockAudioMutex_internal();
+		int ch = getVoiceFromHandle_internal(h);
+		if (ch >= 0)
+			mVoice[ch]->mDelaySamples += samples;
+		unlockAudioMutex_internal();
 		setPause(h, 0);
 		return h;
 	}
@@ -23,6 +23,9 @@ freely, subject to the following restrictions:
 */
 
 #include "soloud.h"
+#include "soloud_profiler.h"
+#include "soloud_renderahead.h"
+#include "soloud_trace.h"
 
 // Getters - return information about SoLoud state
 
@@ -33,6 +36,19 @@ namespace SoLoud
 		return SOLOUD_VERSION;
 	}
 
+	result Soloud::getProfile(Profile &aProfile)
+	{
+		if (!mProfiler)
+			return INVALID_PARAMETER;
+		mProfiler->get(aProfile);
+		return SO_NO_ERROR;
+	}
+
+	result Soloud::saveTrace(const char *aFilename)
+	{
+		return Trace::save(aFilename);
+	}
+
 	float Soloud::getPostClipScaler() const
 	{
 		return mPostClipScaler;
@@ -76,6 +92,16 @@ namespace SoLoud
 		return mMaxActiveVoices;
 	}
 
+	unsigned int Soloud::getRealtimeStatus() const
+	{
+		return mRealtimeStatus.load(std::memory_order_acquire);
+	}
+
+	unsigned int Soloud::getRenderAheadUnderrunCount() const
+	{
+		return mRenderAhead ? mRenderAhead->getUnderrunCount() : 0;
+	}
+
 	unsigned int Soloud::getActiveVoiceCount()
 	{
 		lockAudioMutex_internal();
@@ -161,6 +187,40 @@ namespace SoLoud
 		return v;
 	}
 
+	time Soloud::getVoiceCpuTime(handle aVoiceHandle, unsigned int aStage)
+	{
+		lockAudioMutex_internal();
+		int ch = getVoiceFromHandle_internal(aVoiceHandle);
+		if (ch == -1)
+		{
+			unlockAudioMutex_internal();
+			return 0;
+		}
+		unsigned long long ns = 0;
+		unsigned int i;
+		for (i = 0; i < AudioSourceInstance::CPU_STAGE_COUNT; i++)
+		{
+			if (aStage == i || aStage >= AudioSourceInstance::CPU_STAGE_COUNT)
+				ns += mVoice[ch]->mCpuTime[i];
+		}
+		unlockAudioMutex_internal();
+		return ns * 1e-9;
+	}
+
+	time Soloud::getSourceCpuTime(AudioSource &aSound, unsigned int aStage)
+	{
+		if (!mProfiler)
+			return 0;
+		return mProfiler->getSourceTime(aSound.mAudioSourceID, aStage);
+	}
+
+	time Soloud::getFilterCpuTime(Filter &aFilter)
+	{
+		if (!mProfiler)
+			return 0;
+		return mProfiler->getFilterTime(&aFilter);
+	}
+
 	float Soloud::getVolume(handle aVoiceHandle)
 	{
 		lockAudioMutex_internal();
@@ -23,6 +23,8 @@ freely, subject to the following restrictions:
 */
 
 #include "soloud_internal.h"
+#include "soloud_profiler.h"
+#include "soloud_trace.h"
 
 // Setters - set various bits of SoLoud state
 
@@ -68,20 +70,13 @@ namespace SoLoud
 	{
 		if (aVoiceCount == 0 || aVoiceCount >= VOICE_COUNT)
 			return INVALID_PARAMETER;
-		lockAudioMutex_internal();
-		mMaxActiveVoices = aVoiceCount;
-		delete[] mResampleData;
-		delete[] mResampleDataOwner;
-		mResampleData = new AlignedFloatBuffer[aVoiceCount * 2];
-		mResampleDataOwner = new AudioSourceInstance*[aVoiceCount];
-		unsigned int i;
-		for (i = 0; i < aVoiceCount * 2; i++)
-			mResampleData[i].init(SAMPLE_GRANULARITY * MAX_CHANNELS);
-		for (i = 0; i < aVoiceCount; i++)
-			mResampleDataOwner[i] = NULL;
-		mActiveVoiceDirty = true;
-		unlockAudioMutex_internal();
-		return SO_NO_ERROR;
+		if (mScratchSize == 0)
+		{
+			// Not initialized yet; the arena is allocated in postinit.
+			mMaxActiveVoices = aVoiceCount;
+			return SO_NO_ERROR;
+		}
+		return initArena_internal(aVoiceCount);
 	}
 
 	void Soloud::setPauseAll(bool aPause)
@@ -210,6 +205,98 @@ namespace SoLoud
 		}
 	}
 
+	void Soloud::setLoudnessVoiceSelection(bool aEnable)
+	{
+		lockAudioMutex_internal();
+		mLoudnessVoiceSelection = aEnable;
+		mActiveVoiceDirty = true;
+		unlockAudioMutex_internal();
+	}
+
+	void Soloud::setProfilingEnable(bool aEnable)
+	{
+		lockAudioMutex_internal();
+		if (aEnable)
+		{
+			if (!mProfiler)
+				mProfiler = new Profiler;
+			mFlags |= ENABLE_PROFILING;
+		}
+		else
+		{
+			mFlags &= ~ENABLE_PROFILING;
+		}
+		unlockAudioMutex_internal();
+	}
+
+	void Soloud::setVoiceProfilingEnable(bool aEnable)
+	{
+		lockAudioMutex_internal();
+		if (aEnable)
+		{
+			if (!mProfiler)
+				mProfiler = new Profiler;
+			mFlags |= ENABLE_VOICE_PROFILING;
+		}
+		else
+		{
+			mFlags &= ~ENABLE_VOICE_PROFILING;
+		}
+		unlockAudioMutex_internal();
+	}
+
+	result Soloud::setRealtimeParameters(int aPriority, int aCpu)
+	{
+		if (aPriority < 1 || aPriority > 99 || aCpu < -1)
+			return INVALID_PARAMETER;
+		lockAudioMutex_internal();
+		mRealtimePriority = aPriority;
+		mRealtimeCpu = aCpu;
+		mRealtimeGeneration.fetch_add(1, std::memory_order_release);
+		unlockAudioMutex_internal();
+		return SO_NO_ERROR;
+	}
+
+	result Soloud::setRenderAhead(unsigned int aPeriods, unsigned int aPeriodSize)
+	{
+		if (aPeriods > 8)
+			return INVALID_PARAMETER;
+		mRenderAheadPeriods = aPeriods;
+		mRenderAheadPeriodSize = aPeriodSize;
+		return SO_NO_ERROR;
+	}
+
+	void Soloud::setTraceEnable(bool aEnable)
+	{
+		Trace::setEnable(aEnable);
+	}
+
+	void Soloud::resetProfile()
+	{
+		// Under the mutex, so no block is half recorded
+		lockAudioMutex_internal();
+		if (mProfiler)
+			mProfiler->reset();
+		unsigned int i, j;
+		for (i = 0; i < mHighestVoice; i++)
+		{
+			if (mVoice[i])
+			{
+				for (j = 0; j < AudioSourceInstance::CPU_STAGE_COUNT; j++)
+					mVoice[i]->mCpuTime[j] = 0;
+			}
+		}
+		unlockAudioMutex_internal();
+	}
+
+	result Soloud::setProfileDump(time aInterval)
+	{
+		if (!mProfiler)
+			return INVALID_PARAMETER;
+		mProfiler->setDump(aInterval);
+		return SO_NO_ERROR;
+	}
+
 	result Soloud::setSpeakerPosition(unsigned int aChannel, float aX, float aY, float aZ)
 	{
 		if (aChannel >= mChannels)
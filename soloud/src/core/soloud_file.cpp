@@ -27,8 +27,18 @@ distribution.
 
 #include <stdio.h>
 #include <string.h>
+#if defined(_WIN32)||defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "soloud.h"
 #include "soloud_file.h"
+#include "soloud_audit.h"
 
 namespace SoLoud
 {
@@ -56,11 +66,13 @@ namespace SoLoud
 DiskFile::DiskFile(FILE *fp):
 mFileHandle(fp)
 {
-
+	mLength = 0;
+	mLengthKnown = false;
 }
 
 	unsigned int DiskFile::read(unsigned char *aDst, unsigned int aBytes)
 	{
+		SOLOUD_AUDIT_CHECK(FILE_IO, aBytes);
 		return (unsigned int)fread(aDst, 1, aBytes, mFileHandle);
 	}
 
@@ -68,15 +80,21 @@ mFileHandle(fp)
 	{
 		if (!mFileHandle)
 			return 0;
-		unsigned int pos = (unsigned int)ftell(mFileHandle);
-		fseek(mFileHandle, 0, SEEK_END);
-		unsigned int len = (unsigned int)ftell(mFileHandle);
-		fseek(mFileHandle, pos, SEEK_SET);
-		return len;
+		if (!mLengthKnown)
+		{
+			SOLOUD_AUDIT_CHECK(FILE_IO, 0);
+			unsigned int pos = (unsigned int)ftell(mFileHandle);
+			fseek(mFileHandle, 0, SEEK_END);
+			mLength = (unsigned int)ftell(mFileHandle);
+			fseek(mFileHandle, pos, SEEK_SET);
+			mLengthKnown = true;
+		}
+		return mLength;
 	}
 
 	void DiskFile::seek(int aOffset)
 	{
+		SOLOUD_AUDIT_CHECK(FILE_IO, 0);
 		fseek(mFileHandle, aOffset, SEEK_SET);
 	}
 
@@ -99,12 +117,18 @@ mFileHandle(fp)
 	DiskFile::DiskFile()
 	{
 		mFileHandle = 0;
+		mLength = 0;
+		mLengthKnown = false;
 	}
 
 	result DiskFile::open(const char *aFilename)
 	{
 		if (!aFilename)
 			return INVALID_PARAMETER;
+		if (mFileHandle)
+			fclose(mFileHandle);
+		mLengthKnown = false;
+		SOLOUD_AUDIT_CHECK(FILE_IO, 0);
 		mFileHandle = fopen(aFilename, "rb");
 		if (!mFileHandle)
 			return FILE_NOT_FOUND;
@@ -242,6 +266,152 @@ mFileHandle(fp)
 			return 1;
 		return 0;
 	}
+
+	MappedFile::MappedFile()
+	{
+		mDataPtr = 0;
+		mDataLength = 0;
+		mOffset = 0;
+		mFileHandle = 0;
+		mMapHandle = 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	void MappedFile::close()
+	{
+#if defined(_WIN32)||defined(_WIN64)
+		if (mDataPtr)
+			UnmapViewOfFile(mDataPtr);
+		if (mMapHandle)
+			CloseHandle((HANDLE)mMapHandle);
+		if (mFileHandle)
+			CloseHandle((HANDLE)mFileHandle);
+#else
+		if (mDataPtr)
+			munmap((void *)mDataPtr, mDataLength);
+#endif
+		mDataPtr = 0;
+		mDataLength = 0;
+		mOffset = 0;
+		mFileHandle = 0;
+		mMapHandle = 0;
+	}
+
+	result MappedFile::open(const char *aFilename)
+	{
+		if (!aFilename)
+			return INVALID_PARAMETER;
+		close();
+
+#if defined(_WIN32)||defined(_WIN64)
+		HANDLE fh = CreateFileA(aFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (fh == INVALID_HANDLE_VALUE)
+			return FILE_NOT_FOUND;
+		mFileHandle = (void *)fh;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(fh, &size) || size.QuadPart == 0 || size.QuadPart > 0xffffffff)
+		{
+			close();
+			return FILE_LOAD_FAILED;
+		}
+
+		HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mh)
+		{
+			close();
+			return FILE_LOAD_FAILED;
+		}
+		mMapHandle = (void *)mh;
+
+		mDataPtr = (const unsigned char *)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+		if (!mDataPtr)
+		{
+			close();
+			return FILE_LOAD_FAILED;
+		}
+		mDataLength = (unsigned int)size.QuadPart;
+#else
+		int fd = ::open(aFilename, O_RDONLY);
+		if (fd < 0)
+			return FILE_NOT_FOUND;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0 || (unsigned long long)st.st_size > 0xffffffffULL)
+		{
+			::close(fd);
+			return FILE_LOAD_FAILED;
+		}
+
+		void *p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file
+		::close(fd);
+		if (p == MAP_FAILED)
+			return FILE_LOAD_FAILED;
+
+		mDataPtr = (const unsigned char *)p;
+		mDataLength = (unsigned int)st.st_size;
+
+		// Loaders decode front to back right after opening, so ask for
+		// aggressive readahead and get the paging started now.
+#if defined(MADV_SEQUENTIAL)
+		madvise(p, mDataLength, MADV_SEQUENTIAL);
+#endif
+#if defined(MADV_WILLNEED)
+		madvise(p, mDataLength, MADV_WILLNEED);
+#endif
+#endif
+		return SO_NO_ERROR;
+	}
+
+	unsigned int MappedFile::read(unsigned char *aDst, unsigned int aBytes)
+	{
+		if (mOffset >= mDataLength)
+			return 0;
+		if (aBytes > mDataLength - mOffset)
+			aBytes = mDataLength - mOffset;
+
+		memcpy(aDst, mDataPtr + mOffset, aBytes);
+		mOffset += aBytes;
+
+		return aBytes;
+	}
+
+	unsigned int MappedFile::length()
+	{
+		return mDataLength;
+	}
+
+	void MappedFile::seek(int aOffset)
+	{
+		if (aOffset >= 0)
+			mOffset = aOffset;
+		else
+			mOffset = mDataLength + aOffset;
+		if (mOffset > mDataLength)
+			mOffset = mDataLength;
+	}
+
+	unsigned int MappedFile::pos()
+	{
+		return mOffset;
+	}
+
+	const unsigned char * MappedFile::getMemPtr()
+	{
+		return mDataPtr;
+	}
+
+	int MappedFile::eof()
+	{
+		if (mOffset >= mDataLength)
+			return 1;
+		return 0;
+	}
 }
 
 extern "C"
@@ -66,6 +66,8 @@ namespace SoLoud
 		mParamChanged = 0;
 		mParam = 0;
 		mParamFader = 0;
+		mSilentSamples = 0;
+		mSourceFilter = 0;
 	}
 
 	result FilterInstance::initParams(int aNumParams)
@@ -159,6 +161,33 @@ namespace SoLoud
 		}
 	}
 
+	unsigned int FilterInstance::getTailSamples(float /*aSamplerate*/)
+	{
+		return TAIL_INFINITE;
+	}
+
+	bool FilterInstance::needsProcessing_internal(bool aSilent, unsigned int aSamples, float aSamplerate)
+	{
+		if (!aSilent)
+		{
+			mSilentSamples = 0;
+			return true;
+		}
+
+		unsigned int tail = getTailSamples(aSamplerate);
+		if (tail == TAIL_INFINITE)
+			return true;
+		if (mSilentSamples >= tail)
+			return false;
+
+		// Still ringing out; saturate instead of wrapping around
+		if (mSilentSamples + aSamples < mSilentSamples)
+			mSilentSamples = TAIL_INFINITE - 1;
+		else
+			mSilentSamples += aSamples;
+		return true;
+	}
+
 	void FilterInstance::filterChannel(float * /*aBuffer*/, unsigned int /*aSamples*/, float /*aSamplerate*/, double /*aTime*/, unsigned int /*aChannel*/, unsigned int /*aChannels*/)
 	{
 	}
@@ -0,0 +1,349 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "soloud.h"
+#include "soloud_filter.h"
+#include "soloud_profiler.h"
+
+namespace SoLoud
+{
+	static unsigned int bucketIndex(unsigned long long aValue)
+	{
+		if (aValue < (1 << PROFILE_SUB_BITS))
+			return (unsigned int)aValue;
+		if (aValue >> PROFILE_MAX_BITS)
+			return PROFILE_BUCKETS - 1;
+		unsigned int msb = 0;
+		unsigned long long v = aValue;
+		while (v >>= 1)
+			msb++;
+		unsigned int shift = msb - PROFILE_SUB_BITS;
+		return (shift << PROFILE_SUB_BITS) + (unsigned int)(aValue >> shift);
+	}
+
+	static unsigned long long bucketUpperBound(unsigned int aIndex)
+	{
+		if (aIndex < (2 << PROFILE_SUB_BITS))
+			return aIndex;
+		unsigned int shift = (aIndex >> PROFILE_SUB_BITS) - 1;
+		unsigned long long top = (aIndex & ((1 << PROFILE_SUB_BITS) - 1)) + (1 << PROFILE_SUB_BITS);
+		return ((top + 1) << shift) - 1;
+	}
+
+	ProfileHistogram::ProfileHistogram()
+	{
+		reset();
+	}
+
+	void ProfileHistogram::record(unsigned long long aValue)
+	{
+		// Single writer, so plain load/store pairs are enough
+		std::atomic<unsigned int> &b = mBucket[bucketIndex(aValue)];
+		b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		mCount.store(mCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		mSum.store(mSum.load(std::memory_order_relaxed) + aValue, std::memory_order_relaxed);
+		if (aValue > mMax.load(std::memory_order_relaxed))
+			mMax.store(aValue, std::memory_order_relaxed);
+	}
+
+	void ProfileHistogram::reset()
+	{
+		int i;
+		for (i = 0; i < PROFILE_BUCKETS; i++)
+			mBucket[i].store(0, std::memory_order_relaxed);
+		mCount.store(0, std::memory_order_relaxed);
+		mSum.store(0, std::memory_order_relaxed);
+		mMax.store(0, std::memory_order_relaxed);
+	}
+
+	unsigned long long ProfileHistogram::percentile(double aFraction) const
+	{
+		unsigned long long count = 0;
+		int i;
+		for (i = 0; i < PROFILE_BUCKETS; i++)
+			count += mBucket[i].load(std::memory_order_relaxed);
+		if (count == 0)
+			return 0;
+		unsigned long long target = (unsigned long long)(aFraction * count + 0.999999);
+		if (target < 1)
+			target = 1;
+		unsigned long long max = mMax.load(std::memory_order_relaxed);
+		unsigned long long seen = 0;
+		for (i = 0; i < PROFILE_BUCKETS; i++)
+		{
+			seen += mBucket[i].load(std::memory_order_relaxed);
+			if (seen >= target)
+			{
+				unsigned long long v = bucketUpperBound(i);
+				return v < max ? v : max;
+			}
+		}
+		return max;
+	}
+
+	static void getStats(const ProfileHistogram &aHistogram, double aScale, ProfileStats &aStats)
+	{
+		aStats.mCount = aHistogram.mCount.load(std::memory_order_relaxed);
+		aStats.mMean = aStats.mCount ? aHistogram.mSum.load(std::memory_order_relaxed) * aScale / aStats.mCount : 0;
+		aStats.mP50 = aHistogram.percentile(0.5) * aScale;
+		aStats.mP99 = aHistogram.percentile(0.99) * aScale;
+		aStats.mMax = aHistogram.mMax.load(std::memory_order_relaxed) * aScale;
+	}
+
+	static void resetSlots(ProfileCpuSlot *aSlot, unsigned int aCount)
+	{
+		unsigned int i, j;
+		for (i = 0; i < aCount; i++)
+		{
+			aSlot[i].mKey.store(0, std::memory_order_relaxed);
+			for (j = 0; j < AudioSourceInstance::CPU_STAGE_COUNT; j++)
+				aSlot[i].mTime[j].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// aCount is a power of two; aSlot[aCount] is the overflow slot. Returns NULL for a
+	// key that isn't there when not inserting.
+	static ProfileCpuSlot *findSlot(ProfileCpuSlot *aSlot, unsigned int aCount, unsigned long long aKey, bool aInsert)
+	{
+		unsigned int i = (unsigned int)((aKey * 0x9e3779b97f4a7c15ULL) >> 40) & (aCount - 1);
+		unsigned int n;
+		for (n = 0; n < aCount; n++, i = (i + 1) & (aCount - 1))
+		{
+			unsigned long long key = aSlot[i].mKey.load(std::memory_order_acquire);
+			if (key == aKey)
+				return &aSlot[i];
+			if (key == 0)
+			{
+				if (!aInsert)
+					return 0;
+				aSlot[i].mKey.store(aKey, std::memory_order_release);
+				return &aSlot[i];
+			}
+		}
+		return aInsert ? &aSlot[aCount] : 0;
+	}
+
+	static void addTime(std::atomic<unsigned long long> &aTime, unsigned long long aValue)
+	{
+		// Single writer, as with the histograms
+		aTime.store(aTime.load(std::memory_order_relaxed) + aValue, std::memory_order_relaxed);
+	}
+
+	static time slotTime(const ProfileCpuSlot *aSlot, unsigned int aStage)
+	{
+		if (!aSlot)
+			return 0;
+		unsigned long long ns = 0;
+		unsigned int i;
+		for (i = 0; i < AudioSourceInstance::CPU_STAGE_COUNT; i++)
+		{
+			if (aStage == i || aStage >= AudioSourceInstance::CPU_STAGE_COUNT)
+				ns += aSlot->mTime[i].load(std::memory_order_relaxed);
+		}
+		return ns * 1e-9;
+	}
+
+	static void dumpThread(void *aParam)
+	{
+		Profiler *p = (Profiler *)aParam;
+		char text[2048];
+		for (;;)
+		{
+			int waited = 0;
+			int interval;
+			// Sleep in short steps so turning the dump off doesn't hang around
+			while ((interval = p->mDumpIntervalMs.load()) > 0 && waited < interval)
+			{
+				Thread::sleep(10);
+				waited += 10;
+			}
+			if (interval <= 0)
+				break;
+			p->format(text, sizeof(text));
+			fputs(text, stderr);
+			fflush(stderr);
+		}
+	}
+
+	Profiler::Profiler()
+	{
+		mDumpThread = 0;
+		mDumpIntervalMs.store(0);
+		resetSlots(mSource, PROFILE_SOURCE_SLOTS + 1);
+		resetSlots(mFilter, PROFILE_FILTER_SLOTS + 1);
+	}
+
+	Profiler::~Profiler()
+	{
+		setDump(0);
+	}
+
+	unsigned long long Profiler::now()
+	{
+		return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	const char *Profiler::getStageName(unsigned int aStage)
+	{
+		static const char * const names[PROFILE_STAGE_COUNT] =
+		{
+			"faders", "active voices", "mix buses", "global filters", "clip", "visualization", "block"
+		};
+		return aStage < PROFILE_STAGE_COUNT ? names[aStage] : "";
+	}
+
+	unsigned long long Profiler::lap(unsigned int aStage, unsigned long long aStart)
+	{
+		unsigned long long t = now();
+		mStage[aStage].record(t - aStart);
+		return t;
+	}
+
+	void Profiler::block(unsigned long long aStart, unsigned int aSamples, unsigned int aSamplerate)
+	{
+		unsigned long long ns = now() - aStart;
+		mStage[PROFILE_BLOCK].record(ns);
+		if (aSamples && aSamplerate)
+			mLoad.record(ns * aSamplerate / (aSamples * 100000ULL));
+	}
+
+	void Profiler::reset()
+	{
+		int i;
+		for (i = 0; i < PROFILE_STAGE_COUNT; i++)
+			mStage[i].reset();
+		mLoad.reset();
+		resetSlots(mSource, PROFILE_SOURCE_SLOTS + 1);
+		resetSlots(mFilter, PROFILE_FILTER_SLOTS + 1);
+	}
+
+	void Profiler::get(Profile &aProfile) const
+	{
+		int i;
+		for (i = 0; i < PROFILE_STAGE_COUNT; i++)
+			getStats(mStage[i], 1e-3, aProfile.mStage[i]);
+		getStats(mLoad, 1e-4, aProfile.mLoad);
+	}
+
+	unsigned int Profiler::format(char *aBuffer, unsigned int aSize) const
+	{
+		if (!aBuffer || aSize == 0)
+			return 0;
+		Profile p;
+		get(p);
+		unsigned int len = 0;
+		int n = snprintf(aBuffer, aSize, "%-16s %10s %9s %9s %9s %9s\n", "stage (us)", "count", "mean", "p50", "p99", "max");
+		int i;
+		for (i = 0; n >= 0 && i <= PROFILE_STAGE_COUNT; i++)
+		{
+			len += (unsigned int)n;
+			if (len >= aSize)
+				return aSize - 1;
+			if (i == PROFILE_STAGE_COUNT)
+			{
+				n = snprintf(aBuffer + len, aSize - len, "%-16s %10llu %8.1f%% %8.1f%% %8.1f%% %8.1f%%\n", "load",
+					p.mLoad.mCount, p.mLoad.mMean * 100, p.mLoad.mP50 * 100, p.mLoad.mP99 * 100, p.mLoad.mMax * 100);
+			}
+			else
+			{
+				const ProfileStats &s = p.mStage[i];
+				n = snprintf(aBuffer + len, aSize - len, "%-16s %10llu %9.2f %9.2f %9.2f %9.2f\n", getStageName(i),
+					s.mCount, s.mMean, s.mP50, s.mP99, s.mMax);
+			}
+		}
+		if (n > 0)
+			len += (unsigned int)n;
+		return len < aSize ? len : aSize - 1;
+	}
+
+	void Profiler::setDump(double aInterval)
+	{
+		int ms = aInterval > 0 ? (int)(aInterval * 1000) : 0;
+		if (aInterval > 0 && ms < 10)
+			ms = 10;
+		mDumpIntervalMs.store(ms);
+		if (ms && !mDumpThread)
+		{
+			mDumpThread = Thread::createThread(dumpThread, this);
+		}
+		else if (!ms && mDumpThread)
+		{
+			Thread::wait(mDumpThread);
+			Thread::release(mDumpThread);
+			mDumpThread = 0;
+		}
+	}
+
+	unsigned long long Profiler::voiceLap(AudioSourceInstance *aVoice, unsigned int aStage, unsigned long long aStart)
+	{
+		unsigned long long t = now();
+		aVoice->mCpuTime[aStage] += t - aStart;
+		return t;
+	}
+
+	unsigned long long Profiler::filterLap(AudioSourceInstance *aVoice, FilterInstance *aFilter, unsigned long long aStart)
+	{
+		unsigned long long t = now();
+		if (aVoice)
+			aVoice->mCpuTime[AudioSourceInstance::CPU_FILTERS] += t - aStart;
+		if (aFilter->mSourceFilter)
+		{
+			ProfileCpuSlot *slot = findSlot(mFilter, PROFILE_FILTER_SLOTS, (unsigned long long)(size_t)aFilter->mSourceFilter, true);
+			addTime(slot->mTime[AudioSourceInstance::CPU_FILTERS], t - aStart);
+		}
+		return t;
+	}
+
+	void Profiler::voiceDone(AudioSourceInstance *aVoice, const unsigned long long *aBefore)
+	{
+		if (!aVoice->mAudioSourceID)
+			return;
+		ProfileCpuSlot *slot = findSlot(mSource, PROFILE_SOURCE_SLOTS, aVoice->mAudioSourceID, true);
+		unsigned int i;
+		for (i = 0; i < AudioSourceInstance::CPU_STAGE_COUNT; i++)
+		{
+			if (aVoice->mCpuTime[i] != aBefore[i])
+				addTime(slot->mTime[i], aVoice->mCpuTime[i] - aBefore[i]);
+		}
+	}
+
+	time Profiler::getSourceTime(unsigned int aAudioSourceID, unsigned int aStage) const
+	{
+		if (!aAudioSourceID)
+			return 0;
+		return slotTime(findSlot((ProfileCpuSlot *)mSource, PROFILE_SOURCE_SLOTS, aAudioSourceID, false), aStage);
+	}
+
+	time Profiler::getFilterTime(Filter *aFilter) const
+	{
+		if (!aFilter)
+			return 0;
+		return slotTime(findSlot((ProfileCpuSlot *)mFilter, PROFILE_FILTER_SLOTS, (unsigned long long)(size_t)aFilter, false), AudioSourceInstance::CPU_FILTERS);
+	}
+};
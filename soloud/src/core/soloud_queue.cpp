@@ -22,6 +22,7 @@ freely, subject to the following restrictions:
    distribution.
 */
 
+#include <string.h>
 #include "soloud.h"
 
 namespace SoLoud
@@ -42,7 +43,16 @@ namespace SoLoud
 		unsigned int copyofs = 0;
 		while (copycount && mParent->mCount)
 		{
-			int readcount = mParent->mSource[mParent->mReadIndex]->getAudio(aBuffer + copyofs, copycount, aBufferSize);
+			AudioSourceInstance *source = mParent->mSource[mParent->mReadIndex];
+			source->mFlags &= ~AudioSourceInstance::SILENT;
+			int readcount = source->getAudio(aBuffer + copyofs, copycount, aBufferSize);
+			if (source->mFlags & AudioSourceInstance::SILENT)
+			{
+				// Queue output is always defined
+				unsigned int i;
+				for (i = 0; i < mChannels; i++)
+					memset(aBuffer + copyofs + i * aBufferSize, 0, sizeof(float) * readcount);
+			}
 			copyofs += readcount;
 			copycount -= readcount;
 			if (mParent->mSource[mParent->mReadIndex]->hasEnded())
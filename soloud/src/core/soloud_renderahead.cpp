@@ -0,0 +1,229 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include "soloud.h"
+#include "soloud_renderahead.h"
+#include "soloud_profiler.h"
+#include "soloud_trace.h"
+
+// Longest start waits for the first periods to be mixed
+#define RENDERAHEAD_FILL_TIMEOUT 1000
+
+namespace SoLoud
+{
+	RenderAhead::RenderAhead()
+	{
+		mRendered = 0;
+		mSoloud = 0;
+		mCapacity = 0;
+		mPeriodSize = 0;
+		mChannels = 0;
+		mWritten.store(0);
+		mRead.store(0);
+		mReadTime.store(0);
+		mReadSeq.store(0);
+		mUnderruns.store(0);
+		mRunning.store(false);
+		mWake = 0;
+		mFilled = 0;
+		mThread = 0;
+	}
+
+	RenderAhead::~RenderAhead()
+	{
+		stop();
+	}
+
+	result RenderAhead::start(Soloud *aSoloud, unsigned int aPeriods, unsigned int aPeriodSize, unsigned int aChannels)
+	{
+		stop();
+		if (aPeriods == 0 || aPeriodSize == 0 || aChannels == 0)
+			return INVALID_PARAMETER;
+		if (mRing.init(aPeriods * aPeriodSize * aChannels) != SO_NO_ERROR)
+			return OUT_OF_MEMORY;
+		mRing.clear();
+		mSoloud = aSoloud;
+		mCapacity = aPeriods * aPeriodSize;
+		mPeriodSize = aPeriodSize;
+		mChannels = aChannels;
+		mRendered = 0;
+		mWritten.store(0);
+		mRead.store(0);
+		mReadTime.store(0);
+		mUnderruns.store(0);
+
+		mWake = Thread::createSemaphore();
+		mFilled = Thread::createSemaphore();
+		mRunning.store(true, std::memory_order_release);
+		mThread = Thread::createThread(renderThread, this);
+		if (!mThread)
+		{
+			mRunning.store(false);
+			Thread::destroySemaphore(mWake);
+			Thread::destroySemaphore(mFilled);
+			mWake = 0;
+			mFilled = 0;
+			return UNKNOWN_ERROR;
+		}
+		// The first periods are mixed on the render thread as well, not here: mixing
+		// changes the calling thread's FPU modes, and with ENABLE_REALTIME its priority.
+		// A mixer stuck for longer than the timeout isn't worth hanging init over.
+		Thread::waitSemaphore(mFilled, RENDERAHEAD_FILL_TIMEOUT);
+		return SO_NO_ERROR;
+	}
+
+	void RenderAhead::stop()
+	{
+		if (!mThread)
+			return;
+		mRunning.store(false, std::memory_order_release);
+		Thread::signalSemaphore(mWake);
+		Thread::wait(mThread);
+		Thread::release(mThread);
+		mThread = 0;
+		Thread::destroySemaphore(mWake);
+		Thread::destroySemaphore(mFilled);
+		mWake = 0;
+		mFilled = 0;
+	}
+
+	bool RenderAhead::isRunning() const
+	{
+		return mRunning.load(std::memory_order_acquire);
+	}
+
+	void RenderAhead::renderThread(void *aParam)
+	{
+		RenderAhead *that = (RenderAhead *)aParam;
+		Trace::setThreadName("render-ahead");
+		while (that->mRunning.load(std::memory_order_acquire))
+		{
+			unsigned long long written = that->mWritten.load(std::memory_order_relaxed);
+			if (written + that->mPeriodSize - that->mRead.load(std::memory_order_acquire) <= that->mCapacity)
+			{
+				float *dst = that->mRing.mData + (unsigned int)(written % that->mCapacity) * that->mChannels;
+				that->mSoloud->renderAhead_internal(dst, that->mPeriodSize);
+				that->mWritten.store(written + that->mPeriodSize, std::memory_order_release);
+				if (written + that->mPeriodSize == that->mCapacity)
+					Thread::signalSemaphore(that->mFilled);
+			}
+			else
+			{
+				// The timeout only matters for stop; the callback signals every time
+				Thread::waitSemaphore(that->mWake, 100);
+			}
+		}
+	}
+
+	void RenderAhead::copyOut(float *aBuffer, short *aBuffer16, unsigned int aFrames)
+	{
+		unsigned long long read = mRead.load(std::memory_order_relaxed);
+		unsigned long long ready = mWritten.load(std::memory_order_acquire) - read;
+		unsigned int frames = ready < aFrames ? (unsigned int)ready : aFrames;
+		unsigned int done = 0;
+		while (done < frames)
+		{
+			unsigned int pos = (unsigned int)((read + done) % mCapacity);
+			unsigned int run = mCapacity - pos;
+			if (run > frames - done)
+				run = frames - done;
+			const float *src = mRing.mData + pos * mChannels;
+			unsigned int count = run * mChannels;
+			if (aBuffer)
+			{
+				memcpy(aBuffer + done * mChannels, src, count * sizeof(float));
+			}
+			else
+			{
+				short *dst = aBuffer16 + done * mChannels;
+				unsigned int i;
+				// Same conversion as interlace_samples_s16
+				for (i = 0; i < count; i++)
+					dst[i] = (short)(src[i] * 0x7fff);
+			}
+			done += run;
+		}
+		if (frames < aFrames)
+		{
+			if (aBuffer)
+				memset(aBuffer + frames * mChannels, 0, (aFrames - frames) * mChannels * sizeof(float));
+			else
+				memset(aBuffer16 + frames * mChannels, 0, (aFrames - frames) * mChannels * sizeof(short));
+			mUnderruns.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		mReadSeq.fetch_add(1, std::memory_order_acq_rel);
+		mReadTime.store(Profiler::now(), std::memory_order_relaxed);
+		mRead.store(read + frames, std::memory_order_release);
+		mReadSeq.fetch_add(1, std::memory_order_release);
+		Thread::signalSemaphore(mWake);
+	}
+
+	void RenderAhead::read(float *aBuffer, unsigned int aFrames)
+	{
+		copyOut(aBuffer, 0, aFrames);
+	}
+
+	void RenderAhead::readSigned16(short *aBuffer, unsigned int aFrames)
+	{
+		copyOut(0, aBuffer, aFrames);
+	}
+
+	unsigned int RenderAhead::getCommandDelay(unsigned int aSamplerate)
+	{
+		unsigned long long read, readTime;
+		unsigned int seq;
+		do
+		{
+			seq = mReadSeq.load(std::memory_order_acquire);
+			readTime = mReadTime.load(std::memory_order_relaxed);
+			read = mRead.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		while ((seq & 1) || seq != mReadSeq.load(std::memory_order_acquire));
+
+		// Where the device is now: the last callback's position, moved on by the time
+		// since. Nothing has been read before the first callback.
+		unsigned long long heard = read;
+		if (readTime)
+		{
+			unsigned long long elapsed = Profiler::now() - readTime;
+			unsigned long long frames = elapsed * aSamplerate / 1000000000ull;
+			heard += frames < mCapacity ? frames : mCapacity;
+		}
+		// Heard a whole ring later, however full the ring is at the moment
+		unsigned long long target = heard + mCapacity;
+		if (target <= mRendered)
+			return 0;
+		unsigned long long delay = target - mRendered;
+		return delay < 2 * mCapacity ? (unsigned int)delay : 2 * mCapacity;
+	}
+
+	unsigned int RenderAhead::getUnderrunCount() const
+	{
+		return mUnderruns.load(std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,691 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <string.h>
+#include <stdlib.h>
+#include "soloud.h"
+#include "soloud_thread.h"
+#include "soloud_streamfile.h"
+#include "soloud_trace.h"
+#include "soloud_audit.h"
+
+#if defined(_WIN32)||defined(_WIN64)
+
+namespace SoLoud
+{
+	StreamFile::StreamFile() { mState = 0; mOffset = 0; mLength = 0; }
+	StreamFile::~StreamFile() {}
+	result StreamFile::open(const char * /*aFilename*/) { return NOT_IMPLEMENTED; }
+	int StreamFile::eof() { return 1; }
+	unsigned int StreamFile::read(unsigned char * /*aDst*/, unsigned int /*aBytes*/) { return 0; }
+	unsigned int StreamFile::length() { return 0; }
+	void StreamFile::seek(int /*aOffset*/) {}
+	unsigned int StreamFile::pos() { return 0; }
+	unsigned int StreamFile::getStallCount() { return 0; }
+	bool StreamFile::isUsingIoUring() { return false; }
+};
+
+#else
+
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SOLOUD_IO_URING
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// Each stream keeps STREAMFILE_CHUNKS reads of STREAMFILE_CHUNK_SIZE bytes ahead
+#define STREAMFILE_CHUNK_SIZE (64 * 1024)
+#define STREAMFILE_CHUNKS 4
+#define STREAMFILE_PREAD_THREADS 4
+#define STREAMFILE_RING_ENTRIES 256
+
+namespace SoLoud
+{
+	enum STREAMCHUNK_STATE
+	{
+		STREAMCHUNK_FREE = 0,
+		STREAMCHUNK_INFLIGHT,
+		STREAMCHUNK_READY
+	};
+
+	// A chunk is owned by the reader thread while FREE -> INFLIGHT, by the I/O
+	// completion while INFLIGHT -> READY, and by the StreamFile while READY -> FREE.
+	struct StreamChunk : public Thread::PoolTask
+	{
+		StreamFileState *mOwner;
+		unsigned char *mData;
+		unsigned int mOffset;
+		unsigned int mLength;
+		struct iovec mIov;
+		std::atomic<int> mState;
+
+		// pread fallback
+		virtual void work();
+	};
+
+	struct StreamFileState
+	{
+		int mFd;
+		unsigned int mFileLength;
+		StreamChunk mChunk[STREAMFILE_CHUNKS];
+		std::atomic<unsigned int> mPos;
+		std::atomic<unsigned int> mStalls;
+		std::atomic<int> mInflight;
+		std::atomic<bool> mRetired;
+		StreamFileState *mNext;
+	};
+
+	static void completeChunk(StreamChunk *aChunk, int aResult)
+	{
+		StreamFileState *owner = aChunk->mOwner;
+		aChunk->mLength = aResult > 0 ? (unsigned int)aResult : 0;
+		aChunk->mState.store(STREAMCHUNK_READY, std::memory_order_release);
+		// Last touch; a retired owner may be freed right after this
+		owner->mInflight.fetch_sub(1, std::memory_order_release);
+	}
+
+#if defined(SOLOUD_IO_URING)
+	struct StreamUring
+	{
+		int mFd;
+		unsigned int *mSqHead;
+		unsigned int *mSqTail;
+		unsigned int *mSqMask;
+		unsigned int *mSqArray;
+		unsigned int *mCqHead;
+		unsigned int *mCqTail;
+		unsigned int *mCqMask;
+		struct io_uring_sqe *mSqes;
+		struct io_uring_cqe *mCqes;
+		unsigned int mEntries;
+		// Queued in the submission ring but not yet handed to the kernel
+		unsigned int mToSubmit;
+	};
+
+	static bool uringInit(StreamUring &aRing, unsigned int aEntries)
+	{
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		int fd = (int)syscall(__NR_io_uring_setup, aEntries, &p);
+		if (fd < 0)
+			return false;
+
+		size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+		size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single && cqSize > sqSize)
+			sqSize = cqSize;
+
+		void *sq = mmap(0, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		void *cq = single ? sq : mmap(0, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		void *sqes = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+		{
+			// The ring lives for the rest of the process, so a failed setup just leaks
+			close(fd);
+			return false;
+		}
+
+		unsigned char *sqp = (unsigned char *)sq;
+		unsigned char *cqp = (unsigned char *)cq;
+		aRing.mFd = fd;
+		aRing.mSqHead = (unsigned int *)(sqp + p.sq_off.head);
+		aRing.mSqTail = (unsigned int *)(sqp + p.sq_off.tail);
+		aRing.mSqMask = (unsigned int *)(sqp + p.sq_off.ring_mask);
+		aRing.mSqArray = (unsigned int *)(sqp + p.sq_off.array);
+		aRing.mCqHead = (unsigned int *)(cqp + p.cq_off.head);
+		aRing.mCqTail = (unsigned int *)(cqp + p.cq_off.tail);
+		aRing.mCqMask = (unsigned int *)(cqp + p.cq_off.ring_mask);
+		aRing.mSqes = (struct io_uring_sqe *)sqes;
+		aRing.mCqes = (struct io_uring_cqe *)(cqp + p.cq_off.cqes);
+		aRing.mEntries = p.sq_entries;
+		aRing.mToSubmit = 0;
+		return true;
+	}
+
+	// Queue reads for aChunks; they go to the kernel with the next uringEnter
+	static void uringQueueReads(StreamUring &aRing, StreamChunk **aChunks, unsigned int aCount)
+	{
+		unsigned int tail = *aRing.mSqTail;
+		unsigned int mask = *aRing.mSqMask;
+		unsigned int i;
+		for (i = 0; i < aCount; i++)
+		{
+			StreamChunk *c = aChunks[i];
+			unsigned int idx = tail & mask;
+			struct io_uring_sqe *sqe = &aRing.mSqes[idx];
+			memset(sqe, 0, sizeof(*sqe));
+			c->mIov.iov_base = c->mData;
+			c->mIov.iov_len = STREAMFILE_CHUNK_SIZE;
+			// READV rather than READ, which needs a newer kernel
+			sqe->opcode = IORING_OP_READV;
+			sqe->fd = c->mOwner->mFd;
+			sqe->addr = (unsigned long long)(size_t)&c->mIov;
+			sqe->len = 1;
+			sqe->off = c->mOffset;
+			sqe->user_data = (unsigned long long)(size_t)c;
+			aRing.mSqArray[idx] = idx;
+			tail++;
+		}
+		__atomic_store_n(aRing.mSqTail, tail, __ATOMIC_RELEASE);
+		aRing.mToSubmit += aCount;
+	}
+
+	// Queue a one-shot poll for aFd becoming readable; it completes with user_data 0
+	static void uringQueueWake(StreamUring &aRing, int aFd)
+	{
+		unsigned int tail = *aRing.mSqTail;
+		unsigned int idx = tail & *aRing.mSqMask;
+		struct io_uring_sqe *sqe = &aRing.mSqes[idx];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = aFd;
+		sqe->poll_events = POLLIN;
+		sqe->user_data = 0;
+		aRing.mSqArray[idx] = idx;
+		__atomic_store_n(aRing.mSqTail, tail + 1, __ATOMIC_RELEASE);
+		aRing.mToSubmit++;
+	}
+
+	// Submit what's queued and sleep until at least one completion is there
+	static void uringEnterAndWait(StreamUring &aRing)
+	{
+		int r = (int)syscall(__NR_io_uring_enter, aRing.mFd, aRing.mToSubmit, 1, IORING_ENTER_GETEVENTS, (void *)0, (size_t)0);
+		// Interrupted waits still report what was submitted
+		if (r > 0)
+			aRing.mToSubmit -= (unsigned int)r;
+	}
+
+	// Complete landed reads; returns how many. aWoken is set if the wake poll fired.
+	static unsigned int uringReap(StreamUring &aRing, bool &aWoken)
+	{
+		unsigned int head = *aRing.mCqHead;
+		unsigned int tail = __atomic_load_n(aRing.mCqTail, __ATOMIC_ACQUIRE);
+		unsigned int mask = *aRing.mCqMask;
+		unsigned int n = 0;
+		while (head != tail)
+		{
+			struct io_uring_cqe *cqe = &aRing.mCqes[head & mask];
+			if (cqe->user_data)
+			{
+				completeChunk((StreamChunk *)(size_t)cqe->user_data, cqe->res);
+				n++;
+			}
+			else
+			{
+				aWoken = true;
+			}
+			head++;
+		}
+		__atomic_store_n(aRing.mCqHead, head, __ATOMIC_RELEASE);
+		return n;
+	}
+#endif
+
+	struct StreamReaderThread
+	{
+		void *mMutex;
+		Thread::ThreadHandle mThread;
+		bool mRunning;
+		StreamFileState *mList;
+		bool mUseUring;
+		// Reads submitted to the ring and not yet reaped; bounded by the ring size
+		unsigned int mRingInflight;
+		// The thread sleeps until a stream is opened, retired or moves on, or a
+		// pread finishes; those signal this
+		void *mWake;
+#if defined(SOLOUD_IO_URING)
+		StreamUring mRing;
+		// With io_uring the thread sleeps in the ring instead, so wakes go through
+		// an eventfd that a poll request in the ring watches
+		int mWakeFd;
+		bool mWakeArmed;
+#endif
+		Thread::Pool *mPool;
+
+		StreamReaderThread()
+		{
+			mMutex = Thread::createMutex();
+			mThread = 0;
+			mRunning = false;
+			mList = 0;
+			mRingInflight = 0;
+			mPool = 0;
+			mUseUring = false;
+			mWake = Thread::createSemaphore();
+#if defined(SOLOUD_IO_URING)
+			mWakeArmed = false;
+			mWakeFd = -1;
+			// Lets the fallback be exercised on machines that do have io_uring
+			if (!getenv("SOLOUD_NO_IO_URING"))
+			{
+				mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+				mUseUring = mWakeFd >= 0 && uringInit(mRing, STREAMFILE_RING_ENTRIES);
+			}
+#endif
+			if (!mUseUring)
+			{
+				mPool = new Thread::Pool;
+				mPool->init(STREAMFILE_PREAD_THREADS);
+			}
+		}
+	};
+
+	static StreamReaderThread &streamReaderThread()
+	{
+		static StreamReaderThread thread;
+		return thread;
+	}
+
+	// Never blocks, so the audio thread may call it
+	static void wakeStreamReader()
+	{
+		StreamReaderThread &t = streamReaderThread();
+#if defined(SOLOUD_IO_URING)
+		if (t.mUseUring)
+		{
+			unsigned long long one = 1;
+			ssize_t r = write(t.mWakeFd, &one, sizeof(one));
+			(void)r;
+			return;
+		}
+#endif
+		Thread::signalSemaphore(t.mWake);
+	}
+
+	void StreamChunk::work()
+	{
+		ssize_t r = pread(mOwner->mFd, mData, STREAMFILE_CHUNK_SIZE, mOffset);
+		completeChunk(this, (int)r);
+		// A retired stream may have been waiting on this read to be freed
+		wakeStreamReader();
+	}
+
+	static void deleteStreamState(StreamFileState *aState)
+	{
+		int i;
+		for (i = 0; i < STREAMFILE_CHUNKS; i++)
+			free(aState->mChunk[i].mData);
+		close(aState->mFd);
+		delete aState;
+	}
+
+	// Queue reads for the chunk aligned window starting at the stream's position.
+	// Returns the number of chunks added to aOut.
+	static unsigned int planReads(StreamFileState *aState, StreamChunk **aOut, unsigned int aMax)
+	{
+		unsigned int base = aState->mPos.load(std::memory_order_acquire) & ~(STREAMFILE_CHUNK_SIZE - 1);
+		unsigned int n = 0;
+		int w, i;
+		for (w = 0; w < STREAMFILE_CHUNKS && n < aMax; w++)
+		{
+			unsigned int ofs = base + w * STREAMFILE_CHUNK_SIZE;
+			if (ofs >= aState->mFileLength || ofs < base)
+				break;
+			StreamChunk *freeChunk = 0;
+			bool covered = false;
+			for (i = 0; i < STREAMFILE_CHUNKS; i++)
+			{
+				StreamChunk *c = &aState->mChunk[i];
+				int state = c->mState.load(std::memory_order_acquire);
+				if (state == STREAMCHUNK_FREE)
+				{
+					if (!freeChunk)
+						freeChunk = c;
+				}
+				else if (c->mOffset == ofs)
+				{
+					covered = true;
+				}
+			}
+			if (covered || !freeChunk)
+				continue;
+			freeChunk->mOffset = ofs;
+			freeChunk->mState.store(STREAMCHUNK_INFLIGHT, std::memory_order_relaxed);
+			aState->mInflight.fetch_add(1, std::memory_order_relaxed);
+			aOut[n++] = freeChunk;
+		}
+		return n;
+	}
+
+	static void streamReaderThreadFunc(void *aParam)
+	{
+		StreamReaderThread *t = (StreamReaderThread *)aParam;
+		StreamChunk *batch[STREAMFILE_RING_ENTRIES];
+		bool idle = false;
+		Trace::setThreadName("stream read-ahead");
+		for (;;)
+		{
+			unsigned int count = 0;
+			Thread::lockMutex(t->mMutex);
+			StreamFileState **link = &t->mList;
+			while (*link)
+			{
+				StreamFileState *s = *link;
+				if (s->mRetired.load(std::memory_order_acquire))
+				{
+					// Buffers can only go once no read is writing into them
+					if (s->mInflight.load(std::memory_order_acquire) == 0)
+					{
+						*link = s->mNext;
+						deleteStreamState(s);
+						continue;
+					}
+				}
+				else
+				{
+					unsigned int room = STREAMFILE_RING_ENTRIES - count;
+					// One entry is kept for the wake poll
+					if (t->mUseUring)
+						room = STREAMFILE_RING_ENTRIES - 1 - t->mRingInflight - count;
+					count += planReads(s, batch + count, room);
+				}
+				link = &s->mNext;
+			}
+			// Linger for a while before quitting, so short streams don't restart the thread
+			if (!t->mList && idle)
+			{
+				t->mRunning = false;
+				Thread::unlockMutex(t->mMutex);
+				break;
+			}
+			bool empty = t->mList == 0;
+			Thread::unlockMutex(t->mMutex);
+
+			idle = false;
+#if defined(SOLOUD_IO_URING)
+			if (t->mUseUring)
+			{
+				if (count)
+				{
+					uringQueueReads(t->mRing, batch, count);
+					t->mRingInflight += count;
+				}
+				bool woken = false;
+				if (t->mRingInflight)
+				{
+					// Sleep in the ring until a read lands or the wake poll fires
+					if (!t->mWakeArmed)
+					{
+						uringQueueWake(t->mRing, t->mWakeFd);
+						t->mWakeArmed = true;
+					}
+					uringEnterAndWait(t->mRing);
+					t->mRingInflight -= uringReap(t->mRing, woken);
+					if (woken)
+						t->mWakeArmed = false;
+				}
+				else
+				{
+					// Nothing in flight, so only a wake can bring more work
+					struct pollfd pfd;
+					pfd.fd = t->mWakeFd;
+					pfd.events = POLLIN;
+					pfd.revents = 0;
+					woken = poll(&pfd, 1, empty ? 500 : -1) > 0;
+					idle = empty && !woken;
+				}
+				if (woken)
+				{
+					unsigned long long value;
+					ssize_t r = read(t->mWakeFd, &value, sizeof(value));
+					(void)r;
+				}
+				continue;
+			}
+#endif
+			unsigned int i;
+			for (i = 0; i < count; i++)
+				t->mPool->addWork(batch[i]);
+			// Completions and stream activity signal; the timeout only matters
+			// for deciding the thread has been idle long enough to quit
+			bool woken = Thread::waitSemaphore(t->mWake, empty ? 500 : 1000);
+			idle = empty && !woken;
+		}
+	}
+
+	static void registerStreamState(StreamFileState *aState)
+	{
+		StreamReaderThread &t = streamReaderThread();
+		Thread::lockMutex(t.mMutex);
+		aState->mNext = t.mList;
+		t.mList = aState;
+		if (!t.mRunning)
+		{
+			if (t.mThread)
+			{
+				Thread::wait(t.mThread);
+				Thread::release(t.mThread);
+			}
+			t.mRunning = true;
+			t.mThread = Thread::createThread(streamReaderThreadFunc, &t);
+		}
+		Thread::unlockMutex(t.mMutex);
+		wakeStreamReader();
+	}
+
+	// Hand aState to the reader thread to free once its reads have landed
+	static void retireStreamState(StreamFileState *aState)
+	{
+		aState->mRetired.store(true, std::memory_order_release);
+		wakeStreamReader();
+	}
+
+	StreamFile::StreamFile()
+	{
+		mState = 0;
+		mOffset = 0;
+		mLength = 0;
+	}
+
+	StreamFile::~StreamFile()
+	{
+		if (mState)
+			retireStreamState(mState);
+	}
+
+	result StreamFile::open(const char *aFilename)
+	{
+		if (!aFilename)
+			return INVALID_PARAMETER;
+		if (mState)
+			retireStreamState(mState);
+		mState = 0;
+		mOffset = 0;
+		mLength = 0;
+
+		int fd = ::open(aFilename, O_RDONLY);
+		if (fd < 0)
+			return FILE_NOT_FOUND;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (unsigned long long)st.st_size > 0xffffffffULL)
+		{
+			close(fd);
+			return FILE_LOAD_FAILED;
+		}
+
+		StreamFileState *s = new StreamFileState;
+		s->mFd = fd;
+		s->mFileLength = (unsigned int)st.st_size;
+		s->mPos.store(0);
+		s->mStalls.store(0);
+		s->mInflight.store(0);
+		s->mRetired.store(false);
+		s->mNext = 0;
+		int i;
+		for (i = 0; i < STREAMFILE_CHUNKS; i++)
+		{
+			StreamChunk &c = s->mChunk[i];
+			c.mOwner = s;
+			c.mOffset = 0;
+			c.mLength = 0;
+			c.mState.store(STREAMCHUNK_FREE);
+			// Page aligned, so the reads stay friendly to direct I/O paths
+			void *p = 0;
+			if (posix_memalign(&p, 4096, STREAMFILE_CHUNK_SIZE) != 0)
+				p = 0;
+			c.mData = (unsigned char *)p;
+		}
+		for (i = 0; i < STREAMFILE_CHUNKS; i++)
+		{
+			if (!s->mChunk[i].mData)
+			{
+				deleteStreamState(s);
+				return OUT_OF_MEMORY;
+			}
+		}
+#if defined(POSIX_FADV_SEQUENTIAL)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+		mState = s;
+		mLength = s->mFileLength;
+		registerStreamState(s);
+		return SO_NO_ERROR;
+	}
+
+	unsigned int StreamFile::read(unsigned char *aDst, unsigned int aBytes)
+	{
+		if (!mState || mOffset >= mLength)
+			return 0;
+		if (aBytes > mLength - mOffset)
+			aBytes = mLength - mOffset;
+
+		// Hand back chunks that fell out of the read-ahead window, and failed reads
+		// so they get retried. The reader thread is woken whenever a chunk frees up.
+		unsigned int base = mOffset & ~(STREAMFILE_CHUNK_SIZE - 1);
+		bool freed = false;
+		int i;
+		for (i = 0; i < STREAMFILE_CHUNKS; i++)
+		{
+			StreamChunk &c = mState->mChunk[i];
+			if (c.mState.load(std::memory_order_acquire) == STREAMCHUNK_READY &&
+				(c.mLength == 0 || c.mOffset < base || c.mOffset - base >= STREAMFILE_CHUNKS * STREAMFILE_CHUNK_SIZE))
+			{
+				c.mState.store(STREAMCHUNK_FREE, std::memory_order_release);
+				freed = true;
+			}
+		}
+
+		unsigned int done = 0;
+		while (done < aBytes)
+		{
+			StreamChunk *hit = 0;
+			for (i = 0; i < STREAMFILE_CHUNKS; i++)
+			{
+				StreamChunk &c = mState->mChunk[i];
+				if (c.mState.load(std::memory_order_acquire) == STREAMCHUNK_READY &&
+					mOffset >= c.mOffset && mOffset - c.mOffset < c.mLength)
+				{
+					hit = &c;
+					break;
+				}
+			}
+			if (hit)
+			{
+				unsigned int ofs = mOffset - hit->mOffset;
+				unsigned int n = hit->mLength - ofs;
+				if (n > aBytes - done)
+					n = aBytes - done;
+				memcpy(aDst + done, hit->mData + ofs, n);
+				done += n;
+				mOffset += n;
+				if (ofs + n == hit->mLength)
+				{
+					hit->mState.store(STREAMCHUNK_FREE, std::memory_order_release);
+					freed = true;
+				}
+			}
+			else
+			{
+				// Not read ahead (yet); go to the disk directly
+				mState->mStalls.fetch_add(1, std::memory_order_relaxed);
+				SOLOUD_AUDIT_CHECK(FILE_IO, aBytes - done);
+				ssize_t r = pread(mState->mFd, aDst + done, aBytes - done, mOffset);
+				if (r <= 0)
+					break;
+				done += (unsigned int)r;
+				mOffset += (unsigned int)r;
+			}
+		}
+		mState->mPos.store(mOffset, std::memory_order_release);
+		if (freed)
+			wakeStreamReader();
+		return done;
+	}
+
+	unsigned int StreamFile::length()
+	{
+		return mLength;
+	}
+
+	void StreamFile::seek(int aOffset)
+	{
+		if (aOffset >= 0)
+			mOffset = aOffset;
+		else
+			mOffset = mLength + aOffset;
+		if (mOffset > mLength)
+			mOffset = mLength;
+		if (mState)
+		{
+			mState->mPos.store(mOffset, std::memory_order_release);
+			wakeStreamReader();
+		}
+	}
+
+	unsigned int StreamFile::pos()
+	{
+		return mOffset;
+	}
+
+	int StreamFile::eof()
+	{
+		return mOffset >= mLength;
+	}
+
+	unsigned int StreamFile::getStallCount()
+	{
+		return mState ? mState->mStalls.load(std::memory_order_relaxed) : 0;
+	}
+
+	bool StreamFile::isUsingIoUring()
+	{
+		return streamReaderThread().mUseUring;
+	}
+};
+
+#endif
@@ -26,13 +26,22 @@ freely, subject to the following restrictions:
 #include <windows.h>
 #else
 #include <inttypes.h>
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
 #include <unistd.h>
 #include <time.h>
 #endif
 
 #include "soloud.h"
 #include "soloud_thread.h"
+#include "soloud_trace.h"
+#include "soloud_audit.h"
 
 namespace SoLoud
 {
@@ -63,6 +72,17 @@ namespace SoLoud
 			CRITICAL_SECTION *cs = (CRITICAL_SECTION*)aHandle;
 			if (cs)
 			{
+#ifdef SOLOUD_AUDIT
+				if (Audit::isAuditing())
+				{
+					if (TryEnterCriticalSection(cs))
+					{
+						Audit::check(Audit::LOCK);
+						return;
+					}
+					Audit::check(Audit::LOCK_WAIT);
+				}
+#endif
 				EnterCriticalSection(cs);
 			}
 		}
@@ -90,6 +110,26 @@ namespace SoLoud
 			return 0;
 		}
 
+		void * createSemaphore()
+		{
+			return (void*)CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+		}
+
+		void destroySemaphore(void *aHandle)
+		{
+			CloseHandle((HANDLE)aHandle);
+		}
+
+		void signalSemaphore(void *aHandle)
+		{
+			ReleaseSemaphore((HANDLE)aHandle, 1, NULL);
+		}
+
+		bool waitSemaphore(void *aHandle, int aMSec)
+		{
+			return WaitForSingleObject((HANDLE)aHandle, aMSec) == WAIT_OBJECT_0;
+		}
+
         ThreadHandle createThread(threadFunction aThreadFunction, void *aParameter)
 		{
 			soloud_thread_data *d = new soloud_thread_data;
@@ -126,6 +166,20 @@ namespace SoLoud
 			return GetTickCount();
 		}
 
+		bool setRealtimePriority(int aPriority)
+		{
+			// Windows has no priority levels to speak of within the real-time class
+			(void)aPriority;
+			return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+		}
+
+		bool setAffinity(int aCpu)
+		{
+			if (aCpu < 0 || aCpu >= (int)(sizeof(DWORD_PTR) * 8))
+				return false;
+			return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << aCpu) != 0;
+		}
+
 #else // pthreads
         struct ThreadHandleData
         {
@@ -161,6 +215,17 @@ namespace SoLoud
 			pthread_mutex_t *mutex = (pthread_mutex_t*)aHandle;
 			if (mutex)
 			{
+#ifdef SOLOUD_AUDIT
+				if (Audit::isAuditing())
+				{
+					if (pthread_mutex_trylock(mutex) == 0)
+					{
+						Audit::check(Audit::LOCK);
+						return;
+					}
+					Audit::check(Audit::LOCK_WAIT);
+				}
+#endif
 				pthread_mutex_lock(mutex);
 			}
 		}
@@ -174,6 +239,70 @@ namespace SoLoud
 			}
 		}
 
+#ifdef __APPLE__
+		// macOS has no unnamed POSIX semaphores
+		void * createSemaphore()
+		{
+			return (void*)dispatch_semaphore_create(0);
+		}
+
+		void destroySemaphore(void *aHandle)
+		{
+			dispatch_release((dispatch_semaphore_t)aHandle);
+		}
+
+		void signalSemaphore(void *aHandle)
+		{
+			dispatch_semaphore_signal((dispatch_semaphore_t)aHandle);
+		}
+
+		bool waitSemaphore(void *aHandle, int aMSec)
+		{
+			return dispatch_semaphore_wait((dispatch_semaphore_t)aHandle, dispatch_time(DISPATCH_TIME_NOW, aMSec * 1000000LL)) == 0;
+		}
+#else
+		void * createSemaphore()
+		{
+			sem_t *sem = new sem_t;
+			sem_init(sem, 0, 0);
+			return (void*)sem;
+		}
+
+		void destroySemaphore(void *aHandle)
+		{
+			sem_t *sem = (sem_t*)aHandle;
+			if (sem)
+			{
+				sem_destroy(sem);
+				delete sem;
+			}
+		}
+
+		void signalSemaphore(void *aHandle)
+		{
+			sem_post((sem_t*)aHandle);
+		}
+
+		bool waitSemaphore(void *aHandle, int aMSec)
+		{
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += aMSec / 1000;
+			until.tv_nsec += (aMSec % 1000) * 1000000L;
+			if (until.tv_nsec >= 1000000000L)
+			{
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000L;
+			}
+			while (sem_timedwait((sem_t*)aHandle, &until) != 0)
+			{
+				if (errno != EINTR)
+					return false;
+			}
+			return true;
+		}
+#endif
+
 		struct soloud_thread_data
 		{
 			threadFunction mFunc;
@@ -224,21 +353,50 @@ namespace SoLoud
 			clock_gettime(CLOCK_REALTIME, &spec);
 			return spec.tv_sec * 1000 + (int)(spec.tv_nsec / 1.0e6);
 		}
+
+		bool setRealtimePriority(int aPriority)
+		{
+			struct sched_param param;
+			int lo = sched_get_priority_min(SCHED_FIFO);
+			int hi = sched_get_priority_max(SCHED_FIFO);
+			param.sched_priority = aPriority < lo ? lo : aPriority > hi ? hi : aPriority;
+			// EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+			return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+		}
+
+		bool setAffinity(int aCpu)
+		{
+#if defined(__linux__) && !defined(__ANDROID__)
+			if (aCpu < 0 || aCpu >= CPU_SETSIZE)
+				return false;
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(aCpu, &set);
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+			(void)aCpu;
+			return false;
+#endif
+		}
 #endif
 
 		static void poolWorker(void *aParam)
 		{
 			Pool *myPool = (Pool*)aParam;
+			Trace::setThreadName("pool worker");
 			while (myPool->mRunning)
 			{
 				PoolTask *t = myPool->getWork();
 				if (!t)
 				{
-					sleep(1);
+					// addWork signals once per task and ~Pool once per thread
+					waitSemaphore(myPool->mWorkSemaphore, 1000);
 				}
 				else
 				{
+					unsigned long long tracestart = Trace::begin();
 					t->work();
+					Trace::end("pool task", tracestart);
 				}
 			}
 		}
@@ -249,6 +407,7 @@ namespace SoLoud
 			mThreadCount = 0;
 			mThread = 0;
 			mWorkMutex = 0;
+			mWorkSemaphore = 0;
 			mRobin = 0;
 			mMaxTask = 0;
 			for (int i = 0; i < MAX_THREADPOOL_TASKS; i++)
@@ -259,6 +418,8 @@ namespace SoLoud
 		{
 			mRunning = 0;
 			int i;
+			for (i = 0; i < mThreadCount; i++)
+				signalSemaphore(mWorkSemaphore);
 			for (i = 0; i < mThreadCount; i++)
 			{
 				wait(mThread[i]);
@@ -267,6 +428,8 @@ namespace SoLoud
 			delete[] mThread;
 			if (mWorkMutex)
 				destroyMutex(mWorkMutex);
+			if (mWorkSemaphore)
+				destroySemaphore(mWorkSemaphore);
 		}
 
 		void Pool::init(int aThreadCount)
@@ -275,6 +438,7 @@ namespace SoLoud
 			{
 				mMaxTask = 0;
 				mWorkMutex = createMutex();
+				mWorkSemaphore = createSemaphore();
 				mRunning = 1;
 				mThreadCount = aThreadCount;
 				mThread = new ThreadHandle[aThreadCount];
@@ -307,6 +471,7 @@ namespace SoLoud
 					mTaskArray[mMaxTask] = aTask;
 					mMaxTask++;
 					if (mWorkMutex) unlockMutex(mWorkMutex);
+					signalSemaphore(mWorkSemaphore);
 				}
 			}
 		}
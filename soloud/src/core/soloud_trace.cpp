@@ -0,0 +1,210 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2018 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include <stdio.h>
+#include "soloud.h"
+#include "soloud_profiler.h"
+#include "soloud_trace.h"
+
+namespace SoLoud
+{
+	std::atomic<bool> Trace::mEnabled(false);
+
+	// Rings are never freed, so save() can walk the list without locking. A thread's
+	// events stay in the trace after it exits, until a new thread takes over its ring.
+	static std::atomic<TraceRing *> gRings(0);
+	static std::atomic<unsigned int> gRingCount(0);
+	// Events that ended before this were cleared
+	static std::atomic<unsigned long long> gClearTime(0);
+	static std::atomic<unsigned long long> gEpoch(0);
+	// Hands the thread's ring back for reuse when the thread exits
+	struct TraceRingOwner
+	{
+		TraceRing *mRing;
+		~TraceRingOwner()
+		{
+			if (mRing)
+				mRing->mFree.store(true, std::memory_order_release);
+		}
+	};
+
+	static thread_local TraceRingOwner tRing = { 0 };
+	static thread_local const char *tName = 0;
+
+	static TraceRing *threadRing()
+	{
+		TraceRing *r = tRing.mRing;
+		if (r)
+			return r;
+		// Take over the ring of a thread that has exited, so threads coming and
+		// going don't keep adding rings
+		for (r = gRings.load(std::memory_order_acquire); r; r = r->mNext)
+		{
+			bool free = true;
+			if (r->mFree.load(std::memory_order_relaxed) &&
+				r->mFree.compare_exchange_strong(free, false, std::memory_order_acquire))
+				break;
+		}
+		if (r)
+		{
+			r->mFirst.store(r->mHead.load(std::memory_order_relaxed), std::memory_order_release);
+			r->mName.store(tName, std::memory_order_relaxed);
+		}
+		else
+		{
+			r = new TraceRing;
+			r->mHead.store(0, std::memory_order_relaxed);
+			r->mFirst.store(0, std::memory_order_relaxed);
+			r->mFree.store(false, std::memory_order_relaxed);
+			r->mName.store(tName, std::memory_order_relaxed);
+			r->mId = gRingCount.fetch_add(1) + 1;
+			TraceRing *head = gRings.load();
+			do
+			{
+				r->mNext = head;
+			}
+			while (!gRings.compare_exchange_weak(head, r));
+		}
+		tRing.mRing = r;
+		return r;
+	}
+
+	void Trace::setEnable(bool aEnable)
+	{
+		unsigned long long none = 0;
+		if (aEnable)
+			gEpoch.compare_exchange_strong(none, Profiler::now());
+		mEnabled.store(aEnable);
+	}
+
+	unsigned long long Trace::begin()
+	{
+		return isEnabled() ? Profiler::now() : 0;
+	}
+
+	void Trace::end(const char *aName, unsigned long long aStart, int aArg)
+	{
+		if (aStart)
+			event(aName, aStart, Profiler::now(), aArg);
+	}
+
+	void Trace::event(const char *aName, unsigned long long aStart, unsigned long long aEnd, int aArg)
+	{
+		TraceRing *r = threadRing();
+		unsigned long long h = r->mHead.load(std::memory_order_relaxed);
+		TraceEvent &e = r->mEvent[h & (TRACE_RING_SIZE - 1)];
+		// Keeps the slot writes after the previous head store; a reader that sees any of
+		// them also sees head at h, and so knows the slot may be torn.
+		std::atomic_thread_fence(std::memory_order_release);
+		e.mName.store(aName, std::memory_order_relaxed);
+		e.mStart.store(aStart, std::memory_order_relaxed);
+		e.mEnd.store(aEnd, std::memory_order_relaxed);
+		e.mArg.store(aArg, std::memory_order_relaxed);
+		r->mHead.store(h + 1, std::memory_order_release);
+	}
+
+	void Trace::setThreadName(const char *aName)
+	{
+		tName = aName;
+		if (tRing.mRing)
+			tRing.mRing->mName.store(aName, std::memory_order_relaxed);
+	}
+
+	void Trace::clear()
+	{
+		gClearTime.store(Profiler::now());
+	}
+
+	result Trace::save(const char *aFilename)
+	{
+		if (!aFilename)
+			return INVALID_PARAMETER;
+		FILE *f = fopen(aFilename, "w");
+		if (!f)
+			return FILE_NOT_FOUND;
+
+		unsigned long long cleared = gClearTime.load();
+		// Timestamps are written relative to when tracing was first enabled
+		unsigned long long base = gEpoch.load();
+		TraceRing *r;
+
+		TraceEvent *copy = new TraceEvent[TRACE_RING_SIZE];
+		fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		bool first = true;
+		for (r = gRings.load(); r; r = r->mNext)
+		{
+			const char *name = r->mName.load(std::memory_order_relaxed);
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", r->mId);
+			if (name)
+				fprintf(f, "%s", name);
+			else
+				fprintf(f, "thread %u", r->mId);
+			fprintf(f, "\"}}");
+			first = false;
+
+			unsigned long long head = r->mHead.load(std::memory_order_acquire);
+			unsigned long long from = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+			// Leave out what the ring's previous thread recorded
+			unsigned long long owned = r->mFirst.load(std::memory_order_acquire);
+			if (from < owned)
+				from = owned;
+			unsigned long long i;
+			for (i = from; i < head; i++)
+			{
+				TraceEvent &src = r->mEvent[i & (TRACE_RING_SIZE - 1)];
+				TraceEvent &dst = copy[i & (TRACE_RING_SIZE - 1)];
+				dst.mName.store(src.mName.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				dst.mStart.store(src.mStart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				dst.mEnd.store(src.mEnd.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				dst.mArg.store(src.mArg.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			// The slot being written at head, and anything past it, may have been torn
+			unsigned long long now = r->mHead.load(std::memory_order_relaxed);
+			if (now + 1 > from + TRACE_RING_SIZE)
+				from = now + 1 - TRACE_RING_SIZE;
+			for (i = from; i < head; i++)
+			{
+				TraceEvent &e = copy[i & (TRACE_RING_SIZE - 1)];
+				const char *ename = e.mName.load(std::memory_order_relaxed);
+				unsigned long long start = e.mStart.load(std::memory_order_relaxed);
+				unsigned long long end = e.mEnd.load(std::memory_order_relaxed);
+				int arg = e.mArg.load(std::memory_order_relaxed);
+				if (!ename || end < cleared || start < base || end < start)
+					continue;
+				fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+					ename, r->mId, (start - base) * 1e-3, (end - start) * 1e-3);
+				if (arg >= 0)
+					fprintf(f, ",\"args\":{\"id\":%d}", arg);
+				fprintf(f, "}");
+			}
+		}
+		delete[] copy;
+		fprintf(f, "\n]}\n");
+		bool failed = ferror(f) != 0;
+		fclose(f);
+		return failed ? FILE_LOAD_FAILED : SO_NO_ERROR;
+	}
+};
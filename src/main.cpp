@@ -6,6 +6,7 @@
 
 #include "../soloud/include/soloud.h"
 #include "../soloud/include/soloud_wav.h"
+#include "../soloud/include/soloud_soundbank.h"
 #include "reverb/PSXReverbFilter.h"
 
 int main()
@@ -19,21 +20,48 @@ int main()
     soloud.play(reverbBus);
     reverbBus.setFilter(0, &filter);
 
+    // Prefer a packed bank (see tools/soloud_bankbuild) over opening every file
+    SoLoud::SoundBank bank;
+    bool useBank = bank.open("sfx.bank") == SoLoud::SO_NO_ERROR;
+
     std::string prefix = "sfx/";
     std::string suffix = ".wav";
 
-    for (int i = 0; i < 1544; i++) {
-        std::cout << "Playing sound " << i << std::endl;
+    const int soundCount = 1544;
 
+    // Decode the next few sounds in the background while the current one plays
+    const int preloadCount = 4;
+    SoLoud::Wav sounds[preloadCount];
+
+    auto preload = [&](int i) {
+        if (i >= soundCount)
+            return;
+        SoLoud::Wav& sound = sounds[i % preloadCount];
+        // Sooner sounds get higher priority
+        if (useBank && bank.find(i)) {
+            sound.loadBankAsync(&bank, i, -i);
+            return;
+        }
         std::string filename = prefix + std::to_string(i) + suffix;
+        sound.loadAsync(filename.c_str(), -i);
+    };
+
+    for (int i = 0; i < preloadCount; i++)
+        preload(i);
 
-        SoLoud::Wav sound;
-        sound.load(filename.c_str());
+    for (int i = 0; i < soundCount; i++) {
+        std::cout << "Playing sound " << i << std::endl;
+
+        SoLoud::Wav& sound = sounds[i % preloadCount];
+        sound.waitLoad();
         float lengthInSeconds = sound.getLength() + 2;
 
         reverbBus.play(sound);
 
         std::this_thread::sleep_for(std::chrono::duration<float>(lengthInSeconds));
+
+        // Reuses this sound's slot, stopping it
+        preload(i + preloadCount);
     }
 
     soloud.deinit();
@@ -1,13 +1,24 @@
 #include "PSXReverbFilter.h"
 
+void PSXReverbFilter::setPreset(int aPreset) {
+    if (aPreset >= 0 && aPreset < NUM_PRESETS)
+        mPreset = aPreset;
+}
+
 SoLoud::FilterInstance* PSXReverbFilter::createInstance() {
-    return new PSXReverbFilterInstance();
+    return new PSXReverbFilterInstance(mPreset);
 }
 
-PSXReverbFilterInstance::PSXReverbFilterInstance() {
+PSXReverbFilterInstance::PSXReverbFilterInstance(int aPreset) {
     activate(&mReverb);
 
-    mPreset = 4;
+    // Levels are in dB; 0 dB is what activate() starts the smoothed gains at
+    mWet = 0.0f;
+    mDry = 0.0f;
+    mPreset = (float)aPreset;
+    mMaster = 0.0f;
+    // Load it here, so the first run() in the mixer doesn't clear the delay ring
+    preset_load(&mReverb, aPreset);
 
     setPort(&mReverb, PortIndex::PSX_REV_WET, &mWet);
     setPort(&mReverb, PortIndex::PSX_REV_DRY, &mDry);
@@ -17,10 +28,48 @@ PSXReverbFilterInstance::PSXReverbFilterInstance() {
 
 void PSXReverbFilterInstance::filter(float* aBuffer, unsigned int aSamples, unsigned int aChannels, float aSamplerate, SoLoud::time aTime) {
 
-    setPort(&mReverb, PortIndex::PSX_REV_MAIN0_IN, (float*)aBuffer);
-    setPort(&mReverb, PortIndex::PSX_REV_MAIN1_IN, (float*)aBuffer + 1);
-    setPort(&mReverb, PortIndex::PSX_REV_MAIN0_OUT, (float*)aBuffer);
-    setPort(&mReverb, PortIndex::PSX_REV_MAIN1_OUT, (float*)aBuffer + 1);
+    // Channels are planar, aSamples apart; a mono voice feeds both sides
+    float* right = aChannels > 1 ? aBuffer + aSamples : aBuffer;
+    setPort(&mReverb, PortIndex::PSX_REV_MAIN0_IN, aBuffer);
+    setPort(&mReverb, PortIndex::PSX_REV_MAIN1_IN, right);
+    setPort(&mReverb, PortIndex::PSX_REV_MAIN0_OUT, aBuffer);
+    setPort(&mReverb, PortIndex::PSX_REV_MAIN1_OUT, right);
 
     run(&mReverb, aSamples);
-}
\ No newline at end of file
+}
+
+// Number of trips through a feedback path of gain aGain until it has decayed below -90 dB.
+static unsigned int decayLoops(float aGain) {
+    aGain = std::fabs(aGain);
+    if (aGain <= 0.0f)
+        return 0;
+    if (aGain >= 1.0f)
+        return SoLoud::FilterInstance::TAIL_INFINITE;
+    return (unsigned int)std::ceil(-90.0f / (20.0f * std::log10(aGain)));
+}
+
+unsigned int PSXReverbFilterInstance::getTailSamples(float /*aSamplerate*/) {
+    const PsxReverb& rev = mReverb;
+    const uint32_t mask = (uint32_t)rev.spu_buffer_count_mask;
+
+    // The wall reflections feed back into themselves once per trip from their
+    // read to their write address; the all-pass stages then smear the result
+    // over their own delays. Everything else is at most one trip through the buffer.
+    uint32_t wallTrip = std::max({ (rev.mLSAME - rev.dLSAME) & mask, (rev.mRSAME - rev.dRSAME) & mask,
+                                   (rev.mLDIFF - rev.dRDIFF) & mask, (rev.mRDIFF - rev.dLDIFF) & mask });
+    uint32_t longest = std::max({ rev.mLSAME, rev.mRSAME, rev.mLDIFF, rev.mRDIFF,
+                                  rev.mLCOMB1, rev.mRCOMB1, rev.mLCOMB2, rev.mRCOMB2,
+                                  rev.mLCOMB3, rev.mRCOMB3, rev.mLCOMB4, rev.mRCOMB4,
+                                  rev.mLAPF1, rev.mRAPF1, rev.mLAPF2, rev.mRAPF2 });
+
+    unsigned int wallLoops = decayLoops(rev.vWALL);
+    unsigned int apf1Loops = decayLoops(rev.vAPF1);
+    unsigned int apf2Loops = decayLoops(rev.vAPF2);
+    if (wallLoops == TAIL_INFINITE || apf1Loops == TAIL_INFINITE || apf2Loops == TAIL_INFINITE)
+        return TAIL_INFINITE;
+
+    double tail = (double)wallLoops * wallTrip + (double)apf1Loops * rev.dAPF1 + (double)apf2Loops * rev.dAPF2 + longest;
+    if (tail >= (double)TAIL_INFINITE)
+        return TAIL_INFINITE;
+    return (unsigned int)tail;
+}
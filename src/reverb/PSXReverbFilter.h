@@ -6,14 +6,20 @@
 
 class PSXReverbFilter : public SoLoud::Filter {
 public:
+    // Preset instances created from now on start with, 0 to NUM_PRESETS - 1
+    void setPreset(int aPreset);
     SoLoud::FilterInstance* createInstance() override;
+
+private:
+    int mPreset = 4;
 };
 
 class PSXReverbFilterInstance : public SoLoud::FilterInstance {
 public:
-    PSXReverbFilterInstance();
+    explicit PSXReverbFilterInstance(int aPreset);
 
     void filter(float* aBuffer, unsigned int aSamples, unsigned int aChannels, float aSamplerate, SoLoud::time aTime) override;
+    unsigned int getTailSamples(float aSamplerate) override;
 
 private:
     PsxReverb mReverb;
@@ -0,0 +1,192 @@
+// Runs a scripted scenario through the null driver with the real-time safety
+// audit on and reports every heap allocation, free, mutex lock and file access
+// the mixer made, by call stack.
+//
+//   soloud_audit [--abort] [--sfx=<directory>] [report file]
+//
+// Steps: sounds playing on a PSX reverb bus, a streamed sound, a stream seek, 3D
+// voices, voices ending, a resampled stream and a voice count change. --abort stops
+// at the first violation with its stack instead. The report goes to stdout without
+// a file; the exit code is 1 if anything was found. SoLoud must be built with
+// SOLOUD_AUDIT.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "soloud.h"
+#include "soloud_audit.h"
+#include "soloud_bus.h"
+#include "soloud_wav.h"
+#include "soloud_wavstream.h"
+#include "reverb/PSXReverbFilter.h"
+
+#ifndef SOLOUD_AUDIT_SFX_DIR
+#define SOLOUD_AUDIT_SFX_DIR "sfx"
+#endif
+
+namespace
+{
+    const unsigned int kRate = 44100;
+    const unsigned int kBlock = 512;
+
+    std::vector<std::string> sfxFiles(const std::string& dir, size_t count)
+    {
+        std::vector<std::string> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        if (files.size() > count)
+            files.resize(count);
+        return files;
+    }
+
+    // Mixes aSeconds of audio and prints what the audit found during it
+    void step(SoLoud::Soloud& soloud, const char* aName, float aSeconds, bool a3d = false)
+    {
+        unsigned int before[SoLoud::Audit::KIND_COUNT];
+        for (int k = 0; k < SoLoud::Audit::KIND_COUNT; k++)
+            before[k] = SoLoud::Audit::getCount((SoLoud::Audit::KIND)k);
+
+        static float buffer[kBlock * 2];
+        unsigned int blocks = (unsigned int)(aSeconds * kRate / kBlock);
+        for (unsigned int b = 0; b < blocks; b++)
+        {
+            if (a3d)
+            {
+                float a = b * 0.01f;
+                soloud.set3dListenerAt(std::sin(a), 0, std::cos(a));
+                soloud.update3dAudio();
+            }
+            soloud.mix(buffer, kBlock);
+        }
+
+        std::printf("%-24s", aName);
+        for (int k = 0; k < SoLoud::Audit::KIND_COUNT; k++)
+        {
+            SoLoud::Audit::KIND kind = (SoLoud::Audit::KIND)k;
+            std::printf("%s %s %u", k ? "," : "", SoLoud::Audit::getKindName(kind), SoLoud::Audit::getCount(kind) - before[k]);
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool abortMode = false;
+    std::string sfxDir = SOLOUD_AUDIT_SFX_DIR;
+    const char* reportFile = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--abort") == 0)
+            abortMode = true;
+        else if (std::strncmp(argv[i], "--sfx=", 6) == 0)
+            sfxDir = argv[i] + 6;
+        else if (argv[i][0] != '-' && !reportFile)
+            reportFile = argv[i];
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--abort] [--sfx=dir] [report file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::string> files = sfxFiles(sfxDir, 9);
+    if (files.size() < 2)
+    {
+        std::fprintf(stderr, "no sounds found in %s\n", sfxDir.c_str());
+        return 1;
+    }
+
+    SoLoud::Soloud soloud;
+    soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kRate, kBlock, 2);
+    soloud.setMaxActiveVoiceCount(32);
+    soloud.set3dListenerParameters(0, 0, 0, 0, 0, 1, 0, 1, 0);
+
+    std::vector<std::unique_ptr<SoLoud::Wav>> sounds;
+    for (size_t i = 1; i < files.size(); i++)
+    {
+        std::unique_ptr<SoLoud::Wav> wav(new SoLoud::Wav);
+        if (wav->load(files[i].c_str()) == SoLoud::SO_NO_ERROR)
+            sounds.push_back(std::move(wav));
+    }
+    SoLoud::WavStream stream;
+    if (stream.load(files[0].c_str()) != SoLoud::SO_NO_ERROR)
+    {
+        std::fprintf(stderr, "failed to load %s\n", files[0].c_str());
+        return 1;
+    }
+    stream.setLooping(true);
+
+    PSXReverbFilter reverb;
+    SoLoud::Bus reverbBus;
+    reverbBus.setFilter(0, &reverb);
+
+    SoLoud::Audit::setMode(abortMode ? SoLoud::Audit::ABORT : SoLoud::Audit::COUNT);
+    if (SoLoud::Audit::getMode() == SoLoud::Audit::OFF)
+    {
+        SoLoud::Audit::report();
+        return 1;
+    }
+
+    // Game thread calls sit between the steps, outside the audit; only what the
+    // mixer does with them afterwards counts
+    soloud.play(reverbBus);
+    step(soloud, "idle bus", 0.5f);
+
+    for (size_t i = 0; i < sounds.size(); i++)
+    {
+        if (i & 1)
+            reverbBus.play(*sounds[i], 0.5f, (float)i / sounds.size() - 0.5f);
+        else
+            soloud.play(*sounds[i], 0.5f);
+    }
+    step(soloud, "sounds on reverb bus", 1.0f);
+
+    SoLoud::handle streamHandle = soloud.play(stream, 0.7f);
+    step(soloud, "stream", 1.0f);
+
+    soloud.seek(streamHandle, 0.1f);
+    step(soloud, "after stream seek", 0.5f);
+
+    for (size_t i = 0; i < sounds.size(); i++)
+    {
+        float a = i * 0.7f;
+        soloud.play3d(*sounds[i], 10 * std::cos(a), 0, 10 * std::sin(a));
+    }
+    step(soloud, "3d voices", 1.0f, true);
+
+    // Let every non-looping voice run out
+    step(soloud, "voices ending", 3.0f);
+
+    soloud.setRelativePlaySpeed(streamHandle, 1.3f);
+    step(soloud, "resampled stream", 1.0f);
+    soloud.stop(streamHandle);
+
+    soloud.setMaxActiveVoiceCount(16);
+    for (size_t i = 0; i < sounds.size(); i++)
+        reverbBus.play(*sounds[i], 0.5f);
+    step(soloud, "fewer active voices", 1.0f);
+
+    SoLoud::Audit::setMode(SoLoud::Audit::OFF);
+    soloud.deinit();
+
+    std::printf("\n");
+    if (SoLoud::Audit::report(reportFile) != SoLoud::SO_NO_ERROR)
+        return 1;
+    for (int k = 0; k < SoLoud::Audit::KIND_COUNT; k++)
+    {
+        if (SoLoud::Audit::getCount((SoLoud::Audit::KIND)k))
+            return 1;
+    }
+    return 0;
+}
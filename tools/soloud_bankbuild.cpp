@@ -0,0 +1,88 @@
+// Packs a directory of sounds into a SoLoud::SoundBank.
+//
+//   soloud_bankbuild [--decode] <directory> <output.bank>
+//
+// Each file's id is its numeric file name (sfx/42.wav -> 42); files without a
+// numeric name are skipped. --decode stores planar float samples so that
+// Wav::loadBank can use them in place, at roughly 8x the size of MS-ADPCM input.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "soloud.h"
+#include "soloud_soundbank.h"
+
+namespace
+{
+    bool parseId(const std::string& stem, unsigned int& id)
+    {
+        if (stem.empty() || stem.size() > 9)
+            return false;
+        for (char c : stem)
+        {
+            if (c < '0' || c > '9')
+                return false;
+        }
+        id = (unsigned int)std::strtoul(stem.c_str(), nullptr, 10);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool decode = false;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "--decode") == 0)
+    {
+        decode = true;
+        arg++;
+    }
+    if (argc - arg != 2)
+    {
+        std::fprintf(stderr, "usage: %s [--decode] <directory> <output.bank>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::pair<unsigned int, std::string>> sounds;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(argv[arg], ec))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        unsigned int id;
+        if (!parseId(entry.path().stem().string(), id))
+        {
+            std::fprintf(stderr, "skipping %s: name is not a numeric id\n", entry.path().string().c_str());
+            continue;
+        }
+        sounds.emplace_back(id, entry.path().string());
+    }
+    if (ec || sounds.empty())
+    {
+        std::fprintf(stderr, "no sounds found in %s\n", argv[arg]);
+        return 1;
+    }
+    std::sort(sounds.begin(), sounds.end());
+
+    std::vector<unsigned int> ids;
+    std::vector<const char*> files;
+    for (const auto& s : sounds)
+    {
+        ids.push_back(s.first);
+        files.push_back(s.second.c_str());
+    }
+
+    SoLoud::result res = SoLoud::SoundBank::write(argv[arg + 1], ids.data(), files.data(), (unsigned int)ids.size(), decode);
+    if (res != SoLoud::SO_NO_ERROR)
+    {
+        std::fprintf(stderr, "failed to write %s (error %d)\n", argv[arg + 1], res);
+        return 1;
+    }
+    std::printf("%s: %u sounds\n", argv[arg + 1], (unsigned int)ids.size());
+    return 0;
+}
@@ -0,0 +1,423 @@
+// Renders fixed scenarios offline and compares them against golden renders, so
+// that changes to the mixer's kernels (resampling, panning, the PSX reverb) can be
+// checked for what they do to the output.
+//
+//   soloud_golden [options] record <golden directory> [scenario filter]
+//   soloud_golden [options] check <golden directory> [scenario filter]
+//   soloud_golden [options] check [scenario filter]
+//
+//   --sfx=<directory>   sounds for the sfx scenarios (default: the repo's sfx/)
+//   --max-error=<x>     largest absolute sample error check accepts (default 1e-4)
+//   --min-snr=<dB>      lowest signal to error ratio check accepts (default 90)
+//
+// Every scenario is mixed through the null driver at each of kBlockSizes frames
+// per mix() call and stored as <scenario>_<block>.f32, raw interleaved stereo
+// floats. Both modes print a hash of each render rounded to 16 bits, which
+// survives the last-bit differences reordered float math makes. Without a golden
+// directory check compares those hashes against kExpectedHashes instead, which
+// needs no prior record but only holds for the repo's own sfx/; after an
+// intended change to the output, paste the new hashes into the table. check
+// exits with 1 if any render is missing, out of tolerance or hashes differently.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "soloud.h"
+#include "soloud_bus.h"
+#include "soloud_wav.h"
+#include "reverb/PSXReverbFilter.h"
+
+#ifndef SOLOUD_GOLDEN_SFX_DIR
+#define SOLOUD_GOLDEN_SFX_DIR "sfx"
+#endif
+
+namespace
+{
+    const unsigned int kRate = 44100;
+    const unsigned int kChannels = 2;
+    const unsigned int kBlockSizes[] = {256, 512, 1024};
+
+    // Quantized hashes of every render, as printed by record and check
+    const struct
+    {
+        const char* name;
+        unsigned long long hash;
+    } kExpectedHashes[] = {
+        {"psx_impulse_preset0_256", 0xdc2a4905f5d145e3ULL},
+        {"psx_impulse_preset0_512", 0xdc2a4905f5d145e3ULL},
+        {"psx_impulse_preset0_1024", 0xdc2a4905f5d145e3ULL},
+        {"psx_impulse_preset1_256", 0x7e6e876bbcabc423ULL},
+        {"psx_impulse_preset1_512", 0x7e6e876bbcabc423ULL},
+        {"psx_impulse_preset1_1024", 0x7e6e876bbcabc423ULL},
+        {"psx_impulse_preset2_256", 0x0ebe14ba071e8cb7ULL},
+        {"psx_impulse_preset2_512", 0x0ebe14ba071e8cb7ULL},
+        {"psx_impulse_preset2_1024", 0x0ebe14ba071e8cb7ULL},
+        {"psx_impulse_preset3_256", 0xd2ff2c6705a12d91ULL},
+        {"psx_impulse_preset3_512", 0xd2ff2c6705a12d91ULL},
+        {"psx_impulse_preset3_1024", 0xd2ff2c6705a12d91ULL},
+        {"psx_impulse_preset4_256", 0x1e694814db96da7fULL},
+        {"psx_impulse_preset4_512", 0x1e694814db96da7fULL},
+        {"psx_impulse_preset4_1024", 0x1e694814db96da7fULL},
+        {"psx_impulse_preset5_256", 0x6fbc69f28b0e0d0cULL},
+        {"psx_impulse_preset5_512", 0x6fbc69f28b0e0d0cULL},
+        {"psx_impulse_preset5_1024", 0x6fbc69f28b0e0d0cULL},
+        {"psx_impulse_preset6_256", 0xcc75d9da330c3d59ULL},
+        {"psx_impulse_preset6_512", 0xcc75d9da330c3d59ULL},
+        {"psx_impulse_preset6_1024", 0xcc75d9da330c3d59ULL},
+        {"psx_impulse_preset7_256", 0xad669c5601d1abc4ULL},
+        {"psx_impulse_preset7_512", 0xad669c5601d1abc4ULL},
+        {"psx_impulse_preset7_1024", 0xad669c5601d1abc4ULL},
+        {"psx_impulse_preset8_256", 0x7fbb20bdcfe9cf20ULL},
+        {"psx_impulse_preset8_512", 0x7fbb20bdcfe9cf20ULL},
+        {"psx_impulse_preset8_1024", 0x7fbb20bdcfe9cf20ULL},
+        {"psx_impulse_preset9_256", 0xa7df48a9003d9da5ULL},
+        {"psx_impulse_preset9_512", 0xa7df48a9003d9da5ULL},
+        {"psx_impulse_preset9_1024", 0xa7df48a9003d9da5ULL},
+        {"flyby_3d_256", 0xa7b71dc2f708a10bULL},
+        {"flyby_3d_512", 0x4dfd460e0974c800ULL},
+        {"flyby_3d_1024", 0xaf2a42329034a9b8ULL},
+        {"sfx_buses_256", 0x3b80eeaf87dd5a9fULL},
+        {"sfx_buses_512", 0x26228afd1dc08fc2ULL},
+        {"sfx_buses_1024", 0x116e9c2cfdab3d06ULL},
+    };
+
+    // Called before each block with the frame it starts at
+    typedef std::function<void(unsigned int)> BlockHook;
+
+    struct Scenario
+    {
+        std::string name;
+        float seconds;
+        // Plays the scenario's sounds on soloud and returns its per-block hook, if any
+        std::function<BlockHook(SoLoud::Soloud&)> start;
+    };
+
+    std::vector<float> render(const Scenario& scenario, unsigned int block)
+    {
+        SoLoud::Soloud soloud;
+        soloud.init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER, kRate, std::max(block, (unsigned int)SAMPLE_GRANULARITY), kChannels);
+        soloud.setMaxActiveVoiceCount(64);
+        BlockHook hook = scenario.start(soloud);
+
+        unsigned int frames = (unsigned int)(scenario.seconds * kRate);
+        std::vector<float> out(frames * kChannels);
+        for (unsigned int frame = 0; frame < frames; frame += block)
+        {
+            if (hook)
+                hook(frame);
+            soloud.mix(out.data() + frame * kChannels, std::min(block, frames - frame));
+        }
+        soloud.deinit();
+        return out;
+    }
+
+    // Starts aHandle aFrame frames into the render, independent of block size
+    void startAt(SoLoud::Soloud& soloud, SoLoud::handle aHandle, unsigned int aFrame)
+    {
+        soloud.setDelaySamples(aHandle, aFrame);
+        soloud.setPause(aHandle, false);
+    }
+
+    std::vector<std::string> sfxFiles(const std::string& dir, size_t count)
+    {
+        std::vector<std::string> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        if (files.size() > count)
+            files.resize(count);
+        return files;
+    }
+
+    std::vector<Scenario> scenarios(const std::string& sfxDir)
+    {
+        // Sources and filters outlive every render
+        static std::vector<std::unique_ptr<SoLoud::Wav>> sounds;
+        static std::vector<std::unique_ptr<SoLoud::Bus>> buses;
+        static PSXReverbFilter reverbs[NUM_PRESETS];
+
+        std::vector<Scenario> list;
+
+        // An impulse through each preset, panned so that the sides differ
+        static SoLoud::Wav impulse;
+        static float impulseData[SAMPLE_GRANULARITY];
+        impulseData[0] = 1.0f;
+        impulseData[7] = -0.5f;
+        impulse.loadRawWave(impulseData, SAMPLE_GRANULARITY, (float)kRate, 1, true);
+        for (int preset = 0; preset < NUM_PRESETS; preset++)
+        {
+            reverbs[preset].setPreset(preset);
+            list.push_back({"psx_impulse_preset" + std::to_string(preset), 2.0f, [preset](SoLoud::Soloud& soloud) {
+                buses.emplace_back(new SoLoud::Bus);
+                SoLoud::Bus& bus = *buses.back();
+                bus.setFilter(0, &reverbs[preset]);
+                soloud.play(bus);
+                bus.play(impulse, 0.8f, -0.4f);
+                return BlockHook();
+            }});
+        }
+
+        // Two emitters crossing in front of the listener at 25 m/s, with doppler
+        static SoLoud::Wav saw;
+        static std::vector<float> sawData;
+        sawData.resize(kRate / 2);
+        for (size_t i = 0; i < sawData.size(); i++)
+            sawData[i] = 0.3f * (std::fmod(i * 220.0f / kRate, 1.0f) * 2 - 1) + 0.2f * std::sin(i * 0.05f);
+        saw.loadRawWave(sawData.data(), (unsigned int)sawData.size(), (float)kRate, 1, true);
+        saw.setLooping(true);
+        saw.set3dMinMaxDistance(1, 100);
+        saw.set3dAttenuation(SoLoud::AudioSource::INVERSE_DISTANCE, 1.0f);
+        saw.set3dDopplerFactor(1.0f);
+        list.push_back({"flyby_3d", 4.0f, [](SoLoud::Soloud& soloud) {
+            soloud.set3dListenerParameters(0, 0, 0, 0, 0, 1, 0, 1, 0);
+            SoLoud::handle a = soloud.play3d(saw, -50, 0, 3, 25, 0, 0);
+            SoLoud::handle b = soloud.play3d(saw, 50, 0, 8, -25, 0, 0, 0.7f);
+            soloud.setRelativePlaySpeed(b, 1.5f);
+            soloud.update3dAudio();
+            return BlockHook([&soloud, a, b](unsigned int frame) {
+                float t = (float)frame / kRate;
+                soloud.set3dSourceParameters(a, -50 + 25 * t, 0, 3, 25, 0, 0);
+                soloud.set3dSourceParameters(b, 50 - 25 * t, 0, 8, -25, 0, 0);
+                soloud.update3dAudio();
+            });
+        }});
+
+        // Real sounds at their own rates and at off-unity speeds, over a reverb bus
+        // nested inside a dry one
+        if (sounds.empty())
+        {
+            for (const std::string& file : sfxFiles(sfxDir, 12))
+            {
+                std::unique_ptr<SoLoud::Wav> wav(new SoLoud::Wav);
+                if (wav->load(file.c_str()) == SoLoud::SO_NO_ERROR)
+                    sounds.push_back(std::move(wav));
+            }
+        }
+        if (sounds.empty())
+            std::printf("no sounds in %s, skipping sfx scenarios\n", sfxDir.c_str());
+        else
+        {
+            list.push_back({"sfx_buses", 3.0f, [](SoLoud::Soloud& soloud) {
+                buses.emplace_back(new SoLoud::Bus);
+                SoLoud::Bus& dry = *buses.back();
+                buses.emplace_back(new SoLoud::Bus);
+                SoLoud::Bus& wet = *buses.back();
+                wet.setFilter(0, &reverbs[2]);
+                soloud.play(dry, 0.9f);
+                dry.play(wet, 0.8f);
+                for (size_t i = 0; i < sounds.size(); i++)
+                {
+                    SoLoud::Bus& bus = (i & 1) ? wet : dry;
+                    SoLoud::handle h = bus.play(*sounds[i], 0.4f + 0.05f * (i % 5), ((int)(i % 7) - 3) * 0.3f, true);
+                    if (i % 3 == 1)
+                        soloud.setRelativePlaySpeed(h, 0.75f + 0.1f * (i % 4));
+                    startAt(soloud, h, (unsigned int)(i * 7919 % (kRate * 2)));
+                }
+                return BlockHook();
+            }});
+        }
+        return list;
+    }
+
+    // FNV-1a over the samples rounded to 16 bits
+    unsigned long long quantizedHash(const std::vector<float>& data)
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for (float f : data)
+        {
+            long q = std::lround(std::max(-1.0f, std::min(1.0f, f)) * 32767.0f);
+            unsigned short s = (unsigned short)(short)q;
+            h = (h ^ (s & 0xff)) * 1099511628211ULL;
+            h = (h ^ (s >> 8)) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bool writeFloats(const std::string& path, const std::vector<float>& data)
+    {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f)
+            return false;
+        size_t written = std::fwrite(data.data(), sizeof(float), data.size(), f);
+        return std::fclose(f) == 0 && written == data.size();
+    }
+
+    bool readFloats(const std::string& path, std::vector<float>& data)
+    {
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f)
+            return false;
+        data.clear();
+        float buf[4096];
+        size_t n;
+        while ((n = std::fread(buf, sizeof(float), 4096, f)) > 0)
+            data.insert(data.end(), buf, buf + n);
+        std::fclose(f);
+        return true;
+    }
+
+    const unsigned long long* expectedHash(const std::string& name)
+    {
+        for (const auto& expected : kExpectedHashes)
+        {
+            if (name == expected.name)
+                return &expected.hash;
+        }
+        return nullptr;
+    }
+
+    bool hasRenders(const std::string& dir)
+    {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (entry.path().extension() == ".f32")
+                return true;
+        }
+        return false;
+    }
+
+    const char* optionValue(const char* arg, const char* name)
+    {
+        size_t len = std::strlen(name);
+        return std::strncmp(arg, name, len) == 0 ? arg + len : nullptr;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string sfxDir = SOLOUD_GOLDEN_SFX_DIR;
+    double maxError = 1e-4;
+    double minSnr = 90;
+    int arg = 1;
+    for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (const char* v = optionValue(argv[arg], "--sfx="))
+            sfxDir = v;
+        else if (const char* v = optionValue(argv[arg], "--max-error="))
+            maxError = std::atof(v);
+        else if (const char* v = optionValue(argv[arg], "--min-snr="))
+            minSnr = std::atof(v);
+        else
+            break;
+    }
+    bool record = arg < argc && std::strcmp(argv[arg], "record") == 0;
+    bool check = arg < argc && std::strcmp(argv[arg], "check") == 0;
+    // A lone argument to check is a golden directory only if it holds renders,
+    // so that a filter such as sfx does not pick up the sounds directory
+    bool hashesOnly = check && (argc - arg < 2 || (argc - arg == 2 && !hasRenders(argv[arg + 1])));
+    if ((!record && !check) || (!hashesOnly && argc - arg < 2) || argc - arg > 3)
+    {
+        std::fprintf(stderr, "usage: %s [--sfx=dir] [--max-error=x] [--min-snr=dB] record|check <golden directory> [scenario filter]\n"
+                             "       %s [--sfx=dir] check [scenario filter]\n", argv[0], argv[0]);
+        return 1;
+    }
+    std::string dir = hashesOnly ? "" : argv[arg + 1];
+    const char* filter = hashesOnly ? (argc - arg == 2 ? argv[arg + 1] : nullptr) : (argc - arg == 3 ? argv[arg + 2] : nullptr);
+
+    if (record)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+    }
+
+    std::vector<Scenario> list = scenarios(sfxDir);
+
+    int failures = 0, renders = 0;
+    for (const Scenario& scenario : list)
+    {
+        for (unsigned int block : kBlockSizes)
+        {
+            std::string name = scenario.name + "_" + std::to_string(block);
+            if (filter && name.find(filter) == std::string::npos)
+                continue;
+            std::string path = dir + "/" + name + ".f32";
+            renders++;
+            std::vector<float> out = render(scenario, block);
+            unsigned long long hash = quantizedHash(out);
+
+            if (record)
+            {
+                if (!writeFloats(path, out))
+                {
+                    std::fprintf(stderr, "%s: failed to write %s\n", name.c_str(), path.c_str());
+                    failures++;
+                    continue;
+                }
+                std::printf("%-32s %016llx recorded\n", name.c_str(), hash);
+                continue;
+            }
+
+            if (hashesOnly)
+            {
+                const unsigned long long* expected = expectedHash(name);
+                if (!expected)
+                {
+                    std::printf("%-32s %016llx FAIL no expected hash\n", name.c_str(), hash);
+                    failures++;
+                }
+                else if (*expected != hash)
+                {
+                    std::printf("%-32s %016llx FAIL expected %016llx\n", name.c_str(), hash, *expected);
+                    failures++;
+                }
+                else
+                    std::printf("%-32s %016llx ok hash\n", name.c_str(), hash);
+                continue;
+            }
+
+            std::vector<float> golden;
+            if (!readFloats(path, golden))
+            {
+                std::printf("%-32s %016llx FAIL no golden at %s\n", name.c_str(), hash, path.c_str());
+                failures++;
+                continue;
+            }
+            if (golden.size() != out.size())
+            {
+                std::printf("%-32s %016llx FAIL %zu samples, golden has %zu\n", name.c_str(), hash, out.size(), golden.size());
+                failures++;
+                continue;
+            }
+
+            double signal = 0, noise = 0, worst = 0;
+            for (size_t i = 0; i < out.size(); i++)
+            {
+                double e = (double)out[i] - golden[i];
+                signal += (double)golden[i] * golden[i];
+                noise += e * e;
+                worst = std::max(worst, std::fabs(e));
+            }
+            bool nan = std::any_of(out.begin(), out.end(), [](float f) { return std::isnan(f); });
+            double snr = noise > 0 ? 10 * std::log10(signal / noise) : INFINITY;
+            bool pass = !nan && worst <= maxError && snr >= minSnr;
+            if (!pass)
+                failures++;
+            if (noise == 0 && !nan)
+                std::printf("%-32s %016llx ok exact\n", name.c_str(), hash);
+            else
+                std::printf("%-32s %016llx %s max error %.3g snr %.1f dB\n", name.c_str(), hash, pass ? "ok" : "FAIL", worst, snr);
+        }
+    }
+
+    if (!renders)
+    {
+        std::fprintf(stderr, "no scenario matches %s\n", filter);
+        return 1;
+    }
+    if (failures)
+        std::printf("%d render%s failed\n", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}